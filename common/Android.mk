@@ -72,14 +72,18 @@ LOCAL_SRC_FILES := \
         core/overlaylayer.cpp \
         display/displayplanemanager.cpp \
 	display/displayplanestate.cpp \
+        display/commitscheduler.cpp \
         display/displayqueue.cpp \
         display/vblankeventhandler.cpp \
+        display/vblankeventloop.cpp \
         display/virtualdisplay.cpp \
         utils/fdhandler.cpp \
         utils/hwcevent.cpp \
         utils/hwcthread.cpp \
         utils/hwcutils.cpp \
-        utils/disjoint_layers.cpp
+        utils/regionsplitter.cpp \
+        utils/spinlock.cpp \
+        utils/taskexecutor.cpp
 
 ifeq ($(strip $(ENABLE_HYPER_DMABUF_SHARING)), true)
 LOCAL_CPPFLAGS += -DENABLE_PANORAMA
@@ -158,10 +162,12 @@ LOCAL_SRC_FILES += \
 else
 LOCAL_CPPFLAGS += \
         -DUSE_GL \
-        -DPREBUILT_SHADER_FILE_PATH='"/vendor/etc"'
+        -DPREBUILT_SHADER_FILE_PATH='"/vendor/etc"' \
+        -DGL_PROGRAM_CACHE_DIR='"/data/vendor/hwc"'
 
 LOCAL_SRC_FILES += \
         compositor/gl/glprogram.cpp \
+        compositor/gl/glprogramcache.cpp \
         compositor/gl/glrenderer.cpp \
         compositor/gl/glsurface.cpp \
         compositor/gl/egloffscreencontext.cpp \
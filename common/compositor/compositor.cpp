@@ -19,8 +19,8 @@
 #include <xf86drmMode.h>
 
 #include <algorithm>
+#include <iterator>
 
-#include "disjoint_layers.h"
 #include "displayplanestate.h"
 #include "hwcdefs.h"
 #include "hwctrace.h"
@@ -45,26 +45,57 @@ void Compositor::Init(ResourceManager *resource_manager, uint32_t gpu_fd) {
     thread_.reset(new CompositorThread());
 
   thread_->Initialize(resource_manager, gpu_fd);
+  thread_->WarmUp();
 }
 
 void Compositor::BeginFrame(bool disable_explicit_sync) {
   thread_->SetDisableExplicitSync(disable_explicit_sync);
 }
 
+void Compositor::SetAsyncDraw(bool async_draw) {
+  async_draw_ = async_draw;
+}
+
 void Compositor::Reset() {
-  if (thread_)
+  if (thread_) {
     thread_->ExitThread();
+    pending_draw_ = 0;
+  }
+}
+
+size_t Compositor::GetFrameStorageCapacity() const {
+  return draw_states_.capacity() + media_states_.capacity() +
+         draw_buffers_.capacity() + dedicated_layers_.capacity();
+}
+
+bool Compositor::WaitForDraw() {
+  if (!pending_draw_)
+    return true;
+
+  uint64_t sequence = pending_draw_;
+  pending_draw_ = 0;
+  return thread_->WaitForDraw(sequence);
 }
 
 bool Compositor::Draw(DisplayPlaneStateList &comp_planes,
                       std::vector<OverlayLayer> &layers,
                       const std::vector<HwcRect<int>> &display_frame) {
   CTRACE();
+  // Surfaces of previous frame might still be in use by the compositor
+  // thread.
+  if (!WaitForDraw())
+    ETRACE("Composition of the previous frame failed.");
+
   const DisplayPlaneState *comp = NULL;
-  std::vector<size_t> dedicated_layers;
-  std::vector<DrawState> draw_state;
-  std::vector<DrawState> media_state;
-  std::vector<OverlayBuffer *> draw_buffers;
+  std::vector<size_t> &dedicated_layers = dedicated_layers_;
+  std::vector<DrawState> &draw_state = draw_states_;
+  std::vector<DrawState> &media_state = media_states_;
+  std::vector<OverlayBuffer *> &draw_buffers = draw_buffers_;
+  dedicated_layers.clear();
+  draw_state.clear();
+  media_state.clear();
+  draw_buffers.clear();
+  size_t storage_capacity = GetFrameStorageCapacity();
 
   for (auto &layer : layers) {
     draw_buffers.emplace_back(layer.GetBuffer());
@@ -125,6 +156,9 @@ bool Compositor::Draw(DisplayPlaneStateList &comp_planes,
       if (!regions_empty &&
           (surface->ClearSurface() || surface->IsPartialClear() ||
            surface->IsSurfaceDamageChanged())) {
+        // Hand the stale regions to SeparateLayers, which re-uses their
+        // storage.
+        ReleaseRegions(comp_regions);
         plane.ResetCompositionRegion();
         regions_empty = true;
       }
@@ -133,12 +167,14 @@ bool Compositor::Draw(DisplayPlaneStateList &comp_planes,
         plane.UpdateDamage(plane.GetDisplayFrame());
       }
 
+      RenderStateCache &render_states = plane.GetRenderStateCache();
       if (regions_empty) {
         SeparateLayers(dedicated_layers, comp->GetSourceLayers(), display_frame,
                        surface->GetSurfaceDamage(), comp_regions);
+        render_states.states_.clear();
       }
 
-      std::vector<size_t>().swap(dedicated_layers);
+      dedicated_layers.clear();
       if (comp_regions.empty())
         continue;
 
@@ -153,7 +189,7 @@ bool Compositor::Draw(DisplayPlaneStateList &comp_planes,
         use_plane_transform = true;
       }
 
-      CalculateRenderState(layers, comp_regions, state,
+      CalculateRenderState(layers, comp_regions, render_states, state,
                            plane.GetDownScalingFactor(),
                            plane.IsUsingPlaneScalar(), use_plane_transform);
 
@@ -163,10 +199,22 @@ bool Compositor::Draw(DisplayPlaneStateList &comp_planes,
     }
   }
 
+  if (GetFrameStorageCapacity() > storage_capacity)
+    frame_storage_allocations_++;
+
+  if (draw_state.empty() && media_state.empty())
+    return true;
+
   bool status = true;
-  if (!draw_state.empty() || !media_state.empty())
+  if (async_draw_) {
+    pending_draw_ = thread_->QueueDraw(draw_state, media_state, draw_buffers);
+  } else {
     status = thread_->Draw(draw_state, media_state, draw_buffers);
+  }
 
+  // We got states of an earlier draw back, only their storage is needed.
+  draw_state.clear();
+  media_state.clear();
   return status;
 }
 
@@ -177,6 +225,9 @@ bool Compositor::DrawOffscreen(std::vector<OverlayLayer> &layers,
                                uint32_t width, uint32_t height,
                                HWCNativeHandle output_handle,
                                int32_t acquire_fence, int32_t *retire_fence) {
+  if (!WaitForDraw())
+    ETRACE("Composition of the previous frame failed.");
+
   std::vector<OverlayBuffer *> draw_buffers;
   OverlayBuffer *nullbuffer = NULL;
   for (auto &layer : layers) {
@@ -207,7 +258,10 @@ bool Compositor::DrawOffscreen(std::vector<OverlayLayer> &layers,
   draw_state.surface_ = surface;
   size_t num_regions = comp_regions.size();
   draw_state.states_.reserve(num_regions);
-  CalculateRenderState(layers, comp_regions, draw_state, 1, false);
+  RenderStateCache render_states;
+  CalculateRenderState(layers, comp_regions, render_states, draw_state, 1,
+                       false);
+  ReleaseRegions(comp_regions);
 
   if (draw_state.states_.empty()) {
     return true;
@@ -233,21 +287,37 @@ void Compositor::FreeResources() {
 
 void Compositor::CalculateRenderState(
     std::vector<OverlayLayer> &layers,
-    const std::vector<CompositionRegion> &comp_regions, DrawState &draw_state,
-    uint32_t downscaling_factor, bool uses_display_up_scaling,
-    bool use_plane_transform) {
+    const std::vector<CompositionRegion> &comp_regions, RenderStateCache &cache,
+    DrawState &draw_state, uint32_t downscaling_factor,
+    bool uses_display_up_scaling, bool use_plane_transform) {
   CTRACE();
   size_t num_regions = comp_regions.size();
+  bool reuse_states = (cache.states_.size() == num_regions) &&
+                      (cache.downscaling_factor_ == downscaling_factor) &&
+                      (cache.uses_display_up_scaling_ ==
+                       uses_display_up_scaling) &&
+                      (cache.use_plane_transform_ == use_plane_transform);
+  if (!reuse_states) {
+    cache.states_.resize(num_regions);
+    cache.downscaling_factor_ = downscaling_factor;
+    cache.uses_display_up_scaling_ = uses_display_up_scaling;
+    cache.use_plane_transform_ = use_plane_transform;
+  }
+
   for (size_t region_index = 0; region_index < num_regions; region_index++) {
     const CompositionRegion &region = comp_regions.at(region_index);
-    RenderState state;
-    state.ConstructState(layers, region, downscaling_factor,
-                         uses_display_up_scaling, use_plane_transform);
+    RenderState &state = cache.states_.at(region_index);
+    if (reuse_states && state.IsGeometryValid(layers, use_plane_transform)) {
+      state.UpdateState(layers);
+    } else {
+      state.ConstructState(layers, region, downscaling_factor,
+                           uses_display_up_scaling, use_plane_transform);
+    }
+
     if (state.layer_state_.empty()) {
       continue;
     }
 
-    draw_state.states_.emplace(draw_state.states_.begin(), state);
     const std::vector<size_t> &source = region.source_layers;
     for (size_t texture_index : source) {
       OverlayLayer &layer = layers.at(texture_index);
@@ -257,6 +327,13 @@ void Compositor::CalculateRenderState(
       }
     }
   }
+
+  // Regions are drawn in reverse order.
+  for (size_t region_index = num_regions; region_index > 0; region_index--) {
+    const RenderState &state = cache.states_.at(region_index - 1);
+    if (!state.layer_state_.empty())
+      draw_state.states_.emplace_back(state);
+  }
 }
 
 void Compositor::SetVideoScalingMode(uint32_t mode) {
@@ -298,16 +375,11 @@ void Compositor::RestoreVideoDefaultDeinterlace() {
   lock_.unlock();
 }
 
-// Below code is taken from drm_hwcomposer adopted to our needs.
-static std::vector<size_t> SetBitsToVector(
-    uint64_t in, const std::vector<size_t> &index_map) {
-  std::vector<size_t> out;
-  size_t msb = sizeof(in) * 8 - 1;
-  uint64_t mask = (uint64_t)1 << msb;
-  for (size_t i = msb; mask != (uint64_t)0; i--, mask >>= 1)
-    if (in & mask)
-      out.emplace_back(index_map[i]);
-  return out;
+void Compositor::ReleaseRegions(std::vector<CompositionRegion> &comp_regions) {
+  region_pool_.insert(region_pool_.end(),
+                      std::make_move_iterator(comp_regions.begin()),
+                      std::make_move_iterator(comp_regions.end()));
+  comp_regions.clear();
 }
 
 void Compositor::SeparateLayers(const std::vector<size_t> &dedicated_layers,
@@ -316,70 +388,61 @@ void Compositor::SeparateLayers(const std::vector<size_t> &dedicated_layers,
                                 const HwcRect<int> &damage_region,
                                 std::vector<CompositionRegion> &comp_regions) {
   CTRACE();
-  if (source_layers.size() > 64) {
-    ETRACE("Failed to separate layers because there are more than 64");
-    return;
-  }
-
-  size_t num_exclude_rects = 0;
-  // Index at which the actual layers begin
-  size_t layer_offset = dedicated_layers.size();
-  if (source_layers.size() + layer_offset > 64) {
-    WTRACE(
-        "Exclusion rectangles are being truncated to make the rectangle count "
-        "fit into 64");
-    num_exclude_rects = 64 - source_layers.size() - dedicated_layers.size();
-  }
-
-  // We inject all the exclude rects into the rects list. Any resulting rect
-  // that includes ANY of the first num_exclude_rects is rejected. After the
-  // exclude rects, we add the lower layers. The rects that intersect with
-  // these layers will be inspected and only those which are to be composited
+  // We inject the dedicated layers into the rects list, followed by the
+  // layers to be composited. The rects that intersect with the dedicated
+  // layers will be inspected and only those which are to be composited
   // above the layer will be included in the composition regions.
-  std::vector<HwcRect<int>> layer_rects(source_layers.size() + layer_offset);
+  size_t layer_offset = dedicated_layers.size();
+  layer_rects_.resize(source_layers.size() + layer_offset);
   std::transform(
-      dedicated_layers.begin(), dedicated_layers.end(),
-      layer_rects.begin() + num_exclude_rects,
+      dedicated_layers.begin(), dedicated_layers.end(), layer_rects_.begin(),
       [=](size_t layer_index) { return display_frame[layer_index]; });
   std::transform(source_layers.begin(), source_layers.end(),
-                 layer_rects.begin() + layer_offset, [=](size_t layer_index) {
+                 layer_rects_.begin() + layer_offset, [=](size_t layer_index) {
                    return display_frame[layer_index];
                  });
 
-  std::vector<RectSet<int>> separate_regions;
-  get_draw_regions(layer_rects, damage_region, &separate_regions);
-  uint64_t exclude_mask = ((uint64_t)1 << num_exclude_rects) - 1;
-  uint64_t dedicated_mask = (((uint64_t)1 << dedicated_layers.size()) - 1)
-                            << num_exclude_rects;
-
-  for (RectSet<int> &region : separate_regions) {
-    if (region.id_set.getBits() & exclude_mask)
-      continue;
-
+  region_splitter_.Split(layer_rects_, damage_region);
+  for (const RegionSplitter::Region &region : region_splitter_.GetRegions()) {
+    const uint32_t *ids = region_splitter_.GetIds(region);
     // If a rect intersects one of the dedicated layers, we need to remove the
     // layers from the composition region which appear *below* the dedicated
     // layer. This effectively punches a hole through the composition layer such
     // that the dedicated layer can be placed below the composition and not
-    // be occluded.
-    uint64_t dedicated_intersect = region.id_set.getBits() & dedicated_mask;
-    for (size_t i = 0; dedicated_intersect && i < dedicated_layers.size();
-         ++i) {
-      // Only exclude layers if they intersect this particular dedicated layer
-      if (!(dedicated_intersect & (1 << (i + num_exclude_rects))))
-        continue;
+    // be occluded. Ids are sorted, so dedicated layers come first.
+    size_t min_layer = 0;
+    size_t first_source = 0;
+    for (; first_source < region.ids_count; first_source++) {
+      uint32_t id = ids[first_source];
+      if (id >= layer_offset)
+        break;
+
+      min_layer = std::max(min_layer, dedicated_layers[id] + 1);
+    }
 
-      for (size_t j = 0; j < source_layers.size(); ++j) {
-        if (source_layers[j] < dedicated_layers[i])
-          region.id_set.subtract(j + layer_offset);
-      }
+    comp_regions.emplace_back();
+    CompositionRegion &comp_region = comp_regions.back();
+    if (!region_pool_.empty()) {
+      comp_region = std::move(region_pool_.back());
+      region_pool_.pop_back();
+    }
+
+    std::vector<size_t> &region_layers = comp_region.source_layers;
+    region_layers.clear();
+    // Keep top most layer first.
+    for (size_t i = region.ids_count; i > first_source; i--) {
+      size_t layer_index = source_layers[ids[i - 1] - layer_offset];
+      if (layer_index >= min_layer)
+        region_layers.emplace_back(layer_index);
     }
 
-    if (!(region.id_set.getBits() >> layer_offset))
+    if (region_layers.empty()) {
+      region_pool_.emplace_back(std::move(comp_region));
+      comp_regions.pop_back();
       continue;
+    }
 
-    comp_regions.emplace_back(CompositionRegion{
-        region.rect, SetBitsToVector(region.id_set.getBits() >> layer_offset,
-                                     source_layers)});
+    comp_region.frame = region.rect;
   }
 }
 
@@ -26,6 +26,7 @@
 #include "compositorthread.h"
 #include "displayplanestate.h"
 #include "factory.h"
+#include "regionsplitter.h"
 #include "renderstate.h"
 
 namespace hwcomposer {
@@ -44,8 +45,20 @@ class Compositor {
   void Init(ResourceManager *buffer_manager, uint32_t gpu_fd);
   void Reset();
   void BeginFrame(bool disable_explicit_sync);
+  // In async mode, Draw only queues the frame for composition and
+  // WaitForDraw needs to be called before the offscreen surfaces are
+  // consumed.
+  void SetAsyncDraw(bool async_draw);
   bool Draw(DisplayPlaneStateList &planes, std::vector<OverlayLayer> &layers,
             const std::vector<HwcRect<int>> &display_frame);
+  // Waits for the last frame queued by Draw. Returns false if composition
+  // of the frame failed.
+  bool WaitForDraw();
+
+  // Number of times Draw had to grow the storage it re-uses between frames.
+  uint32_t GetFrameStorageAllocations() const {
+    return frame_storage_allocations_;
+  }
   bool DrawOffscreen(std::vector<OverlayLayer> &layers,
                      const std::vector<HwcRect<int>> &display_frame,
                      const std::vector<size_t> &source_layers,
@@ -64,22 +77,43 @@ class Compositor {
   void RestoreVideoDefaultDeinterlace();
 
  private:
+  // Adds RenderStates of comp_regions to state. States in cache which are
+  // still valid for layers are re-used, the others are rebuilt.
   void CalculateRenderState(std::vector<OverlayLayer> &layers,
                             const std::vector<CompositionRegion> &comp_regions,
-                            DrawState &state, uint32_t downscaling_factor,
+                            RenderStateCache &cache, DrawState &state,
+                            uint32_t downscaling_factor,
                             bool uses_display_up_scaling,
                             bool use_plane_transform = false);
+  size_t GetFrameStorageCapacity() const;
   void SeparateLayers(const std::vector<size_t> &dedicated_layers,
                       const std::vector<size_t> &source_layers,
                       const std::vector<HwcRect<int>> &display_frame,
                       const HwcRect<int> &damage_region,
                       std::vector<CompositionRegion> &comp_regions);
+  // Moves comp_regions to region_pool_, leaving comp_regions empty.
+  void ReleaseRegions(std::vector<CompositionRegion> &comp_regions);
 
   std::unique_ptr<CompositorThread> thread_;
   SpinLock lock_;
   HWCColorMap colors_;
   uint32_t scaling_mode_ = 0;
   HWCDeinterlaceProp deinterlace_;
+  // Used only by SeparateLayers, kept around to re-use their storage.
+  RegionSplitter region_splitter_;
+  std::vector<HwcRect<int>> layer_rects_;
+  // Regions dropped by planes, SeparateLayers re-uses their layer lists.
+  std::vector<CompositionRegion> region_pool_;
+  // Sequence number of the draw queued by Draw and not yet waited for.
+  uint64_t pending_draw_ = 0;
+  bool async_draw_ = false;
+  // Per frame storage of Draw. States are swapped with the ones of an
+  // earlier draw by CompositorThread, so storage keeps circulating.
+  std::vector<DrawState> draw_states_;
+  std::vector<DrawState> media_states_;
+  std::vector<OverlayBuffer *> draw_buffers_;
+  std::vector<size_t> dedicated_layers_;
+  uint32_t frame_storage_allocations_ = 0;
 };
 
 }  // namespace hwcomposer
@@ -75,6 +75,15 @@ typedef struct vk_import {
 } ResourceHandle;
 
 typedef VkDevice GpuDisplay;
+#elif USE_SW
+class OverlayBuffer;
+// Layer buffers are read directly by the software renderer.
+typedef OverlayBuffer* GpuResourceHandle;
+typedef struct sw_import {
+  HWCNativeHandle handle_ = 0;
+  uint32_t drm_fd_ = 0;
+} ResourceHandle;
+typedef void* GpuDisplay;
 #else
 typedef unsigned GpuResourceHandle;
 typedef void* ResourceHandle;
@@ -66,6 +66,16 @@ void CompositorThread::FreeResources() {
   Resume();
 }
 
+void CompositorThread::WarmUp() {
+  if (GpuDevice::getInstance().GetCompositorWarmUpLayers().empty())
+    return;
+
+  tasks_lock_.lock();
+  tasks_ |= kWarmUp;
+  tasks_lock_.unlock();
+  Resume();
+}
+
 void CompositorThread::Wait() {
   if (fd_chandler_.Poll(-1) <= 0) {
     ETRACE("Poll Failed in DisplayManager %s", PRINTERROR());
@@ -82,39 +92,69 @@ void CompositorThread::Wait() {
 bool CompositorThread::Draw(std::vector<DrawState> &states,
                             std::vector<DrawState> &media_states,
                             const std::vector<OverlayBuffer *> &buffers) {
-  states_.swap(states);
-  tasks_lock_.lock();
-
-  if (!states_.empty()) {
-    buffers_ = buffers;
-    tasks_ |= kRender3D;
-  }
+  return WaitForDraw(QueueDraw(states, media_states, buffers));
+}
 
-  if (!media_states.empty()) {
-    media_states_.swap(media_states);
-    tasks_ |= kRenderMedia;
+uint64_t CompositorThread::QueueDraw(
+    std::vector<DrawState> &states, std::vector<DrawState> &media_states,
+    const std::vector<OverlayBuffer *> &buffers) {
+  // Adding check to avoid waiting in this
+  // thread in certain corner case.
+  if (states.empty() && media_states.empty())
+    return 0;
+
+  // Only this thread updates queued_draws_.
+  uint64_t sequence = queued_draws_.load(std::memory_order_relaxed) + 1;
+  if (sequence > kDrawQueueSize) {
+    // Wait for the slot to be free.
+    WaitForDraw(sequence - kDrawQueueSize);
   }
 
+  DrawRequest &request = draw_queue_[sequence % kDrawQueueSize];
+  request.states_.swap(states);
+  request.media_states_.swap(media_states);
+  request.buffers_ = buffers;
+  request.disable_explicit_sync_ = disable_explicit_sync_;
   // We start of assuming that the draw calls
   // succeed.
-  draw_succeeded_ = true;
-  tasks_lock_.unlock();
+  request.succeeded_ = true;
+  queued_draws_.store(sequence, std::memory_order_release);
+  Resume();
+  return sequence;
+}
 
-  // Adding check to avoid waiting in this
-  // thread in certain corner case.
-  if (states_.empty() && media_states_.empty()) {
-    return draw_succeeded_;
+bool CompositorThread::WaitForDraw(uint64_t sequence) {
+  if (sequence == 0)
+    return true;
+
+  while (completed_draws_.load(std::memory_order_acquire) < sequence) {
+    if (!initialized_) {
+      ETRACE("CompositorThread exited with pending draws.");
+      return false;
+    }
+
+    Wait();
   }
 
-  Resume();
-  Wait();
-  return draw_succeeded_;
+  return draw_queue_[sequence % kDrawQueueSize].succeeded_;
 }
 
 void CompositorThread::ExitThread() {
   HWCThread::Exit();
-  std::vector<DrawState>().swap(states_);
-  std::vector<OverlayBuffer *>().swap(buffers_);
+  // Anything still queued will not be drawn anymore.
+  uint64_t queued = queued_draws_.load(std::memory_order_relaxed);
+  for (uint64_t i = completed_draws_.load(std::memory_order_relaxed) + 1;
+       i <= queued; i++) {
+    draw_queue_[i % kDrawQueueSize].succeeded_ = false;
+  }
+
+  completed_draws_.store(queued, std::memory_order_release);
+  for (uint32_t i = 0; i < kDrawQueueSize; i++) {
+    DrawRequest &request = draw_queue_[i];
+    std::vector<DrawState>().swap(request.states_);
+    std::vector<DrawState>().swap(request.media_states_);
+    std::vector<OverlayBuffer *>().swap(request.buffers_);
+  }
 }
 
 void CompositorThread::HandleExit() {
@@ -124,22 +164,30 @@ void CompositorThread::HandleExit() {
 }
 
 void CompositorThread::HandleRoutine() {
-  bool signal = false;
-  if (tasks_ & kRender3D) {
-    Handle3DDrawRequest();
-    signal = true;
-  }
-
-  if (tasks_ & kRenderMedia) {
-    HandleMediaDrawRequest();
-    signal = true;
-  }
+  HandleDrawRequests();
 
   if (tasks_ & kReleaseResources) {
     HandleReleaseRequest();
   }
 
-  if (signal) {
+  if (tasks_ & kWarmUp) {
+    HandleWarmUpRequest();
+  }
+}
+
+void CompositorThread::HandleDrawRequests() {
+  uint64_t queued = queued_draws_.load(std::memory_order_acquire);
+  uint64_t completed = completed_draws_.load(std::memory_order_relaxed);
+  while (completed < queued) {
+    completed++;
+    DrawRequest &request = draw_queue_[completed % kDrawQueueSize];
+    if (!request.states_.empty())
+      Handle3DDrawRequest(request);
+
+    if (!request.media_states_.empty())
+      HandleMediaDrawRequest(request);
+
+    completed_draws_.store(completed, std::memory_order_release);
     cevent_.Signal();
   }
 }
@@ -201,31 +249,27 @@ void CompositorThread::HandleReleaseRequest() {
   }
 }
 
-void CompositorThread::Handle3DDrawRequest() {
-  tasks_lock_.lock();
-  tasks_ &= ~kRender3D;
-  tasks_lock_.unlock();
-
+void CompositorThread::Handle3DDrawRequest(DrawRequest &request) {
   Ensure3DRenderer();
   if (!gl_renderer_) {
-    draw_succeeded_ = false;
+    request.succeeded_ = false;
     return;
   }
 
-  gl_renderer_->SetDisableExplicitSync(disable_explicit_sync_);
+  gl_renderer_->SetDisableExplicitSync(request.disable_explicit_sync_);
 
-  if (!gpu_resource_handler_->PrepareResources(buffers_)) {
+  if (!gpu_resource_handler_->PrepareResources(request.buffers_)) {
     ETRACE(
         "Failed to prepare GPU resources for compositing the frame, "
         "error: %s",
         PRINTERROR());
-    draw_succeeded_ = false;
+    request.succeeded_ = false;
     return;
   }
 
-  size_t size = states_.size();
+  size_t size = request.states_.size();
   for (size_t i = 0; i < size; i++) {
-    DrawState &draw_state = states_.at(i);
+    DrawState &draw_state = request.states_.at(i);
     for (RenderState &render_state : draw_state.states_) {
       std::vector<RenderState::LayerState> &layer_state =
           render_state.layer_state_;
@@ -248,12 +292,12 @@ void CompositorThread::Handle3DDrawRequest() {
           "Failed to Draw: "
           "error: %s",
           PRINTERROR());
-      draw_succeeded_ = false;
+      request.succeeded_ = false;
       break;
     }
 
     if (draw_state.destroy_surface_) {
-      if (draw_succeeded_) {
+      if (request.succeeded_) {
         draw_state.retire_fence_ =
             draw_state.surface_->GetLayer()->ReleaseAcquireFence();
       }
@@ -262,35 +306,41 @@ void CompositorThread::Handle3DDrawRequest() {
     }
   }
 
-  if (disable_explicit_sync_)
+  if (request.disable_explicit_sync_)
     gl_renderer_->InsertFence(-1);
 }
 
-void CompositorThread::HandleMediaDrawRequest() {
-  tasks_lock_.lock();
-  tasks_ &= ~kRenderMedia;
-  tasks_lock_.unlock();
-
+void CompositorThread::HandleMediaDrawRequest(DrawRequest &request) {
   EnsureMediaRenderer();
   if (!media_renderer_) {
-    draw_succeeded_ = false;
+    request.succeeded_ = false;
     return;
   }
 
-  size_t size = media_states_.size();
+  size_t size = request.media_states_.size();
   for (size_t i = 0; i < size; i++) {
-    DrawState &draw_state = media_states_[i];
+    DrawState &draw_state = request.media_states_[i];
     if (!media_renderer_->Draw(draw_state.media_state_, draw_state.surface_)) {
       ETRACE(
           "Failed to render the frame by VA, "
           "error: %s\n",
           PRINTERROR());
-      draw_succeeded_ = false;
+      request.succeeded_ = false;
       break;
     }
   }
 }
 
+void CompositorThread::HandleWarmUpRequest() {
+  tasks_lock_.lock();
+  tasks_ &= ~kWarmUp;
+  tasks_lock_.unlock();
+
+  Ensure3DRenderer();
+  if (gl_renderer_)
+    gl_renderer_->WarmUp(GpuDevice::getInstance().GetCompositorWarmUpLayers());
+}
+
 void CompositorThread::Ensure3DRenderer() {
   if (!gl_renderer_) {
     gl_renderer_.reset(Create3DRenderer());
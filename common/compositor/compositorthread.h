@@ -20,6 +20,7 @@
 #include <platformdefines.h>
 #include <spinlock.h>
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -49,24 +50,53 @@ class CompositorThread : public HWCThread {
             std::vector<DrawState>& media_states,
             const std::vector<OverlayBuffer*>& buffers);
 
+  // Queues states and media_states for drawing and returns without waiting
+  // for them to be drawn. Only blocks if kDrawQueueSize draws are still
+  // pending. Contents of the states drawn kDrawQueueSize draws earlier are
+  // swapped into states and media_states. Returns a sequence number to be
+  // passed to WaitForDraw, 0 if there was nothing to draw.
+  uint64_t QueueDraw(std::vector<DrawState>& states,
+                     std::vector<DrawState>& media_states,
+                     const std::vector<OverlayBuffer*>& buffers);
+
+  // Waits till draw with sequence number has been submitted to the GPU,
+  // i.e. fences of its surfaces are set. Returns false if drawing failed.
+  bool WaitForDraw(uint64_t sequence);
+
   void SetDisableExplicitSync(bool disable_explicit_sync);
   void FreeResources();
 
+  // Asynchronously prepares the 3D renderer for the layer counts returned
+  // by GpuDevice::GetCompositorWarmUpLayers().
+  void WarmUp();
+
   void HandleRoutine() override;
   void HandleExit() override;
   void ExitThread();
 
  private:
   enum Tasks {
-    kNone = 0,           // No tasks
-    kRender3D = 1 << 1,  // Render content.
-    kRenderMedia = 1 << 2,
-    kReleaseResources = 1 << 3  // Release surfaces from plane manager.
+    kNone = 0,                   // No tasks
+    kReleaseResources = 1 << 3,  // Release surfaces from plane manager.
+    kWarmUp = 1 << 4             // Prepare 3D renderer.
+  };
+
+  // Number of draws which can be queued before QueueDraw blocks.
+  static const uint32_t kDrawQueueSize = 4;
+
+  struct DrawRequest {
+    std::vector<DrawState> states_;
+    std::vector<DrawState> media_states_;
+    std::vector<OverlayBuffer*> buffers_;
+    bool disable_explicit_sync_ = false;
+    bool succeeded_ = false;
   };
 
-  void Handle3DDrawRequest();
-  void HandleMediaDrawRequest();
+  void HandleDrawRequests();
+  void Handle3DDrawRequest(DrawRequest& request);
+  void HandleMediaDrawRequest(DrawRequest& request);
   void HandleReleaseRequest();
+  void HandleWarmUpRequest();
   void Wait();
   void Ensure3DRenderer();
   void EnsureMediaRenderer();
@@ -75,12 +105,13 @@ class CompositorThread : public HWCThread {
   std::unique_ptr<Renderer> gl_renderer_;
   std::unique_ptr<Renderer> media_renderer_;
   std::unique_ptr<NativeGpuResource> gpu_resource_handler_;
-  std::vector<OverlayBuffer*> buffers_;
-  std::vector<DrawState> states_;
-  std::vector<DrawState> media_states_;
+  // Single producer (present thread), single consumer (this thread) ring
+  // of draws. Draw with sequence number n lives in slot n % kDrawQueueSize.
+  DrawRequest draw_queue_[kDrawQueueSize];
+  std::atomic<uint64_t> queued_draws_{0};
+  std::atomic<uint64_t> completed_draws_{0};
   std::vector<ResourceHandle> purged_resources_;
   bool disable_explicit_sync_ = false;
-  bool draw_succeeded_ = false;
   ResourceManager* resource_manager_ = NULL;
   uint32_t tasks_ = kNone;
   uint32_t gpu_fd_ = 0;
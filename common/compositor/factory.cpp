@@ -27,6 +27,11 @@
 #include "nativevkresource.h"
 #include "vkrenderer.h"
 #include "vksurface.h"
+#elif USE_SW
+#include <gpudevice.h>
+#include "nativeswresource.h"
+#include "swrenderer.h"
+#include "swsurface.h"
 #endif
 
 #ifndef DISABLE_VA
@@ -40,6 +45,8 @@ NativeSurface* Create3DSurface(uint32_t width, uint32_t height) {
   return new GLSurface(width, height);
 #elif USE_VK
   return new VKSurface(width, height);
+#elif USE_SW
+  return new SWSurface(width, height);
 #else
   return NULL;
 #endif
@@ -54,6 +61,9 @@ Renderer* Create3DRenderer() {
   return new GLRenderer();
 #elif USE_VK
   return new VKRenderer();
+#elif USE_SW
+  return new SWRenderer(
+      GpuDevice::getInstance().IsSoftwareCompositorReferenceEnabled());
 #else
   return NULL;
 #endif
@@ -76,6 +86,8 @@ NativeGpuResource* CreateNativeGpuResourceHandler() {
   return new NativeGLResource();
 #elif USE_VK
   return new NativeVKResource();
+#elif USE_SW
+  return new NativeSWResource();
 #else
   return NULL;
 #endif
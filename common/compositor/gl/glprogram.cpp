@@ -19,6 +19,7 @@
 #include <string>
 #include <sstream>
 
+#include "glprogramcache.h"
 #include "hwctrace.h"
 #include "renderstate.h"
 
@@ -58,7 +59,7 @@ static GLint CompileAndCheckShader(GLenum type, unsigned source_count,
   return shader;
 }
 
-static std::string GenerateVertexShader(int layer_count) {
+static std::string GenerateVertexShader(int layer_count, uint32_t features) {
   std::ostringstream vertex_shader_stream;
   vertex_shader_stream
       << "#version 300 es\n"
@@ -71,8 +72,14 @@ static std::string GenerateVertexShader(int layer_count) {
       << "in vec2 vTexCoords;\n"
       << "out vec2 fTexCoords[LAYER_COUNT];\n"
       << "void main() {\n"
-      << "  for (int i = 0; i < LAYER_COUNT; i++) {\n"
-      << "    vec2 tempCoords = vTexCoords * uTexMatrix[i];\n"
+      << "  for (int i = 0; i < LAYER_COUNT; i++) {\n";
+  if (features & kRenderTransform) {
+    vertex_shader_stream
+        << "    vec2 tempCoords = vTexCoords * uTexMatrix[i];\n";
+  } else {
+    vertex_shader_stream << "    vec2 tempCoords = vTexCoords;\n";
+  }
+  vertex_shader_stream
       << "    fTexCoords[i] =\n"
       << "        uLayerCrop[i].xy + tempCoords * uLayerCrop[i].zw;\n"
       << "  }\n"
@@ -83,7 +90,75 @@ static std::string GenerateVertexShader(int layer_count) {
   return vertex_shader_stream.str();
 }
 
-static std::string GenerateFragmentShader(int layer_count) {
+// Appends blending of a layer below the ones blended so far, leaving out
+// the terms for RenderFeatures which aren't set in features.
+static void AppendLayerBlending(std::ostringstream &stream, uint32_t features,
+                                const std::string &sample,
+                                const std::string &alpha,
+                                const std::string &premult,
+                                const std::string &color) {
+  stream << "  texSample = " << sample << ";\n";
+  if (features & kRenderSolidColor)
+    stream << "  texSample.rgb = texSample.rgb + " << color << ".rgb;\n";
+
+  // Premultiplied layers use the color as it is.
+  if (features & kRenderCoverage) {
+    if (features & kRenderSolidColor) {
+      stream << "  tempAlpha = min(texSample.a, " << color << ".a);\n";
+    } else {
+      stream << "  tempAlpha = texSample.a;\n";
+    }
+
+    stream << "  multRgb = texSample.rgb *\n"
+           << "            max(tempAlpha, " << premult << ");\n";
+  } else {
+    stream << "  multRgb = texSample.rgb;\n";
+  }
+
+  if (features & kRenderPlaneAlpha) {
+    stream << "  color += multRgb * " << alpha << " * alphaCover;\n"
+           << "  alphaCover *= 1.0 - texSample.a * " << alpha << ";\n";
+  } else {
+    stream << "  color += multRgb * alphaCover;\n"
+           << "  alphaCover *= 1.0 - texSample.a;\n";
+  }
+}
+
+// Appends main function of the fragment shader. samples holds the
+// expressions sampling each layer, params the ones holding alpha and
+// premult of each layer and colors the ones holding its solid color.
+static void AppendFragmentMain(std::ostringstream &stream, uint32_t features,
+                               const std::vector<std::string> &samples,
+                               const std::vector<std::string> &alphas,
+                               const std::vector<std::string> &premults,
+                               const std::vector<std::string> &colors) {
+  size_t layer_count = samples.size();
+  stream << "void main() {\n";
+  // Blending a single layer without any of the features is a copy.
+  if (layer_count == 1 && !features) {
+    stream << "  oFragColor = " << samples[0] << ";\n"
+           << "}\n";
+    return;
+  }
+
+  stream << "  vec3 color = vec3(0.0, 0.0, 0.0);\n"
+         << "  float alphaCover = 1.0;\n"
+         << "  vec4 texSample;\n"
+         << "  vec3 multRgb;\n"
+         << "  float tempAlpha;\n";
+  for (size_t i = 0; i < layer_count; ++i) {
+    if (i > 0)
+      stream << "  if (alphaCover > 0.5/255.0) {\n";
+    AppendLayerBlending(stream, features, samples[i], alphas[i], premults[i],
+                        colors[i]);
+  }
+  for (size_t i = 1; i < layer_count; ++i)
+    stream << "  }\n";
+  stream << "  oFragColor = vec4(color, 1.0 - alphaCover);\n"
+         << "}\n";
+}
+
+static std::string GenerateFragmentShader(int layer_count, uint32_t features) {
   std::ostringstream fragment_shader_stream;
   fragment_shader_stream << "#version 300 es\n"
                          << "#define LAYER_COUNT " << layer_count << "\n"
@@ -97,41 +172,168 @@ static std::string GenerateFragmentShader(int layer_count) {
                          << "uniform float uLayerPremult[LAYER_COUNT];\n"
                          << "uniform vec4 uLayerColor[LAYER_COUNT];\n"
                          << "in vec2 fTexCoords[LAYER_COUNT];\n"
-                         << "out vec4 oFragColor;\n"
-                         << "void main() {\n"
-                         << "  vec3 color = vec3(0.0, 0.0, 0.0);\n"
-                         << "  float alphaCover = 1.0;\n"
-                         << "  vec4 texSample;\n"
-                         << "  vec3 multRgb;\n"
-                         << "  float tempAlpha;\n";
+                         << "out vec4 oFragColor;\n";
+  std::vector<std::string> samples, alphas, premults, colors;
   for (int i = 0; i < layer_count; ++i) {
-    if (i > 0)
-      fragment_shader_stream << "  if (alphaCover > 0.5/255.0) {\n";
-    // clang-format off
-    fragment_shader_stream << "  texSample = texture2D(uLayerTexture" << i
-                           << ",\n"
-                           << "                        fTexCoords[" << i
-                           << "]);\n"
-                           << "  texSample.rgb = texSample.rgb + uLayerColor[" << i
-                           << "].rgb;\n"
-                           << "  tempAlpha = min(texSample.a, uLayerColor[" << i
-                           << "].a);\n"
-                           << "  multRgb = texSample.rgb *\n"
-                           << "            max(tempAlpha, uLayerPremult[" << i
-                           << "]);\n"
-                           << "  color += multRgb * uLayerAlpha[" << i
-                           << "] * alphaCover;\n"
-                           << "  alphaCover *= 1.0 - texSample.a * uLayerAlpha["
-                           << i << "];\n";
-    // clang-format on
-  }
-  for (int i = 0; i < layer_count - 1; ++i)
-    fragment_shader_stream << "  }\n";
-  fragment_shader_stream << "  oFragColor = vec4(color, 1.0 - alphaCover);\n"
-                         << "}\n";
+    std::ostringstream sample, alpha, premult, color;
+    sample << "texture2D(uLayerTexture" << i << ", fTexCoords[" << i << "])";
+    alpha << "uLayerAlpha[" << i << "]";
+    premult << "uLayerPremult[" << i << "]";
+    color << "uLayerColor[" << i << "]";
+    samples.emplace_back(sample.str());
+    alphas.emplace_back(alpha.str());
+    premults.emplace_back(premult.str());
+    colors.emplace_back(color.str());
+  }
+
+  AppendFragmentMain(fragment_shader_stream, features, samples, alphas,
+                     premults, colors);
   return fragment_shader_stream.str();
 }
 
+// Batched shaders draw all regions using the same number of layers with
+// a single draw call. Per region state is passed as vertex attributes,
+// which are constant across a region's quad, and layers sample from one of
+// kMaxBatchTextures textures bound for the whole batch.
+static std::string GenerateBatchedVertexShader(int layer_count) {
+  std::ostringstream vertex_shader_stream;
+  vertex_shader_stream << "#version 300 es\n"
+                       << "#define LAYER_COUNT " << layer_count << "\n"
+                       << "precision mediump int;\n"
+                       << "in vec2 vPosition;\n";
+  for (int i = 0; i < layer_count; ++i) {
+    vertex_shader_stream << "in vec2 vTexCoords" << i << ";\n"
+                         << "in vec4 vLayerParams" << i << ";\n"
+                         << "in vec4 vLayerColor" << i << ";\n";
+  }
+  vertex_shader_stream << "out vec2 fTexCoords[LAYER_COUNT];\n"
+                       << "flat out vec4 fLayerParams[LAYER_COUNT];\n"
+                       << "flat out vec4 fLayerColor[LAYER_COUNT];\n"
+                       << "void main() {\n";
+  for (int i = 0; i < layer_count; ++i) {
+    vertex_shader_stream << "  fTexCoords[" << i << "] = vTexCoords" << i
+                         << ";\n"
+                         << "  fLayerParams[" << i << "] = vLayerParams" << i
+                         << ";\n"
+                         << "  fLayerColor[" << i << "] = vLayerColor" << i
+                         << ";\n";
+  }
+  vertex_shader_stream << "  gl_Position = vec4(vPosition, 0.0, 1.0);\n"
+                       << "}\n";
+  return vertex_shader_stream.str();
+}
+
+static std::string GenerateBatchedFragmentShader(int layer_count,
+                                                 uint32_t features) {
+  std::ostringstream fragment_shader_stream;
+  fragment_shader_stream << "#version 300 es\n"
+                         << "#define LAYER_COUNT " << layer_count << "\n"
+                         << "#extension GL_OES_EGL_image_external : require\n"
+                         << "precision mediump float;\n";
+  for (unsigned i = 0; i < kMaxBatchTextures; ++i) {
+    fragment_shader_stream << "uniform samplerExternalOES uLayerTexture" << i
+                           << ";\n";
+  }
+  // Samplers can't be indexed dynamically, select the texture unit with
+  // a branch which is uniform across each region.
+  fragment_shader_stream << "vec4 SampleLayer(int unit, vec2 coords) {\n";
+  for (unsigned i = 0; i < kMaxBatchTextures - 1; ++i) {
+    fragment_shader_stream << "  if (unit == " << i << ")\n"
+                           << "    return texture2D(uLayerTexture" << i
+                           << ", coords);\n";
+  }
+  fragment_shader_stream << "  return texture2D(uLayerTexture"
+                         << kMaxBatchTextures - 1 << ", coords);\n"
+                         << "}\n"
+                         << "in vec2 fTexCoords[LAYER_COUNT];\n"
+                         << "flat in vec4 fLayerParams[LAYER_COUNT];\n"
+                         << "flat in vec4 fLayerColor[LAYER_COUNT];\n"
+                         << "out vec4 oFragColor;\n";
+  std::vector<std::string> samples, alphas, premults, colors;
+  for (int i = 0; i < layer_count; ++i) {
+    std::ostringstream sample, alpha, premult, color;
+    sample << "SampleLayer(int(fLayerParams[" << i << "].z), fTexCoords[" << i
+           << "])";
+    alpha << "fLayerParams[" << i << "].x";
+    premult << "fLayerParams[" << i << "].y";
+    color << "fLayerColor[" << i << "]";
+    samples.emplace_back(sample.str());
+    alphas.emplace_back(alpha.str());
+    premults.emplace_back(premult.str());
+    colors.emplace_back(color.str());
+  }
+
+  AppendFragmentMain(fragment_shader_stream, features, samples, alphas,
+                     premults, colors);
+  return fragment_shader_stream.str();
+}
+
+static GLint GenerateBatchedProgram(unsigned num_textures, uint32_t features,
+                                    std::ostringstream *shader_log) {
+  GLint status;
+  GLint program = glCreateProgram();
+  if (!program) {
+    if (shader_log)
+      *shader_log << "Failed to create program."
+                  << "\n";
+    return 0;
+  }
+
+  std::string vertex_shader_string = GenerateBatchedVertexShader(num_textures);
+  const GLchar *vertex_shader_source = vertex_shader_string.c_str();
+  GLint vertex_shader = CompileAndCheckShader(
+      GL_VERTEX_SHADER, 1, &vertex_shader_source, shader_log);
+  if (!vertex_shader) {
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  std::string fragment_shader_string =
+      GenerateBatchedFragmentShader(num_textures, features);
+  const GLchar *fragment_shader_source = fragment_shader_string.c_str();
+  GLint fragment_shader = CompileAndCheckShader(
+      GL_FRAGMENT_SHADER, 1, &fragment_shader_source, shader_log);
+  if (!fragment_shader) {
+    glDeleteShader(vertex_shader);
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  glBindAttribLocation(program, 0, "vPosition");
+  for (unsigned i = 0; i < num_textures; i++) {
+    std::ostringstream tex_coords, params, color;
+    tex_coords << "vTexCoords" << i;
+    params << "vLayerParams" << i;
+    color << "vLayerColor" << i;
+    glBindAttribLocation(program, 1 + i * 3, tex_coords.str().c_str());
+    glBindAttribLocation(program, 2 + i * 3, params.str().c_str());
+    glBindAttribLocation(program, 3 + i * 3, color.str().c_str());
+  }
+
+  glLinkProgram(program);
+  glDetachShader(program, vertex_shader);
+  glDetachShader(program, fragment_shader);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (!status) {
+    if (shader_log) {
+      GLint log_length;
+      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
+      std::string program_log(log_length, ' ');
+      glGetProgramInfoLog(program, log_length, NULL, &program_log.front());
+      *shader_log << "Failed to link program:\n" << program_log.c_str() << "\n";
+    }
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
+}
+
 #if defined(LOAD_PREBUILT_SHADER_FILE) || defined(USE_PREBUILT_SHADER_BIN_ARRAY)
 static GLint LoadPreBuiltBinary(GLint gl_program, void *binary, long size) {
   GLint status;
@@ -158,7 +360,7 @@ static GLint LoadPreBuiltBinary(GLint gl_program, void *binary, long size) {
 #include "glprebuiltshaderarray.h"
 #endif
 
-static GLint GenerateProgram(unsigned num_textures,
+static GLint GenerateProgram(unsigned num_textures, uint32_t features,
                              std::ostringstream *shader_log) {
   GLint status;
   GLint program = glCreateProgram();
@@ -177,8 +379,9 @@ static GLint GenerateProgram(unsigned num_textures,
 #ifdef USE_PREBUILT_SHADER_BIN_ARRAY
   /* try to retrieve shader binary program from built-in arrays */
 
-  /* support only up to 16 layers */
-  if (num_textures > 0 && num_textures < 17) {
+  /* support only up to 16 layers, pre-built programs are generic ones */
+  if (num_textures > 0 && num_textures < 17 &&
+      features == kRenderAllFeatures) {
     /* first long is the size of binary */
     binary_sz = *(long *)shader_prog_arrays[num_textures - 1];
     binary_prog =
@@ -205,9 +408,10 @@ static GLint GenerateProgram(unsigned num_textures,
   shader_program_fname << PREBUILT_SHADER_FILE_PATH "/hwc_shader_prog_"
                        << num_textures << ".shader_test.bin";
 
-  FILE *shader_prog_fp;
+  FILE *shader_prog_fp = NULL;
 
-  shader_prog_fp = fopen(shader_program_fname.str().c_str(), "rb");
+  if (features == kRenderAllFeatures)
+    shader_prog_fp = fopen(shader_program_fname.str().c_str(), "rb");
 
   if (!shader_prog_fp)
     goto fail_file_open;
@@ -252,14 +456,16 @@ fail_file_open:
                 << "now trying run-time build\n";
 #endif
 
-  std::string vertex_shader_string = GenerateVertexShader(num_textures);
+  std::string vertex_shader_string =
+      GenerateVertexShader(num_textures, features);
   const GLchar *vertex_shader_source = vertex_shader_string.c_str();
   GLint vertex_shader = CompileAndCheckShader(
       GL_VERTEX_SHADER, 1, &vertex_shader_source, shader_log);
   if (!vertex_shader)
     return 0;
 
-  std::string fragment_shader_string = GenerateFragmentShader(num_textures);
+  std::string fragment_shader_string =
+      GenerateFragmentShader(num_textures, features);
   const GLchar *fragment_shader_source = fragment_shader_string.c_str();
   GLint fragment_shader = CompileAndCheckShader(
       GL_FRAGMENT_SHADER, 1, &fragment_shader_source, shader_log);
@@ -302,6 +508,8 @@ GLProgram::GLProgram()
       premult_loc_(0),
       tex_matrix_loc_(0),
       solid_color_loc_(0),
+      layer_count_(0),
+      batched_(false),
       initialized_(false) {
 }
 
@@ -310,19 +518,163 @@ GLProgram::~GLProgram() {
     glDeleteProgram(program_);
 }
 
-bool GLProgram::Init(unsigned texture_count) {
+bool GLProgram::LoadCachedProgram(const std::string &name,
+                                  GLProgramCache *cache) {
+  if (!cache)
+    return false;
+
+  program_ = glCreateProgram();
+  if (!program_)
+    return false;
+
+  if (cache->LoadProgram(name, program_))
+    return true;
+
+  glDeleteProgram(program_);
+  program_ = 0;
+  return false;
+}
+
+bool GLProgram::Init(unsigned texture_count, uint32_t features,
+                     GLProgramCache *cache) {
+  std::ostringstream name;
+  name << "layers_" << texture_count;
+  if (features != kRenderAllFeatures)
+    name << "_f" << features;
+  layer_count_ = texture_count;
+  if (LoadCachedProgram(name.str(), cache))
+    return true;
+
   std::ostringstream shader_log;
-  program_ = GenerateProgram(texture_count, &shader_log);
+  program_ = GenerateProgram(texture_count, features, &shader_log);
   if (!program_) {
     ETRACE("%s", shader_log.str().c_str());
     return false;
   }
 
+  if (cache)
+    cache->StoreProgram(name.str(), program_);
+
   return true;
 }
 
+bool GLProgram::InitBatched(unsigned texture_count, uint32_t features,
+                            GLProgramCache *cache) {
+  if (texture_count == 0 || texture_count > kMaxBatchLayers)
+    return false;
+
+  std::ostringstream name;
+  name << "batched_" << texture_count << "_" << kMaxBatchTextures;
+  if (features != kRenderAllFeatures)
+    name << "_f" << features;
+  layer_count_ = texture_count;
+  batched_ = true;
+  if (LoadCachedProgram(name.str(), cache))
+    return true;
+
+  std::ostringstream shader_log;
+  program_ = GenerateBatchedProgram(texture_count, features, &shader_log);
+  if (!program_) {
+    ETRACE("%s", shader_log.str().c_str());
+    return false;
+  }
+
+  if (cache)
+    cache->StoreProgram(name.str(), program_);
+
+  return true;
+}
+
+size_t GLProgram::GetBatchVertexSize(unsigned texture_count) {
+  // Position, followed by texture coordinates, params and color per layer.
+  return 2 + texture_count * (2 + 4 + 4);
+}
+
+void GLProgram::AppendBatchVertices(const RenderState &state,
+                                    const uint32_t *texture_units,
+                                    GLuint viewport_width,
+                                    GLuint viewport_height,
+                                    std::vector<GLfloat> *vertices) {
+  // Two triangles covering exactly the region, the scissor rect of the
+  // regular path.
+  static const GLfloat corners[6][2] = {{0.0f, 0.0f}, {1.0f, 0.0f},
+                                        {0.0f, 1.0f}, {0.0f, 1.0f},
+                                        {1.0f, 0.0f}, {1.0f, 1.0f}};
+  unsigned size = state.layer_state_.size();
+  for (unsigned v = 0; v < 6; v++) {
+    float x = corners[v][0];
+    float y = corners[v][1];
+    vertices->push_back((state.x_ + x * state.width_) / viewport_width * 2.0f -
+                        1.0f);
+    vertices->push_back(
+        (state.y_ + y * state.height_) / viewport_height * 2.0f - 1.0f);
+    for (unsigned src_index = 0; src_index < size; src_index++) {
+      const RenderState::LayerState &src = state.layer_state_[src_index];
+      const float *crop = src.crop_bounds_;
+      const float *matrix = src.texture_matrix_;
+      float tex_x = x * matrix[0] + y * matrix[1];
+      float tex_y = x * matrix[2] + y * matrix[3];
+      vertices->push_back(crop[0] + tex_x * (crop[2] - crop[0]));
+      vertices->push_back(crop[1] + tex_y * (crop[3] - crop[1]));
+      vertices->push_back(src.alpha_);
+      vertices->push_back(src.premult_);
+      vertices->push_back(static_cast<float>(texture_units[src_index]));
+      vertices->push_back(0.0f);
+      vertices->push_back((float)src.solid_color_array_[3]);
+      vertices->push_back((float)src.solid_color_array_[2]);
+      vertices->push_back((float)src.solid_color_array_[1]);
+      vertices->push_back((float)src.solid_color_array_[0]);
+    }
+  }
+}
+
+void GLProgram::UseBatchedProgram(
+    const std::vector<GpuResourceHandle> &textures) {
+  glUseProgram(program_);
+  if (!initialized_) {
+    for (unsigned unit = 0; unit < kMaxBatchTextures; unit++) {
+      std::ostringstream texture_name_formatter;
+      texture_name_formatter << "uLayerTexture" << unit;
+      GLuint tex_loc =
+          glGetUniformLocation(program_, texture_name_formatter.str().c_str());
+      glUniform1i(tex_loc, unit);
+    }
+
+    initialized_ = true;
+  }
+
+  GLsizei stride = GetBatchVertexSize(layer_count_) * sizeof(GLfloat);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, NULL);
+  glEnableVertexAttribArray(0);
+  size_t offset = 2;
+  for (unsigned i = 0; i < layer_count_; i++) {
+    GLuint location = 1 + i * 3;
+    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(offset * sizeof(GLfloat)));
+    glVertexAttribPointer(location + 1, 4, GL_FLOAT, GL_FALSE, stride,
+                          (void *)((offset + 2) * sizeof(GLfloat)));
+    glVertexAttribPointer(location + 2, 4, GL_FLOAT, GL_FALSE, stride,
+                          (void *)((offset + 6) * sizeof(GLfloat)));
+    glEnableVertexAttribArray(location);
+    glEnableVertexAttribArray(location + 1);
+    glEnableVertexAttribArray(location + 2);
+    offset += 10;
+  }
+
+  size_t size = textures.size();
+  for (size_t unit = 0; unit < size; unit++) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, textures[unit]);
+  }
+}
+
 void GLProgram::UseProgram(const RenderState &state, GLuint viewport_width,
                            GLuint viewport_height) {
+  if (batched_) {
+    ETRACE("UseProgram called for batched program.");
+    return;
+  }
+
   glUseProgram(program_);
   unsigned size = state.layer_state_.size();
   if (!initialized_) {
@@ -348,21 +700,27 @@ void GLProgram::UseProgram(const RenderState &state, GLuint viewport_width,
               (state.width_) / (float)viewport_width,
               (state.height_) / (float)viewport_height);
 
+  // Uniforms not used by a variant are optimized out and have no location.
   for (unsigned src_index = 0; src_index < size; src_index++) {
     const RenderState::LayerState &src = state.layer_state_[src_index];
-    glUniform1f(alpha_loc_ + src_index, src.alpha_);
-    glUniform1f(premult_loc_ + src_index, src.premult_);
+    if (alpha_loc_ >= 0)
+      glUniform1f(alpha_loc_ + src_index, src.alpha_);
+    if (premult_loc_ >= 0)
+      glUniform1f(premult_loc_ + src_index, src.premult_);
     glUniform4f(crop_loc_ + src_index, src.crop_bounds_[0], src.crop_bounds_[1],
                 src.crop_bounds_[2] - src.crop_bounds_[0],
                 src.crop_bounds_[3] - src.crop_bounds_[1]);
-    glUniformMatrix2fv(tex_matrix_loc_ + src_index, 1, GL_FALSE,
-                       src.texture_matrix_);
+    if (tex_matrix_loc_ >= 0)
+      glUniformMatrix2fv(tex_matrix_loc_ + src_index, 1, GL_FALSE,
+                         src.texture_matrix_);
     glActiveTexture(GL_TEXTURE0 + src_index);
     glBindTexture(GL_TEXTURE_EXTERNAL_OES, src.handle_);
-    glUniform4f(solid_color_loc_ + src_index, (float)src.solid_color_array_[3],
-                (float)src.solid_color_array_[2],
-                (float)src.solid_color_array_[1],
-                (float)src.solid_color_array_[0]);
+    if (solid_color_loc_ >= 0)
+      glUniform4f(solid_color_loc_ + src_index,
+                  (float)src.solid_color_array_[3],
+                  (float)src.solid_color_array_[2],
+                  (float)src.solid_color_array_[1],
+                  (float)src.solid_color_array_[0]);
   }
 }
 
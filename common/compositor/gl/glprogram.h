@@ -17,13 +17,23 @@
 #ifndef COMMON_COMPOSITOR_GL_GLPROGRAM_H_
 #define COMMON_COMPOSITOR_GL_GLPROGRAM_H_
 
+#include <stddef.h>
+
+#include <string>
 #include <vector>
 
+#include "compositordefs.h"
+#include "renderstate.h"
 #include "shim.h"
 
 namespace hwcomposer {
 
-struct RenderState;
+class GLProgramCache;
+
+// Maximum number of layers per region and number of textures which can be
+// sampled by a batched program.
+const unsigned kMaxBatchLayers = 4;
+const unsigned kMaxBatchTextures = 8;
 
 class GLProgram {
  public:
@@ -33,11 +43,38 @@ class GLProgram {
 
   ~GLProgram();
 
-  bool Init(unsigned texture_count);
+  // Binaries are loaded from and stored to cache if it's not NULL. Only
+  // the blending terms of RenderFeatures set in features are generated,
+  // i.e. the program can draw regions whose features are a subset of them.
+  bool Init(unsigned texture_count, uint32_t features = kRenderAllFeatures,
+            GLProgramCache* cache = NULL);
   void UseProgram(const RenderState& cmd, GLuint viewport_width,
                   GLuint viewport_height);
 
+  // Batched programs render any number of regions with texture_count
+  // layers each in one draw call. Region state is passed per vertex, see
+  // AppendBatchVertices.
+  bool InitBatched(unsigned texture_count,
+                   uint32_t features = kRenderAllFeatures,
+                   GLProgramCache* cache = NULL);
+
+  // Binds textures to texture units in order and sets up vertex attributes
+  // for vertices in the currently bound GL_ARRAY_BUFFER.
+  void UseBatchedProgram(const std::vector<GpuResourceHandle>& textures);
+
+  // Number of floats per vertex of a batched program.
+  static size_t GetBatchVertexSize(unsigned texture_count);
+
+  // Appends the vertices of state's region to vertices. texture_units holds
+  // the texture unit bound to each layer of state.
+  static void AppendBatchVertices(const RenderState& state,
+                                  const uint32_t* texture_units,
+                                  GLuint viewport_width, GLuint viewport_height,
+                                  std::vector<GLfloat>* vertices);
+
  private:
+  bool LoadCachedProgram(const std::string& name, GLProgramCache* cache);
+
   GLint program_;
   GLint viewport_loc_;
   GLint crop_loc_;
@@ -45,6 +82,8 @@ class GLProgram {
   GLint premult_loc_;
   GLint tex_matrix_loc_;
   GLint solid_color_loc_;
+  unsigned layer_count_;
+  bool batched_;
   bool initialized_;
 };
 
@@ -0,0 +1,170 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "glprogramcache.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sstream>
+#include <vector>
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+// Bump whenever generated shader source changes, binaries of an older
+// version are ignored.
+static const uint32_t kProgramCacheVersion = 1;
+static const uint32_t kProgramCacheMagic = 0x50435748;  // "HWCP"
+// Same limit as used for pre-built shader files.
+static const uint32_t kMaxProgramBinarySize = 10485760;
+
+struct ProgramCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t key_size;
+  uint32_t format;
+  uint32_t binary_size;
+};
+
+bool GLProgramCache::Init() {
+#ifdef GL_PROGRAM_CACHE_DIR
+  if (!glProgramBinaryOES || !glGetProgramBinaryOES)
+    return false;
+
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+  if (formats <= 0) {
+    ITRACE("Driver doesn't support program binaries.");
+    return false;
+  }
+
+  const char *vendor = (const char *)glGetString(GL_VENDOR);
+  const char *renderer = (const char *)glGetString(GL_RENDERER);
+  const char *version = (const char *)glGetString(GL_VERSION);
+  if (!vendor || !renderer || !version)
+    return false;
+
+  std::ostringstream key;
+  key << vendor << "|" << renderer << "|" << version;
+  key_ = key.str();
+  enabled_ = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::string GLProgramCache::GetFileName(const std::string &name) const {
+  std::ostringstream file_name;
+#ifdef GL_PROGRAM_CACHE_DIR
+  file_name << GL_PROGRAM_CACHE_DIR;
+#endif
+  file_name << "/hwc_program_" << name << ".bin";
+  return file_name.str();
+}
+
+bool GLProgramCache::LoadProgram(const std::string &name, GLuint program) {
+  if (!enabled_)
+    return false;
+
+  std::string file_name = GetFileName(name);
+  FILE *file = fopen(file_name.c_str(), "rb");
+  if (!file)
+    return false;
+
+  ProgramCacheHeader header;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+               header.magic == kProgramCacheMagic &&
+               header.version == kProgramCacheVersion &&
+               header.key_size == key_.size() &&
+               header.binary_size <= kMaxProgramBinarySize;
+
+  std::string key(header.key_size, ' ');
+  std::vector<uint8_t> binary;
+  if (valid) {
+    valid = fread(&key.front(), 1, key.size(), file) == key.size() &&
+            key == key_;
+  }
+
+  if (valid) {
+    binary.resize(header.binary_size);
+    valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+  }
+
+  fclose(file);
+  if (!valid) {
+    ITRACE("Ignoring stale or invalid program binary %s.", file_name.c_str());
+    return false;
+  }
+
+  glProgramBinaryOES(program, header.format, binary.data(), binary.size());
+  GLint status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (!status) {
+    ITRACE("Driver rejected program binary %s.", file_name.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+void GLProgramCache::StoreProgram(const std::string &name, GLuint program) {
+  if (!enabled_)
+    return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+  if (length <= 0 || static_cast<uint32_t>(length) > kMaxProgramBinarySize)
+    return;
+
+  std::vector<uint8_t> binary(length);
+  GLenum format = 0;
+  GLsizei size = 0;
+  glGetProgramBinaryOES(program, length, &size, &format, binary.data());
+  if (size <= 0)
+    return;
+
+  ProgramCacheHeader header;
+  header.magic = kProgramCacheMagic;
+  header.version = kProgramCacheVersion;
+  header.key_size = key_.size();
+  header.format = format;
+  header.binary_size = size;
+
+  // Write to a temporary file first, so that a crash doesn't leave a
+  // truncated binary behind.
+  std::string file_name = GetFileName(name);
+  std::string temp_name = file_name + ".tmp";
+  FILE *file = fopen(temp_name.c_str(), "wb");
+  if (!file) {
+    ITRACE("Failed to create program binary %s.", temp_name.c_str());
+    return;
+  }
+
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(key_.data(), 1, key_.size(), file) == key_.size() &&
+                 fwrite(binary.data(), 1, size, file) ==
+                     static_cast<size_t>(size);
+  written &= fclose(file) == 0;
+  if (!written || rename(temp_name.c_str(), file_name.c_str())) {
+    ETRACE("Failed to store program binary %s.", file_name.c_str());
+    remove(temp_name.c_str());
+  }
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,55 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_COMPOSITOR_GL_GLPROGRAMCACHE_H_
+#define COMMON_COMPOSITOR_GL_GLPROGRAMCACHE_H_
+
+#include <string>
+
+#include "shim.h"
+
+namespace hwcomposer {
+
+// Persists linked program binaries to GL_PROGRAM_CACHE_DIR so shaders are
+// compiled only once per driver version instead of on every start. Each
+// program is stored in its own file together with a key built from the GL
+// vendor, renderer and version strings. A binary is only used if its key
+// matches the running driver and the driver accepts it.
+class GLProgramCache {
+ public:
+  GLProgramCache() = default;
+  GLProgramCache(const GLProgramCache& rhs) = delete;
+  GLProgramCache& operator=(const GLProgramCache& rhs) = delete;
+
+  // Needs a current context. Returns false if binaries can't be cached.
+  bool Init();
+
+  // Loads binary of program name into program. Returns false if there is
+  // no valid binary, program needs to be compiled in that case.
+  bool LoadProgram(const std::string& name, GLuint program);
+
+  // Stores binary of linked program as name.
+  void StoreProgram(const std::string& name, GLuint program);
+
+ private:
+  std::string GetFileName(const std::string& name) const;
+
+  std::string key_;
+  bool enabled_ = false;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_COMPOSITOR_GL_GLPROGRAMCACHE_H_
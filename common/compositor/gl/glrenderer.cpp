@@ -16,6 +16,8 @@
 
 #include "glrenderer.h"
 
+#include <algorithm>
+
 #include "glprogram.h"
 #include "hwctrace.h"
 #include "nativesurface.h"
@@ -35,6 +37,12 @@ GLRenderer::~GLRenderer() {
 
   if (vertex_array_)
     glDeleteVertexArraysOES(1, &vertex_array_);
+
+  if (batch_vertex_array_)
+    glDeleteVertexArraysOES(1, &batch_vertex_array_);
+
+  if (batch_vertex_buffer_)
+    glDeleteBuffers(1, &batch_vertex_buffer_);
 }
 
 bool GLRenderer::Init() {
@@ -53,6 +61,7 @@ bool GLRenderer::Init() {
   }
 
   InitializeShims();
+  program_cache_.Init();
 
   // generate the VAO & bind
   GLuint vertex_array;
@@ -66,7 +75,7 @@ bool GLRenderer::Init() {
 
   for (int i = 1; i < 5; i++) {
     std::unique_ptr<GLProgram> program(new GLProgram());
-    if (program->Init(i)) {
+    if (program->Init(i, kRenderAllFeatures, &program_cache_)) {
       programs_.emplace_back(std::move(program));
     }
   }
@@ -82,6 +91,12 @@ bool GLRenderer::Init() {
 
   vertex_array_ = vertex_array;
 
+  // Vertex array used by batched programs, its attributes are set up per
+  // draw as layout depends on the number of layers.
+  glGenVertexArraysOES(1, &batch_vertex_array_);
+  glGenBuffers(1, &batch_vertex_buffer_);
+  glBindVertexArrayOES(vertex_array_);
+
   return true;
 }
 
@@ -137,9 +152,54 @@ bool GLRenderer::Draw(const std::vector<RenderState> &render_states,
       damage.left, damage.top, damage.right - damage.left,
       damage.bottom - damage.top);
 #endif
-  for (const RenderState &state : render_states) {
+  // Group regions by number of layers and the features they need, each
+  // group can be drawn with one batched draw call. Regions which can't be
+  // batched use a draw call each.
+  std::vector<const RenderState *> &single_states = single_states_;
+  single_states.clear();
+  if (render_states.size() > 1) {
+    for (unsigned i = 0; i < kMaxBatchLayers; i++) {
+      for (std::vector<const RenderState *> &batch : batches_[i])
+        batch.clear();
+    }
+
+    for (const RenderState &state : render_states) {
+      unsigned size = state.layer_state_.size();
+      if (size > 0 && size <= kMaxBatchLayers) {
+        uint32_t features = state.GetFeatures() & ~kRenderTransform;
+        batches_[size - 1][features].emplace_back(&state);
+      } else {
+        single_states.emplace_back(&state);
+      }
+    }
+
+    bool batched = false;
+    for (unsigned i = 0; i < kMaxBatchLayers; i++) {
+      for (uint32_t features = 0; features <= kRenderAllFeatures;
+           features++) {
+        std::vector<const RenderState *> &batch = batches_[i][features];
+        if (batch.size() > 1 &&
+            DrawBatched(batch, i + 1, features, frame_width, frame_height)) {
+          batched = true;
+          continue;
+        }
+
+        single_states.insert(single_states.end(), batch.begin(),
+                             batch.end());
+      }
+    }
+
+    if (batched)
+      glBindVertexArrayOES(vertex_array_);
+  } else {
+    for (const RenderState &state : render_states)
+      single_states.emplace_back(&state);
+  }
+
+  for (const RenderState *single_state : single_states) {
+    const RenderState &state = *single_state;
     unsigned size = state.layer_state_.size();
-    GLProgram *program = GetProgram(size);
+    GLProgram *program = GetProgram(size, state.GetFeatures());
     if (!program)
       continue;
 
@@ -213,7 +273,138 @@ void GLRenderer::SetDisableExplicitSync(bool disable_explicit_sync) {
   disable_explicit_sync_ = disable_explicit_sync;
 }
 
-GLProgram *GLRenderer::GetProgram(unsigned texture_count) {
+void GLRenderer::WarmUp(const std::vector<uint32_t> &layer_counts) {
+  if (!context_.MakeCurrent()) {
+    ETRACE("Failed make current context.");
+    return;
+  }
+
+  for (uint32_t layer_count : layer_counts) {
+    if (layer_count == 0)
+      continue;
+
+    if (!GetProgram(layer_count))
+      ETRACE("Failed to warm up program for %d layers.", layer_count);
+
+    if (layer_count > kMaxBatchLayers)
+      continue;
+
+    // Opaque, unrotated layers without solid color are the common case.
+    GetProgram(layer_count, 0);
+    GetBatchedProgram(layer_count, kRenderAllFeatures & ~kRenderTransform);
+    GetBatchedProgram(layer_count, 0);
+  }
+}
+
+GLProgram *GLRenderer::GetBatchedProgram(unsigned texture_count,
+                                         uint32_t features) {
+  if (texture_count == 0 || texture_count > kMaxBatchLayers)
+    return NULL;
+
+  unsigned index = texture_count - 1;
+  if (batched_programs_[index][features])
+    return batched_programs_[index][features].get();
+
+  if (batched_program_failed_[index][features])
+    return NULL;
+
+  std::unique_ptr<GLProgram> program(new GLProgram());
+  if (!program->InitBatched(texture_count, features, &program_cache_)) {
+    ETRACE("Failed to create batched program for %d layers, features %x.",
+           texture_count, features);
+    batched_program_failed_[index][features] = true;
+    return NULL;
+  }
+
+  batched_programs_[index][features] = std::move(program);
+  return batched_programs_[index][features].get();
+}
+
+bool GLRenderer::DrawBatched(const std::vector<const RenderState *> &states,
+                             unsigned texture_count, uint32_t features,
+                             GLuint frame_width, GLuint frame_height) {
+  GLProgram *program = GetBatchedProgram(texture_count, features);
+  if (!program)
+    return false;
+
+  glBindVertexArrayOES(batch_vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, batch_vertex_buffer_);
+  // Regions are drawn as quads of their exact size, no scissor needed.
+  glDisable(GL_SCISSOR_TEST);
+
+  std::vector<GpuResourceHandle> &textures = batch_textures_;
+  uint32_t texture_units[kMaxBatchLayers];
+  size_t vertex_size = GLProgram::GetBatchVertexSize(texture_count);
+  size_t total = states.size();
+  size_t index = 0;
+  while (index < total) {
+    textures.clear();
+    batch_vertices_.clear();
+    size_t regions = 0;
+    // Add regions till we run out of texture units.
+    for (; index < total; index++) {
+      const RenderState &state = *states[index];
+      size_t textures_size = textures.size();
+      for (unsigned i = 0; i < texture_count; i++) {
+        GpuResourceHandle handle = state.layer_state_[i].handle_;
+        auto it = std::find(textures.begin(), textures.end(), handle);
+        texture_units[i] = it - textures.begin();
+        if (it == textures.end())
+          textures.emplace_back(handle);
+      }
+
+      if (textures.size() > kMaxBatchTextures) {
+        textures.resize(textures_size);
+        break;
+      }
+
+      GLProgram::AppendBatchVertices(state, texture_units, frame_width,
+                                     frame_height, &batch_vertices_);
+      regions++;
+    }
+
+    program->UseBatchedProgram(textures);
+    glBufferData(GL_ARRAY_BUFFER, batch_vertices_.size() * sizeof(GLfloat),
+                 batch_vertices_.data(), GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, batch_vertices_.size() / vertex_size);
+#ifdef COMPOSITOR_TRACING
+    ICOMPOSITORTRACE("Batched draw of %zu regions with %d layers. \n", regions,
+                     texture_count);
+#endif
+
+    for (size_t unit = 0; unit < textures.size(); unit++) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+    }
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glEnable(GL_SCISSOR_TEST);
+  return true;
+}
+
+GLProgram *GLRenderer::GetProgram(unsigned texture_count, uint32_t features) {
+  if (texture_count == 0)
+    return 0;
+
+  if (features != kRenderAllFeatures && texture_count <= kMaxBatchLayers) {
+    unsigned index = texture_count - 1;
+    if (variant_programs_[index][features])
+      return variant_programs_[index][features].get();
+
+    if (!variant_program_failed_[index][features]) {
+      std::unique_ptr<GLProgram> program(new GLProgram());
+      if (program->Init(texture_count, features, &program_cache_)) {
+        variant_programs_[index][features] = std::move(program);
+        return variant_programs_[index][features].get();
+      }
+
+      ETRACE("Failed to create program for %d layers, features %x.",
+             texture_count, features);
+      variant_program_failed_[index][features] = true;
+    }
+  }
+
   if (programs_.size() >= texture_count) {
     GLProgram *program = programs_[texture_count - 1].get();
     if (program != 0)
@@ -221,7 +412,7 @@ GLProgram *GLRenderer::GetProgram(unsigned texture_count) {
   }
 
   std::unique_ptr<GLProgram> program(new GLProgram());
-  if (program->Init(texture_count)) {
+  if (program->Init(texture_count, kRenderAllFeatures, &program_cache_)) {
     if (programs_.size() < texture_count)
       programs_.resize(texture_count);
 
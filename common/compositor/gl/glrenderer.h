@@ -24,6 +24,7 @@
 
 #include "egloffscreencontext.h"
 #include "glprogram.h"
+#include "glprogramcache.h"
 
 namespace hwcomposer {
 
@@ -40,13 +41,48 @@ class GLRenderer : public Renderer {
 
   void SetDisableExplicitSync(bool disable_explicit_sync) override;
 
+  void WarmUp(const std::vector<uint32_t> &layer_counts) override;
+
  private:
-  GLProgram *GetProgram(unsigned texture_count);
+  // Returns program for regions with texture_count layers which need
+  // features, see RenderFeatures. Falls back to the generic program if the
+  // variant for features can't be created.
+  GLProgram *GetProgram(unsigned texture_count,
+                        uint32_t features = kRenderAllFeatures);
+  GLProgram *GetBatchedProgram(unsigned texture_count, uint32_t features);
+
+  // Draws states, all using texture_count layers and needing features,
+  // with as few draw calls as possible. Returns false if no batched program
+  // is available.
+  bool DrawBatched(const std::vector<const RenderState *> &states,
+                   unsigned texture_count, uint32_t features,
+                   GLuint frame_width, GLuint frame_height);
 
   EGLOffScreenContext context_;
+  GLProgramCache program_cache_;
 
+  // Generic programs by layer count.
   std::vector<std::unique_ptr<GLProgram>> programs_;
+  // Programs by layer count and RenderFeatures, created on first use.
+  // Regions with more than kMaxBatchLayers layers use generic programs.
+  std::unique_ptr<GLProgram> variant_programs_[kMaxBatchLayers]
+                                              [kRenderAllFeatures];
+  bool variant_program_failed_[kMaxBatchLayers][kRenderAllFeatures] = {};
+  // Batched programs don't use kRenderTransform, as texture coordinates are
+  // calculated on the CPU.
+  std::unique_ptr<GLProgram> batched_programs_[kMaxBatchLayers]
+                                              [kRenderAllFeatures + 1];
+  // Set once creating a batched program failed.
+  bool batched_program_failed_[kMaxBatchLayers][kRenderAllFeatures + 1] = {};
+  // Scratch space of Draw and DrawBatched, kept to avoid allocations.
+  std::vector<const RenderState *> single_states_;
+  std::vector<const RenderState *> batches_[kMaxBatchLayers]
+                                           [kRenderAllFeatures + 1];
+  std::vector<GpuResourceHandle> batch_textures_;
+  std::vector<GLfloat> batch_vertices_;
   GLuint vertex_array_ = 0;
+  GLuint batch_vertex_array_ = 0;
+  GLuint batch_vertex_buffer_ = 0;
   bool disable_explicit_sync_ = false;
 };
 
@@ -42,6 +42,7 @@ bool InitializeShims() {
   get_proc(glGenVertexArraysOES, PFNGLGENVERTEXARRAYSOESPROC);
   get_proc(glBindVertexArrayOES, PFNGLBINDVERTEXARRAYOESPROC);
   get_proc(glProgramBinaryOES, PFNGLPROGRAMBINARYOESPROC);
+  get_proc(glGetProgramBinaryOES, PFNGLGETPROGRAMBINARYOESPROC);
 #ifndef USE_ANDROID_SHIM
   get_proc(eglDupNativeFenceFDANDROID, PFNEGLDUPNATIVEFENCEFDANDROIDPROC);
 #endif
@@ -61,6 +62,7 @@ PFNGLDELETEVERTEXARRAYSOESPROC glDeleteVertexArraysOES;
 PFNGLGENVERTEXARRAYSOESPROC glGenVertexArraysOES;
 PFNGLBINDVERTEXARRAYOESPROC glBindVertexArrayOES;
 PFNGLPROGRAMBINARYOESPROC glProgramBinaryOES;
+PFNGLGETPROGRAMBINARYOESPROC glGetProgramBinaryOES;
 #ifndef USE_ANDROID_SHIM
 PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
 #endif
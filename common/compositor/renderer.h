@@ -64,6 +64,11 @@ class Renderer {
   virtual void InsertFence(int32_t kms_fence) = 0;
 
   virtual void SetDisableExplicitSync(bool disable_explicit_sync) = 0;
+
+  // Prepares everything needed to draw regions with any of layer_counts
+  // layers, so that it doesn't need to be done while drawing a frame.
+  virtual void WarmUp(const std::vector<uint32_t>& /*layer_counts*/) {
+  }
 };
 
 }  // namespace hwcomposer
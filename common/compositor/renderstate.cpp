@@ -26,6 +26,18 @@
 
 namespace hwcomposer {
 
+static void GetTextureSize(const OverlayLayer &layer, float *width,
+                           float *height) {
+  OverlayBuffer *layer_buffer = layer.GetBuffer();
+  if (layer_buffer) {
+    *width = static_cast<float>(layer_buffer->GetWidth());
+    *height = static_cast<float>(layer_buffer->GetHeight());
+  } else {
+    *width = static_cast<float>(layer.GetSourceCropWidth());
+    *height = static_cast<float>(layer.GetSourceCropHeight());
+  }
+}
+
 void RenderState::ConstructState(std::vector<OverlayLayer> &layers,
                                  const CompositionRegion &region,
                                  uint32_t downscaling_factor,
@@ -41,6 +53,7 @@ void RenderState::ConstructState(std::vector<OverlayLayer> &layers,
   scissor_y_ = y_;
   scissor_width_ = width_;
   scissor_height_ = height_;
+  layer_state_.clear();
   const std::vector<size_t> &source = region.source_layers;
   for (size_t texture_index : source) {
     OverlayLayer &layer = layers.at(texture_index);
@@ -55,6 +68,8 @@ void RenderState::ConstructState(std::vector<OverlayLayer> &layers,
       transform = layer.GetPlaneTransform();
     }
 
+    src.transform_ = transform;
+    src.blending_ = layer.GetBlending();
     switch (transform) {
       case HWCTransform::kTransform180: {
         swap_xy = false;
@@ -127,14 +142,9 @@ void RenderState::ConstructState(std::vector<OverlayLayer> &layers,
 
     float tex_width = 0;
     float tex_height = 0;
-    OverlayBuffer *layer_buffer = layer.GetBuffer();
-    if (layer_buffer) {
-      tex_width = static_cast<float>(layer_buffer->GetWidth());
-      tex_height = static_cast<float>(layer_buffer->GetHeight());
-    } else {
-      tex_width = static_cast<float>(layer.GetSourceCropWidth());
-      tex_height = static_cast<float>(layer.GetSourceCropHeight());
-    }
+    GetTextureSize(layer, &tex_width, &tex_height);
+    src.tex_width_ = tex_width;
+    src.tex_height_ = tex_height;
 
     const HwcRect<float> &source_crop = layer.GetSourceCrop();
 
@@ -169,4 +179,70 @@ void RenderState::ConstructState(std::vector<OverlayLayer> &layers,
   }
 }
 
+bool RenderState::IsGeometryValid(const std::vector<OverlayLayer> &layers,
+                                  bool use_plane_transform) const {
+  for (const LayerState &src : layer_state_) {
+    const OverlayLayer &layer = layers.at(src.layer_index_);
+    if (layer.HasDimensionsChanged() || layer.HasSourceRectChanged())
+      return false;
+
+    uint32_t transform = layer.GetTransform();
+    if (use_plane_transform) {
+      transform = layer.GetPlaneTransform();
+    }
+
+    // Opaque layers end the list of layers in ConstructState.
+    bool opaque = layer.GetBlending() == HWCBlending::kBlendingNone;
+    if ((transform != src.transform_) ||
+        (opaque != (src.blending_ == HWCBlending::kBlendingNone)))
+      return false;
+
+    float tex_width = 0;
+    float tex_height = 0;
+    GetTextureSize(layer, &tex_width, &tex_height);
+    if ((tex_width != src.tex_width_) || (tex_height != src.tex_height_))
+      return false;
+  }
+
+  return true;
+}
+
+uint32_t RenderState::GetFeatures() const {
+  uint32_t features = 0;
+  for (const LayerState &src : layer_state_) {
+    if (src.texture_matrix_[0] != 1.0f)
+      features |= kRenderTransform;
+
+    // Layers without solid color have color 0 and alpha 0xff, which leaves
+    // the texture sample unchanged.
+    const uint8_t *color = src.solid_color_array_;
+    if (color[0] == 0 || color[1] || color[2] || color[3])
+      features |= kRenderSolidColor;
+
+    if (src.premult_ != 1.0f)
+      features |= kRenderCoverage;
+
+    if (src.alpha_ != 1.0f)
+      features |= kRenderPlaneAlpha;
+  }
+
+  return features;
+}
+
+void RenderState::UpdateState(std::vector<OverlayLayer> &layers) {
+  for (LayerState &src : layer_state_) {
+    OverlayLayer &layer = layers.at(src.layer_index_);
+    src.solid_color_array_ = layer.GetSolidColorArray();
+    src.blending_ = layer.GetBlending();
+    if (layer.GetBlending() == HWCBlending::kBlendingNone) {
+      src.alpha_ = src.premult_ = 1.0f;
+      continue;
+    }
+
+    src.alpha_ = layer.GetAlpha() / 255.0f;
+    src.premult_ =
+        (layer.GetBlending() == HWCBlending::kBlendingPremult) ? 1.0f : 0.0f;
+  }
+}
+
 }  // namespace hwcomposer
@@ -33,6 +33,16 @@ class NativeGpuResource;
 class NativeSurface;
 class OverlayBuffer;
 
+// Blending features needed by the layers of a region. Renderers can use
+// cheaper shaders for regions which don't need all of them.
+enum RenderFeatures {
+  kRenderTransform = 1 << 0,   // Texture coordinates of a layer are swapped.
+  kRenderSolidColor = 1 << 1,  // A layer has a solid color.
+  kRenderCoverage = 1 << 2,    // A layer isn't premultiplied.
+  kRenderPlaneAlpha = 1 << 3,  // A layer has plane alpha below 1.
+  kRenderAllFeatures = (1 << 4) - 1
+};
+
 struct RenderState {
   struct LayerState {
     float crop_bounds_[4];
@@ -42,6 +52,12 @@ struct RenderState {
     uint32_t layer_index_;
     uint8_t *solid_color_array_;
     GpuResourceHandle handle_;
+    // Layer properties crop_bounds_ and texture_matrix_ depend on, which
+    // are not covered by the state of OverlayLayer.
+    uint32_t transform_;
+    HWCBlending blending_;
+    float tex_width_;
+    float tex_height_;
   };
 
   void ConstructState(std::vector<OverlayLayer> &layers,
@@ -49,6 +65,18 @@ struct RenderState {
                       uint32_t downscaling_factor, bool uses_display_up_scaling,
                       bool use_plane_transform);
 
+  // Returns true if none of the layers has been moved, cropped or
+  // transformed since ConstructState, in which case only UpdateState is
+  // needed.
+  bool IsGeometryValid(const std::vector<OverlayLayer> &layers,
+                       bool use_plane_transform) const;
+
+  // Updates alpha and solid color of the layers.
+  void UpdateState(std::vector<OverlayLayer> &layers);
+
+  // Returns RenderFeatures needed to draw layer_state_.
+  uint32_t GetFeatures() const;
+
   uint32_t x_;
   uint32_t y_;
   uint32_t width_;
@@ -60,6 +88,15 @@ struct RenderState {
   std::vector<LayerState> layer_state_;
 };
 
+// RenderStates of the composition regions of a plane, in region order.
+// They are kept across frames as long as the regions stay the same.
+struct RenderStateCache {
+  std::vector<RenderState> states_;
+  uint32_t downscaling_factor_ = 0;
+  bool uses_display_up_scaling_ = false;
+  bool use_plane_transform_ = false;
+};
+
 struct MediaState {
   std::vector<OverlayLayer *> layers_;
   HWCColorMap colors_;
@@ -0,0 +1,322 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "swkernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SW_KERNELS_X86 1
+#endif
+
+namespace hwcomposer {
+
+static const float kByteToFloat = 1.0f / 255.0f;
+
+// Byte offsets of red and blue in a 32 bit pixel, see SWKernels::unpack.
+static inline uint32_t RedShift(bool bgra) {
+  return bgra ? 16 : 0;
+}
+
+static inline uint32_t BlueShift(bool bgra) {
+  return bgra ? 0 : 16;
+}
+
+// Plain C versions, also used for the remainders of the vector loops.
+
+static inline void UnpackPixel(const uint8_t* src, bool bgra, bool opaque,
+                               float* const rgba[4], uint32_t i) {
+  uint32_t pixel = src[i * 4] | (src[i * 4 + 1] << 8) |
+                   (src[i * 4 + 2] << 16) | ((uint32_t)src[i * 4 + 3] << 24);
+  rgba[0][i] = ((pixel >> RedShift(bgra)) & 0xff) * kByteToFloat;
+  rgba[1][i] = ((pixel >> 8) & 0xff) * kByteToFloat;
+  rgba[2][i] = ((pixel >> BlueShift(bgra)) & 0xff) * kByteToFloat;
+  rgba[3][i] = opaque ? 1.0f : (pixel >> 24) * kByteToFloat;
+}
+
+static inline float BlendPixel(const float* const rgba[4], float alpha,
+                               float premult, float* const acc[4],
+                               uint32_t i) {
+  float a = rgba[3][i];
+  float cover = acc[3][i];
+  float multiplier = std::max(a, premult);
+  float weight = alpha * cover;
+  acc[0][i] += (rgba[0][i] * multiplier) * weight;
+  acc[1][i] += (rgba[1][i] * multiplier) * weight;
+  acc[2][i] += (rgba[2][i] * multiplier) * weight;
+  cover = cover * (1.0f - a * alpha);
+  acc[3][i] = cover;
+  return cover;
+}
+
+static inline uint32_t ToByte(float value) {
+  return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) *
+                                   255.0f +
+                               0.5f);
+}
+
+static inline void PackPixel(const float* const acc[4], bool bgra,
+                             uint8_t* dst, uint32_t i) {
+  uint32_t pixel = (ToByte(acc[0][i]) << RedShift(bgra)) |
+                   (ToByte(acc[1][i]) << 8) |
+                   (ToByte(acc[2][i]) << BlueShift(bgra)) |
+                   (ToByte(1.0f - acc[3][i]) << 24);
+  dst[i * 4] = pixel & 0xff;
+  dst[i * 4 + 1] = (pixel >> 8) & 0xff;
+  dst[i * 4 + 2] = (pixel >> 16) & 0xff;
+  dst[i * 4 + 3] = pixel >> 24;
+}
+
+static void UnpackC(const uint8_t* src, uint32_t count, bool bgra, bool opaque,
+                    float* const rgba[4]) {
+  for (uint32_t i = 0; i < count; i++)
+    UnpackPixel(src, bgra, opaque, rgba, i);
+}
+
+static float BlendC(const float* const rgba[4], float alpha, float premult,
+                    float* const acc[4], uint32_t count) {
+  float max_cover = 0.0f;
+  for (uint32_t i = 0; i < count; i++)
+    max_cover = std::max(max_cover, BlendPixel(rgba, alpha, premult, acc, i));
+
+  return max_cover;
+}
+
+static void PackC(const float* const acc[4], uint32_t count, bool bgra,
+                  uint8_t* dst) {
+  for (uint32_t i = 0; i < count; i++)
+    PackPixel(acc, bgra, dst, i);
+}
+
+#ifdef SW_KERNELS_X86
+__attribute__((target("sse4.1"))) static void UnpackSSE4(
+    const uint8_t* src, uint32_t count, bool bgra, bool opaque,
+    float* const rgba[4]) {
+  const __m128i mask = _mm_set1_epi32(0xff);
+  const __m128 scale = _mm_set1_ps(kByteToFloat);
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128i red_shift = _mm_cvtsi32_si128(RedShift(bgra));
+  __m128i blue_shift = _mm_cvtsi32_si128(BlueShift(bgra));
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+    __m128i red = _mm_and_si128(_mm_srl_epi32(pixels, red_shift), mask);
+    __m128i green = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+    __m128i blue = _mm_and_si128(_mm_srl_epi32(pixels, blue_shift), mask);
+    _mm_storeu_ps(rgba[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(red), scale));
+    _mm_storeu_ps(rgba[1] + i, _mm_mul_ps(_mm_cvtepi32_ps(green), scale));
+    _mm_storeu_ps(rgba[2] + i, _mm_mul_ps(_mm_cvtepi32_ps(blue), scale));
+    if (opaque) {
+      _mm_storeu_ps(rgba[3] + i, one);
+    } else {
+      __m128i alpha = _mm_srli_epi32(pixels, 24);
+      _mm_storeu_ps(rgba[3] + i, _mm_mul_ps(_mm_cvtepi32_ps(alpha), scale));
+    }
+  }
+
+  for (; i < count; i++)
+    UnpackPixel(src, bgra, opaque, rgba, i);
+}
+
+__attribute__((target("sse4.1"))) static float BlendSSE4(
+    const float* const rgba[4], float alpha, float premult,
+    float* const acc[4], uint32_t count) {
+  const __m128 alpha4 = _mm_set1_ps(alpha);
+  const __m128 premult4 = _mm_set1_ps(premult);
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128 max_cover4 = _mm_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 a = _mm_loadu_ps(rgba[3] + i);
+    __m128 cover = _mm_loadu_ps(acc[3] + i);
+    __m128 multiplier = _mm_max_ps(a, premult4);
+    __m128 weight = _mm_mul_ps(alpha4, cover);
+    for (int c = 0; c < 3; c++) {
+      __m128 value =
+          _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(rgba[c] + i), multiplier), weight);
+      _mm_storeu_ps(acc[c] + i, _mm_add_ps(_mm_loadu_ps(acc[c] + i), value));
+    }
+
+    cover = _mm_mul_ps(cover, _mm_sub_ps(one, _mm_mul_ps(a, alpha4)));
+    _mm_storeu_ps(acc[3] + i, cover);
+    max_cover4 = _mm_max_ps(max_cover4, cover);
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, max_cover4);
+  float max_cover = std::max(std::max(lanes[0], lanes[1]),
+                             std::max(lanes[2], lanes[3]));
+  for (; i < count; i++)
+    max_cover = std::max(max_cover, BlendPixel(rgba, alpha, premult, acc, i));
+
+  return max_cover;
+}
+
+__attribute__((target("sse4.1"))) static __m128i ToBytesSSE4(__m128 value) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  value = _mm_min_ps(_mm_max_ps(value, zero), one);
+  value = _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)),
+                     _mm_set1_ps(0.5f));
+  return _mm_cvttps_epi32(value);
+}
+
+__attribute__((target("sse4.1"))) static void PackSSE4(
+    const float* const acc[4], uint32_t count, bool bgra, uint8_t* dst) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128i red_shift = _mm_cvtsi32_si128(RedShift(bgra));
+  __m128i blue_shift = _mm_cvtsi32_si128(BlueShift(bgra));
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i red =
+        _mm_sll_epi32(ToBytesSSE4(_mm_loadu_ps(acc[0] + i)), red_shift);
+    __m128i green = _mm_slli_epi32(ToBytesSSE4(_mm_loadu_ps(acc[1] + i)), 8);
+    __m128i blue =
+        _mm_sll_epi32(ToBytesSSE4(_mm_loadu_ps(acc[2] + i)), blue_shift);
+    __m128i alpha = _mm_slli_epi32(
+        ToBytesSSE4(_mm_sub_ps(one, _mm_loadu_ps(acc[3] + i))), 24);
+    __m128i pixels =
+        _mm_or_si128(_mm_or_si128(red, green), _mm_or_si128(blue, alpha));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), pixels);
+  }
+
+  for (; i < count; i++)
+    PackPixel(acc, bgra, dst, i);
+}
+
+__attribute__((target("avx2"))) static void UnpackAVX2(
+    const uint8_t* src, uint32_t count, bool bgra, bool opaque,
+    float* const rgba[4]) {
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  const __m256 scale = _mm256_set1_ps(kByteToFloat);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m128i red_shift = _mm_cvtsi32_si128(RedShift(bgra));
+  __m128i blue_shift = _mm_cvtsi32_si128(BlueShift(bgra));
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i pixels =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+    __m256i red = _mm256_and_si256(_mm256_srl_epi32(pixels, red_shift), mask);
+    __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask);
+    __m256i blue = _mm256_and_si256(_mm256_srl_epi32(pixels, blue_shift), mask);
+    _mm256_storeu_ps(rgba[0] + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(red), scale));
+    _mm256_storeu_ps(rgba[1] + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(green), scale));
+    _mm256_storeu_ps(rgba[2] + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(blue), scale));
+    if (opaque) {
+      _mm256_storeu_ps(rgba[3] + i, one);
+    } else {
+      __m256i alpha = _mm256_srli_epi32(pixels, 24);
+      _mm256_storeu_ps(rgba[3] + i,
+                       _mm256_mul_ps(_mm256_cvtepi32_ps(alpha), scale));
+    }
+  }
+
+  for (; i < count; i++)
+    UnpackPixel(src, bgra, opaque, rgba, i);
+}
+
+__attribute__((target("avx2"))) static float BlendAVX2(
+    const float* const rgba[4], float alpha, float premult,
+    float* const acc[4], uint32_t count) {
+  const __m256 alpha8 = _mm256_set1_ps(alpha);
+  const __m256 premult8 = _mm256_set1_ps(premult);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m256 max_cover8 = _mm256_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 a = _mm256_loadu_ps(rgba[3] + i);
+    __m256 cover = _mm256_loadu_ps(acc[3] + i);
+    __m256 multiplier = _mm256_max_ps(a, premult8);
+    __m256 weight = _mm256_mul_ps(alpha8, cover);
+    for (int c = 0; c < 3; c++) {
+      __m256 value = _mm256_mul_ps(
+          _mm256_mul_ps(_mm256_loadu_ps(rgba[c] + i), multiplier), weight);
+      _mm256_storeu_ps(acc[c] + i,
+                       _mm256_add_ps(_mm256_loadu_ps(acc[c] + i), value));
+    }
+
+    cover = _mm256_mul_ps(cover, _mm256_sub_ps(one, _mm256_mul_ps(a, alpha8)));
+    _mm256_storeu_ps(acc[3] + i, cover);
+    max_cover8 = _mm256_max_ps(max_cover8, cover);
+  }
+
+  float lanes[8];
+  _mm256_storeu_ps(lanes, max_cover8);
+  float max_cover = *std::max_element(lanes, lanes + 8);
+  for (; i < count; i++)
+    max_cover = std::max(max_cover, BlendPixel(rgba, alpha, premult, acc, i));
+
+  return max_cover;
+}
+
+__attribute__((target("avx2"))) static __m256i ToBytesAVX2(__m256 value) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  value = _mm256_min_ps(_mm256_max_ps(value, zero), one);
+  value = _mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)),
+                        _mm256_set1_ps(0.5f));
+  return _mm256_cvttps_epi32(value);
+}
+
+__attribute__((target("avx2"))) static void PackAVX2(
+    const float* const acc[4], uint32_t count, bool bgra, uint8_t* dst) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m128i red_shift = _mm_cvtsi32_si128(RedShift(bgra));
+  __m128i blue_shift = _mm_cvtsi32_si128(BlueShift(bgra));
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i red =
+        _mm256_sll_epi32(ToBytesAVX2(_mm256_loadu_ps(acc[0] + i)), red_shift);
+    __m256i green =
+        _mm256_slli_epi32(ToBytesAVX2(_mm256_loadu_ps(acc[1] + i)), 8);
+    __m256i blue =
+        _mm256_sll_epi32(ToBytesAVX2(_mm256_loadu_ps(acc[2] + i)), blue_shift);
+    __m256i alpha = _mm256_slli_epi32(
+        ToBytesAVX2(_mm256_sub_ps(one, _mm256_loadu_ps(acc[3] + i))), 24);
+    __m256i pixels = _mm256_or_si256(_mm256_or_si256(red, green),
+                                     _mm256_or_si256(blue, alpha));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), pixels);
+  }
+
+  for (; i < count; i++)
+    PackPixel(acc, bgra, dst, i);
+}
+#endif
+
+const SWKernels& SWKernels::Get(bool reference) {
+  static const SWKernels c_kernels = {UnpackC, BlendC, PackC};
+#ifdef SW_KERNELS_X86
+  static const SWKernels sse4_kernels = {UnpackSSE4, BlendSSE4, PackSSE4};
+  static const SWKernels avx2_kernels = {UnpackAVX2, BlendAVX2, PackAVX2};
+  if (reference)
+    return c_kernels;
+
+  if (__builtin_cpu_supports("avx2"))
+    return avx2_kernels;
+
+  if (__builtin_cpu_supports("sse4.1"))
+    return sse4_kernels;
+#endif
+
+  return c_kernels;
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,56 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_COMPOSITOR_SW_SWKERNELS_H_
+#define COMMON_COMPOSITOR_SW_SWKERNELS_H_
+
+#include <stdint.h>
+
+namespace hwcomposer {
+
+// Row operations of SWRenderer. Between the operations pixels are kept as
+// planar floats in [0, 1], rgba[0 ... 3] being the red, green, blue and
+// alpha rows. All versions do the same operations in the same order and
+// without fused multiply-add, so results don't depend on the instruction
+// set used.
+struct SWKernels {
+  // Converts count 32 bit pixels to planar floats. bgra is true if the
+  // bytes of a pixel are stored in B, G, R, A order (DRM_FORMAT_ARGB8888),
+  // false for R, G, B, A (DRM_FORMAT_ABGR8888). opaque ignores the alpha
+  // byte and sets alpha to 1.
+  void (*unpack)(const uint8_t* src, uint32_t count, bool bgra, bool opaque,
+                 float* const rgba[4]);
+
+  // Blends a row of a layer under the pixels accumulated so far, i.e.
+  // layers are blended from top to bottom like the GL shaders do. acc holds
+  // the accumulated color and, in acc[3], the coverage still left for the
+  // layers below. premult is 1 for layers with premultiplied alpha, 0 for
+  // coverage alpha, alpha the plane alpha of the layer. Returns the largest
+  // coverage left in the row.
+  float (*blend)(const float* const rgba[4], float alpha, float premult,
+                 float* const acc[4], uint32_t count);
+
+  // Converts count accumulated pixels to 32 bit pixels, see unpack.
+  void (*pack)(const float* const acc[4], uint32_t count, bool bgra,
+               uint8_t* dst);
+
+  // Returns the fastest version supported by the cpu, or the plain C one if
+  // reference is true.
+  static const SWKernels& Get(bool reference);
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_COMPOSITOR_SW_SWKERNELS_H_
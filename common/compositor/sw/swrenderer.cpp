@@ -0,0 +1,400 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "swrenderer.h"
+
+#include <drm_fourcc.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <hwcutils.h>
+#include <nativebufferhandler.h>
+
+#include "hwctrace.h"
+#include "nativesurface.h"
+#include "overlaybuffer.h"
+#include "swsurface.h"
+
+namespace hwcomposer {
+
+// Rows drawn by a task at a time, small enough to balance the work between
+// the tasks, large enough to keep the overhead per tile low.
+static const uint32_t kTileRows = 16;
+// The TaskExecutor workers and the thread waiting for them.
+static const uint32_t kNumTileTasks = 3;
+// Same as the GL shaders, layers below are not visible anymore.
+static const float kMinCoverage = 0.5f / 255.0f;
+
+static bool Is8888Format(uint32_t format) {
+  switch (format) {
+    case DRM_FORMAT_ARGB8888:
+    case DRM_FORMAT_XRGB8888:
+    case DRM_FORMAT_ABGR8888:
+    case DRM_FORMAT_XBGR8888:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool IsBGRAFormat(uint32_t format) {
+  return format == DRM_FORMAT_ARGB8888 || format == DRM_FORMAT_XRGB8888;
+}
+
+static bool IsOpaqueFormat(uint32_t format) {
+  return format == DRM_FORMAT_XRGB8888 || format == DRM_FORMAT_XBGR8888 ||
+         format == DRM_FORMAT_NV12;
+}
+
+static inline uint32_t ClampToByte(int32_t value) {
+  return std::min(std::max(value, 0), 255);
+}
+
+// BT.601 limited range, returns R, G, B, A bytes.
+static inline uint32_t YUVToPixel(int32_t y, int32_t u, int32_t v) {
+  int32_t c = 298 * (y - 16) + 128;
+  int32_t d = u - 128;
+  int32_t e = v - 128;
+  uint32_t red = ClampToByte((c + 409 * e) >> 8);
+  uint32_t green = ClampToByte((c - 100 * d - 208 * e) >> 8);
+  uint32_t blue = ClampToByte((c + 516 * d) >> 8);
+  return red | (green << 8) | (blue << 16) | 0xff000000;
+}
+
+SWRenderer::SWRenderer(bool reference)
+    : kernels_(SWKernels::Get(reference)) {
+}
+
+SWRenderer::~SWRenderer() {
+}
+
+bool SWRenderer::Init() {
+  for (uint32_t i = 0; i < kNumTileTasks; i++) {
+    tasks_.emplace_back(new TileTask(this));
+  }
+
+  return true;
+}
+
+void SWRenderer::InsertFence(int32_t kms_fence) {
+  if (kms_fence > 0) {
+    HWCPoll(kms_fence, -1);
+    close(kms_fence);
+  }
+}
+
+void SWRenderer::SetDisableExplicitSync(bool disable_explicit_sync) {
+  disable_explicit_sync_ = disable_explicit_sync;
+}
+
+bool SWRenderer::MapImage(OverlayBuffer *buffer, bool write, Image *image) {
+  const ResourceHandle &resource = buffer->GetGpuResource();
+  image->buffer = buffer;
+  image->handle = resource.handle_;
+  image->format = buffer->GetFormat();
+  image->width = buffer->GetWidth();
+  image->height = buffer->GetHeight();
+  if (!image->handle ||
+      (!Is8888Format(image->format) && image->format != DRM_FORMAT_NV12)) {
+    ETRACE("Software renderer can't access buffer of format %4.4s.",
+           (char *)&image->format);
+    return false;
+  }
+
+  const HwcMeta &meta = image->handle->meta_data_;
+  if (image->format == DRM_FORMAT_NV12 &&
+      (meta.num_planes_ < 2 || meta.offsets_[1] < meta.offsets_[0])) {
+    ETRACE("Software renderer can't find UV plane of NV12 buffer.");
+    return false;
+  }
+
+  if (write) {
+    image->pixels = static_cast<uint8_t *>(
+        handler_->Map(image->handle, 0, 0, image->width, image->height,
+                      &image->pitch, &image->map_data, 0));
+  } else {
+    image->pixels = static_cast<uint8_t *>(
+        handler_->MapForRead(image->handle, 0, 0, image->width, image->height,
+                             &image->pitch, &image->map_data, 0));
+  }
+
+  if (!image->pixels) {
+    ETRACE("Failed to map buffer for software rendering.");
+    return false;
+  }
+
+  // Buffer handlers ignore the plane when mapping, the mapping starts at
+  // the first plane and the UV plane follows at its offset in the buffer.
+  if (image->format == DRM_FORMAT_NV12) {
+    image->uv = image->pixels + (meta.offsets_[1] - meta.offsets_[0]);
+    image->uv_pitch = meta.pitches_[1];
+  }
+
+  return true;
+}
+
+void SWRenderer::UnmapImage(Image *image) {
+  if (image->map_data)
+    handler_->UnMap(image->handle, image->map_data);
+
+  *image = Image();
+}
+
+int32_t SWRenderer::GetImage(OverlayBuffer *buffer) {
+  for (size_t i = 0; i < images_.size(); i++) {
+    if (images_[i].buffer == buffer)
+      return i;
+  }
+
+  images_.emplace_back();
+  if (!MapImage(buffer, false, &images_.back())) {
+    images_.pop_back();
+    return -1;
+  }
+
+  return images_.size() - 1;
+}
+
+void SWRenderer::ClearSurface(NativeSurface *surface) {
+  int width = surface->GetWidth();
+  int height = surface->GetHeight();
+  HwcRect<int> clear(0, 0, width, height);
+  const HwcRect<int> &damage = surface->GetSurfaceDamage();
+  if (surface->IsOnScreen())
+    clear = damage;
+
+  clear.left = std::max(clear.left, 0);
+  clear.top = std::max(clear.top, 0);
+  clear.right = std::min(clear.right, width);
+  clear.bottom = std::min(clear.bottom, height);
+  if (clear.left >= clear.right)
+    return;
+
+  for (int y = clear.top; y < clear.bottom; y++) {
+    memset(target_.pixels + y * target_.pitch + clear.left * 4, 0,
+           (clear.right - clear.left) * 4);
+  }
+}
+
+bool SWRenderer::Draw(const std::vector<RenderState> &render_states,
+                      NativeSurface *surface) {
+  // Protected content can't be read by the cpu.
+  surface->GetLayer()->SetProtected(false);
+  if (!surface->MakeCurrent())
+    return false;
+
+  handler_ = static_cast<SWSurface *>(surface)->GetBufferHandler();
+  if (!handler_ ||
+      !MapImage(surface->GetLayer()->GetBuffer(), true, &target_))
+    return false;
+
+  if (!Is8888Format(target_.format)) {
+    ETRACE("Software renderer can't draw into surface of format %4.4s.",
+           (char *)&target_.format);
+    UnmapImage(&target_);
+    return false;
+  }
+
+  target_bgra_ = IsBGRAFormat(target_.format);
+  bool clear_surface = surface->ClearSurface();
+  bool partial_clear = surface->IsPartialClear();
+  surface->SetClearSurface(NativeSurface::kNone);
+  if (clear_surface || partial_clear)
+    ClearSurface(surface);
+
+  bool succeeded = true;
+  uint32_t width = std::min<uint32_t>(target_.width, surface->GetWidth());
+  uint32_t height = std::min<uint32_t>(target_.height, surface->GetHeight());
+  tiles_.clear();
+  layer_images_.clear();
+  for (const RenderState &state : render_states) {
+    uint32_t images = layer_images_.size();
+    for (const RenderState::LayerState &layer : state.layer_state_) {
+      int32_t image = -1;
+      if (layer.handle_) {
+        image = GetImage(layer.handle_);
+        if (image < 0)
+          succeeded = false;
+      }
+
+      layer_images_.emplace_back(image);
+    }
+
+    if (!succeeded)
+      break;
+
+    if (state.x_ + state.width_ > width) {
+      ETRACE("Region outside of surface %d %d.", state.x_ + state.width_,
+             width);
+      succeeded = false;
+      break;
+    }
+
+    uint32_t bottom = std::min(state.y_ + state.height_, height);
+    for (uint32_t top = state.y_; top < bottom; top += kTileRows) {
+      tiles_.emplace_back(
+          Tile{&state, images, top, std::min(top + kTileRows, bottom)});
+    }
+  }
+
+  if (succeeded && !tiles_.empty()) {
+    next_tile_.store(0, std::memory_order_relaxed);
+    size_t num_tasks = std::min(tiles_.size(), tasks_.size());
+    TaskExecutor &executor = TaskExecutor::GetInstance();
+    for (size_t i = 0; i < num_tasks; i++) {
+      completions_.emplace_back(
+          executor.Post(tasks_[i].get(), TaskExecutor::kHigh));
+    }
+
+    for (std::shared_ptr<TaskExecutor::Completion> &completion :
+         completions_) {
+      completion->Wait();
+    }
+
+    completions_.clear();
+  }
+
+  for (Image &image : images_) {
+    UnmapImage(&image);
+  }
+
+  images_.clear();
+  UnmapImage(&target_);
+  // Drawing is done once the surface has been unmapped.
+  surface->SetNativeFence(-1);
+  surface->ResetDamage();
+  return succeeded;
+}
+
+void SWRenderer::TileTask::Run() {
+  std::vector<Tile> &tiles = renderer_->tiles_;
+  uint32_t width = renderer_->target_.width;
+  if (rows_.size() < width * 8) {
+    rows_.resize(width * 8);
+    pixels_.resize(width);
+  }
+
+  while (true) {
+    uint32_t index =
+        renderer_->next_tile_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= tiles.size())
+      return;
+
+    renderer_->DrawTile(tiles[index], rows_.data(), pixels_.data());
+  }
+}
+
+void SWRenderer::FetchRow(const RenderState &state,
+                          const RenderState::LayerState &layer,
+                          const Image &image, uint32_t y, uint32_t *pixels,
+                          const uint32_t **row) const {
+  // Texture coordinates of the pixel centers, like the GL vertex shader
+  // computes them for the corners of the region.
+  const float *crop = layer.crop_bounds_;
+  const float *matrix = layer.texture_matrix_;
+  float crop_width = (crop[2] - crop[0]) * image.width;
+  float crop_height = (crop[3] - crop[1]) * image.height;
+  float u = 0.5f / state.width_;
+  float v = (y + 0.5f - state.y_) / state.height_;
+  float start_x =
+      crop[0] * image.width + (u * matrix[0] + v * matrix[1]) * crop_width;
+  float start_y =
+      crop[1] * image.height + (u * matrix[2] + v * matrix[3]) * crop_height;
+  float step_x = matrix[0] * crop_width / state.width_;
+  float step_y = matrix[2] * crop_height / state.width_;
+  uint32_t count = state.width_;
+  int32_t max_x = image.width - 1;
+  int32_t max_y = image.height - 1;
+
+  // Unscaled and not rotated, read the source row directly.
+  if (image.format != DRM_FORMAT_NV12 && step_y == 0.0f &&
+      fabsf(step_x - 1.0f) < 1e-4f) {
+    int32_t first = floorf(start_x);
+    int32_t last = floorf(start_x + (count - 1) * step_x);
+    int32_t source_y = floorf(start_y);
+    if (first >= 0 && last == first + static_cast<int32_t>(count) - 1 &&
+        last <= max_x && source_y >= 0 && source_y <= max_y) {
+      *row = reinterpret_cast<const uint32_t *>(
+                 image.pixels + source_y * image.pitch) +
+             first;
+      return;
+    }
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    int32_t source_x = floorf(start_x + i * step_x);
+    int32_t source_y = floorf(start_y + i * step_y);
+    source_x = std::min(std::max(source_x, 0), max_x);
+    source_y = std::min(std::max(source_y, 0), max_y);
+    if (image.format == DRM_FORMAT_NV12) {
+      const uint8_t *uv =
+          image.uv + (source_y / 2) * image.uv_pitch + (source_x / 2) * 2;
+      pixels[i] = YUVToPixel(image.pixels[source_y * image.pitch + source_x],
+                             uv[0], uv[1]);
+    } else {
+      pixels[i] = reinterpret_cast<const uint32_t *>(
+          image.pixels + source_y * image.pitch)[source_x];
+    }
+  }
+
+  *row = pixels;
+}
+
+void SWRenderer::DrawTile(const Tile &tile, float *rows, uint32_t *pixels) {
+  const RenderState &state = *tile.state;
+  uint32_t count = state.width_;
+  float *const acc[4] = {rows, rows + count, rows + 2 * count,
+                         rows + 3 * count};
+  float *const src[4] = {rows + 4 * count, rows + 5 * count, rows + 6 * count,
+                         rows + 7 * count};
+  size_t size = state.layer_state_.size();
+  for (uint32_t y = tile.top; y < tile.bottom; y++) {
+    std::fill(rows, rows + 3 * count, 0.0f);
+    std::fill(acc[3], acc[3] + count, 1.0f);
+    for (size_t i = 0; i < size; i++) {
+      const RenderState::LayerState &layer = state.layer_state_[i];
+      int32_t image = layer_images_[tile.images + i];
+      if (image < 0) {
+        // Solid color, bytes are A, B, G, R.
+        const uint8_t *color = layer.solid_color_array_;
+        std::fill(src[0], src[0] + count, color[3] / 255.0f);
+        std::fill(src[1], src[1] + count, color[2] / 255.0f);
+        std::fill(src[2], src[2] + count, color[1] / 255.0f);
+        std::fill(src[3], src[3] + count, color[0] / 255.0f);
+      } else {
+        const Image &source = images_[image];
+        const uint32_t *row = NULL;
+        FetchRow(state, layer, source, y, pixels, &row);
+        bool nv12 = source.format == DRM_FORMAT_NV12;
+        kernels_.unpack(reinterpret_cast<const uint8_t *>(row), count,
+                        !nv12 && IsBGRAFormat(source.format),
+                        IsOpaqueFormat(source.format), src);
+      }
+
+      if (kernels_.blend(src, layer.alpha_, layer.premult_, acc, count) <=
+          kMinCoverage)
+        break;
+    }
+
+    kernels_.pack(acc, count, target_bgra_,
+                  target_.pixels + y * target_.pitch + state.x_ * 4);
+  }
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,126 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_COMPOSITOR_SW_SWRENDERER_H_
+#define COMMON_COMPOSITOR_SW_SWRENDERER_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <platformdefines.h>
+
+#include "renderer.h"
+#include "renderstate.h"
+#include "swkernels.h"
+#include "taskexecutor.h"
+
+namespace hwcomposer {
+
+class NativeBufferHandler;
+class OverlayBuffer;
+
+// Composites on the cpu, for systems without a usable GPU. Follows the
+// blending of the GL shaders, sampling layers with nearest filtering. The
+// regions to draw are split into tiles of rows, which are drawn in
+// parallel on the TaskExecutor workers and the calling thread. Layers can
+// be ARGB/XRGB/ABGR/XBGR8888 or NV12, surfaces any of the 32 bit formats.
+// A renderer created with reference set produces the same pixels without
+// using SIMD instructions, to check other renderers against. Factory
+// creates one when SOFTWARE_COMPOSITOR_REFERENCE is set in hwc_display.ini.
+class SWRenderer : public Renderer {
+ public:
+  explicit SWRenderer(bool reference = false);
+  ~SWRenderer() override;
+
+  bool Init() override;
+  bool Draw(const std::vector<RenderState> &commands,
+            NativeSurface *surface) override;
+
+  // Waits for kms_fence on the calling thread.
+  void InsertFence(int32_t kms_fence) override;
+
+  void SetDisableExplicitSync(bool disable_explicit_sync) override;
+
+ private:
+  // Cpu mapping of a buffer.
+  struct Image {
+    OverlayBuffer *buffer = NULL;
+    HWCNativeHandle handle = 0;
+    void *map_data = NULL;
+    uint8_t *pixels = NULL;
+    const uint8_t *uv = NULL;
+    uint32_t pitch = 0;
+    uint32_t uv_pitch = 0;
+    uint32_t format = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+  };
+
+  // Rows [top, bottom) of a region. images is the offset of the indices
+  // into images_ of the layers of state in layer_images_.
+  struct Tile {
+    const RenderState *state;
+    uint32_t images;
+    uint32_t top;
+    uint32_t bottom;
+  };
+
+  // Draws tiles till none are left.
+  class TileTask : public Task {
+   public:
+    explicit TileTask(SWRenderer *renderer) : renderer_(renderer) {
+    }
+
+    void Run() override;
+
+   private:
+    SWRenderer *renderer_;
+    // Scratch rows, see DrawTile.
+    std::vector<float> rows_;
+    std::vector<uint32_t> pixels_;
+  };
+
+  // Maps buffer for reading, or for writing too if write is true.
+  bool MapImage(OverlayBuffer *buffer, bool write, Image *image);
+  void UnmapImage(Image *image);
+  // Returns index of buffer in images_, mapping it if needed. -1 if buffer
+  // can't be drawn.
+  int32_t GetImage(OverlayBuffer *buffer);
+  void ClearSurface(NativeSurface *surface);
+  void DrawTile(const Tile &tile, float *rows, uint32_t *pixels);
+  // Points row at the pixels of image for row y of the region of state.
+  // Rows which need to be scaled, rotated or converted are sampled into
+  // pixels first, NV12 as R, G, B, A bytes.
+  void FetchRow(const RenderState &state,
+                const RenderState::LayerState &layer, const Image &image,
+                uint32_t y, uint32_t *pixels, const uint32_t **row) const;
+
+  const SWKernels &kernels_;
+  const NativeBufferHandler *handler_ = NULL;
+  Image target_;
+  bool target_bgra_ = true;
+  std::vector<Image> images_;
+  std::vector<int32_t> layer_images_;
+  std::vector<Tile> tiles_;
+  std::atomic<uint32_t> next_tile_{0};
+  std::vector<std::unique_ptr<TileTask>> tasks_;
+  std::vector<std::shared_ptr<TaskExecutor::Completion>> completions_;
+  bool disable_explicit_sync_ = false;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_COMPOSITOR_SW_SWRENDERER_H_
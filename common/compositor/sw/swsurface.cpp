@@ -0,0 +1,41 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "swsurface.h"
+
+#include "resourcemanager.h"
+
+namespace hwcomposer {
+
+SWSurface::SWSurface(uint32_t width, uint32_t height)
+    : NativeSurface(width, height) {
+}
+
+SWSurface::~SWSurface() {
+}
+
+bool SWSurface::MakeCurrent() {
+  return resource_manager_ && layer_.GetBuffer();
+}
+
+const NativeBufferHandler* SWSurface::GetBufferHandler() const {
+  if (!resource_manager_)
+    return NULL;
+
+  return resource_manager_->GetNativeBufferHandler();
+}
+
+}  // namespace hwcomposer
@@ -275,18 +275,40 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
 
   layer_out->SetProtected(false);
 
-  VAStatus ret = VA_STATUS_SUCCESS;
-  ret = vaBeginPicture(va_display_, va_context_, surface_out);
-
+  // Filters apply to the video layers only, other layers like subtitles
+  // are blended on top as they are.
   OverlayLayer* layer_in = NULL;
   uint32_t total_layers = state.layers_.size();
-  std::vector<ScopedVABufferID> pipeline_buffers(total_layers, va_display_);
+  for (auto itr = state.colors_.begin(); itr != state.colors_.end(); itr++) {
+    SetVAProcFilterColorValue(itr->first, itr->second);
+  }
+
+  for (uint32_t i = 0; i < total_layers; i++) {
+    layer_in = state.layers_.at(i);
+    if (layer_in->IsVideoLayer() && layer_in->GetBuffer()) {
+      SetVAProcFilterDeinterlaceMode(state.deinterlace_,
+                                     layer_in->GetBuffer());
+      break;
+    }
+  }
+
+  if (!UpdateCaps()) {
+    ETRACE("Failed to update capabailities. \n");
+    return false;
+  }
+
+  while (layer_slots_.size() < total_layers) {
+    layer_slots_.emplace_back(new LayerSlot(va_display_));
+  }
+
+  VAStatus ret = VA_STATUS_SUCCESS;
+  ret = vaBeginPicture(va_display_, va_context_, surface_out);
 
   for (uint32_t i = 0; i < total_layers; i++) {
     layer_in = state.layers_.at(i);
     if (layer_in->IsSolidColor())
       continue;
-    ScopedVABufferID& pipeline_buffer = pipeline_buffers.at(i);
+    LayerSlot& slot = *layer_slots_.at(i);
     // Get Input Surface.
     OverlayBuffer* buffer_in = layer_in->GetBuffer();
     if (!buffer_in) {
@@ -308,14 +330,14 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
       layer_out->SetProtected(true);
     }
 
-    VARectangle surface_region;
+    VARectangle& surface_region = slot.surface_region;
     const HwcRect<float>& source_crop = layer_in->GetSourceCrop();
     surface_region.x = static_cast<int>(source_crop.left);
     surface_region.y = static_cast<int>(source_crop.top);
     surface_region.width = layer_in->GetSourceCropWidth();
     surface_region.height = layer_in->GetSourceCropHeight();
 
-    VARectangle output_region;
+    VARectangle& output_region = slot.output_region;
     HwcRect<int> display_frame = layer_in->GetDisplayFrame();
     display_frame = TranslateRect(display_frame, -xtranslation, -ytranslation);
     output_region.x = display_frame.left;
@@ -343,8 +365,20 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
 #endif
 
 #ifdef VA_WITH_VPP
-    VABlendState bs = {};
-    bs.flags = VA_BLEND_PREMULTIPLIED_ALPHA;
+    // VA has no blending with non premultiplied per pixel alpha, layers
+    // needing it are kept off video planes by DisplayPlaneState::AddLayer.
+    // Video layers themselves have no per pixel alpha, so coverage blending
+    // of them is the same as none.
+    VABlendState& bs = slot.blend_state;
+    bs = {};
+    if (layer_in->GetBlending() == HWCBlending::kBlendingPremult)
+      bs.flags = VA_BLEND_PREMULTIPLIED_ALPHA;
+
+    if (layer_in->GetAlpha() != 255) {
+      bs.flags |= VA_BLEND_GLOBAL_ALPHA;
+      bs.global_alpha = layer_in->GetAlpha() / 255.0f;
+    }
+
     pipe_param.blend_state = &bs;
 #endif
 
@@ -353,21 +387,11 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
     DUMPTRACE("Layer DisplayFrame:(%d,%d,%d,%d)\n", output_region.x,
               output_region.y, output_region.width, output_region.height);
 
-    for (auto itr = state.colors_.begin(); itr != state.colors_.end(); itr++) {
-      SetVAProcFilterColorValue(itr->first, itr->second);
-    }
-    SetVAProcFilterDeinterlaceMode(state.deinterlace_, buffer_in);
-
-    if (!UpdateCaps()) {
-      ETRACE("Failed to update capabailities. \n");
-      return false;
-    }
-
     pipe_param.filter_flags = GetVAProcFilterScalingMode(state.scaling_mode_);
-    if (filters_.size()) {
+    if (filters_.size() && layer_in->IsVideoLayer()) {
       pipe_param.filters = filters_.data();
+      pipe_param.num_filters = static_cast<unsigned int>(filters_.size());
     }
-    pipe_param.num_filters = static_cast<unsigned int>(filters_.size());
 
 #if VA_MAJOR_VERSION >= 1
     // currently rotation is only supported by VA on Android.
@@ -377,7 +401,8 @@ bool VARenderer::Draw(const MediaState& state, NativeSurface* surface) {
     pipe_param.mirror_state = mirror;
 #endif
 
-    if (!pipeline_buffer.CreateBuffer(
+    ScopedVABufferID& pipeline_buffer = slot.pipeline_buffer;
+    if (!pipeline_buffer.UpdateBuffer(
             va_context_, VAProcPipelineParameterBufferType,
             sizeof(VAProcPipelineParameterBuffer), 1, &pipe_param)) {
       return false;
@@ -474,6 +499,8 @@ void VARenderer::DestroyContext() {
   std::vector<VABufferID>().swap(filters_);
   std::vector<ScopedVABufferID>().swap(cb_elements_);
   std::vector<ScopedVABufferID>().swap(sharp_);
+  std::vector<ScopedVABufferID>().swap(deinterlace_);
+  std::vector<std::unique_ptr<LayerSlot>>().swap(layer_slots_);
 }
 
 bool VARenderer::UpdateCaps() {
@@ -483,14 +510,15 @@ bool VARenderer::UpdateCaps() {
 
   update_caps_ = false;
 
-  std::vector<ScopedVABufferID> cb_elements(1, va_display_);
-  std::vector<ScopedVABufferID> sharp(1, va_display_);
-  std::vector<ScopedVABufferID> deinterlace(1, va_display_);
+  // Filter buffers are created once per context and updated in place.
+  if (cb_elements_.empty())
+    cb_elements_.emplace_back(va_display_);
+  if (sharp_.empty())
+    sharp_.emplace_back(va_display_);
+  if (deinterlace_.empty())
+    deinterlace_.emplace_back(va_display_);
 
-  std::vector<VABufferID>().swap(filters_);
-  std::vector<ScopedVABufferID>().swap(cb_elements_);
-  std::vector<ScopedVABufferID>().swap(sharp_);
-  std::vector<ScopedVABufferID>().swap(deinterlace_);
+  filters_.clear();
 
   VAProcFilterParameterBufferColorBalance cbparam[VAProcColorBalanceCount];
   VAProcFilterParameterBuffer sharpparam;
@@ -513,15 +541,14 @@ bool VARenderer::UpdateCaps() {
   }
 
   if (index) {
-    if (!cb_elements[0].CreateBuffer(
+    if (!cb_elements_[0].UpdateBuffer(
             va_context_, VAProcFilterParameterBufferType,
             sizeof(VAProcFilterParameterBufferColorBalance), index, cbparam)) {
       ETRACE("Create color fail\n");
       return false;
     }
-    filters_.push_back(cb_elements[0].buffer());
+    filters_.push_back(cb_elements_[0].buffer());
   }
-  cb_elements_.swap(cb_elements);
 
   if (sharp_caps_.use_default_) {
     sharp_caps_.value_ = sharp_caps_.caps_.range.default_value;
@@ -530,27 +557,25 @@ bool VARenderer::UpdateCaps() {
       sharp_caps_.caps_.range.step) {
     sharpparam.value = sharp_caps_.value_;
     sharpparam.type = VAProcFilterSharpening;
-    if (!sharp[0].CreateBuffer(va_context_, VAProcFilterParameterBufferType,
-                               sizeof(VAProcFilterParameterBuffer), 1,
-                               &sharpparam)) {
+    if (!sharp_[0].UpdateBuffer(va_context_, VAProcFilterParameterBufferType,
+                                sizeof(VAProcFilterParameterBuffer), 1,
+                                &sharpparam)) {
       return false;
     }
-    filters_.push_back(sharp[0].buffer());
+    filters_.push_back(sharp_[0].buffer());
   }
-  sharp_.swap(sharp);
 
   if (deinterlace_caps_.mode_ != VAProcDeinterlacingNone) {
     deinterlaceparam.algorithm = deinterlace_caps_.mode_;
     deinterlaceparam.type = VAProcFilterDeinterlacing;
-    if (!deinterlace[0].CreateBuffer(
+    if (!deinterlace_[0].UpdateBuffer(
             va_context_, VAProcFilterParameterBufferType,
             sizeof(VAProcFilterParameterBufferDeinterlacing), 1,
             &deinterlaceparam)) {
       return false;
     }
-    filters_.push_back(deinterlace[0].buffer());
+    filters_.push_back(deinterlace_[0].buffer());
   }
-  deinterlace_.swap(deinterlace);
 
   return true;
 }
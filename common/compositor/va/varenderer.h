@@ -17,7 +17,10 @@
 #ifndef COMMON_COMPOSITOR_VA_VARENDERER_H_
 #define COMMON_COMPOSITOR_VA_VARENDERER_H_
 
+#include <string.h>
+
 #include <map>
+#include <memory>
 
 #include "hwcdefs.h"
 #include "overlaybuffer.h"
@@ -48,6 +51,33 @@ class ScopedVABufferID {
     return ret == VA_STATUS_SUCCESS ? true : false;
   }
 
+  // Overwrites contents of the buffer with data. The buffer is created
+  // first if it doesn't exist yet or holds a different number of elements.
+  bool UpdateBuffer(VAContextID context, VABufferType type, uint32_t size,
+                    uint32_t num, void* data) {
+    if (buffer_ != VA_INVALID_ID && size == size_ && num == num_) {
+      void* map = NULL;
+      if (vaMapBuffer(display_, buffer_, &map) == VA_STATUS_SUCCESS) {
+        memcpy(map, data, size * num);
+        return vaUnmapBuffer(display_, buffer_) == VA_STATUS_SUCCESS;
+      }
+    }
+
+    if (buffer_ != VA_INVALID_ID) {
+      vaDestroyBuffer(display_, buffer_);
+      buffer_ = VA_INVALID_ID;
+    }
+
+    if (!CreateBuffer(context, type, size, num, data)) {
+      buffer_ = VA_INVALID_ID;
+      return false;
+    }
+
+    size_ = size;
+    num_ = num;
+    return true;
+  }
+
   operator VABufferID() const {
     return buffer_;
   }
@@ -63,6 +93,8 @@ class ScopedVABufferID {
  private:
   VADisplay display_;
   VABufferID buffer_ = VA_INVALID_ID;
+  uint32_t size_ = 0;
+  uint32_t num_ = 0;
 };
 
 struct HwcColorBalanceCap {
@@ -97,6 +129,21 @@ class VARenderer : public Renderer {
   bool DestroyMediaResources(std::vector<struct media_import>&) override;
 
  private:
+  // Pipeline parameters of the layer at the same index of every draw. The
+  // parameter buffer points to the regions and blend state, so they have to
+  // stay valid till the picture has been rendered.
+  struct LayerSlot {
+    explicit LayerSlot(VADisplay display) : pipeline_buffer(display) {
+    }
+
+    ScopedVABufferID pipeline_buffer;
+    VARectangle surface_region;
+    VARectangle output_region;
+#ifdef VA_WITH_VPP
+    VABlendState blend_state;
+#endif
+  };
+
   bool QueryVAProcFilterCaps(VAContextID context, VAProcFilterType type,
                              void* caps, uint32_t* num);
   unsigned int GetVAProcFilterScalingMode(uint32_t mode);
@@ -125,6 +172,7 @@ class VARenderer : public Renderer {
   std::vector<ScopedVABufferID> cb_elements_;
   std::vector<ScopedVABufferID> sharp_;
   std::vector<ScopedVABufferID> deinterlace_;
+  std::vector<std::unique_ptr<LayerSlot>> layer_slots_;
   std::map<HWCColorControl, HwcColorBalanceCap> colorbalance_caps_;
   HwcFilterCap sharp_caps_;
   HwcDeinterlaceCap deinterlace_caps_;
@@ -15,6 +15,8 @@
 #include "vkrenderer.h"
 #include "vkprogram.h"
 
+#include <algorithm>
+
 #include "hwctrace.h"
 #include "nativesurface.h"
 #include "renderstate.h"
@@ -22,6 +24,19 @@
 namespace hwcomposer {
 
 VKRenderer::~VKRenderer() {
+  if (dev_ == VK_NULL_HANDLE)
+    return;
+
+  vkDeviceWaitIdle(dev_);
+  for (Frame &frame : frames_) {
+    vkDestroyFence(dev_, frame.fence, NULL);
+  }
+
+  for (VkDescriptorPool pool : desc_pools_) {
+    vkDestroyDescriptorPool(dev_, pool, NULL);
+  }
+
+  vkDestroySemaphore(dev_, timeline_semaphore_, NULL);
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL VulkanDebugReportCallback(
@@ -208,6 +223,17 @@ bool VKRenderer::Init() {
   VkApplicationInfo app_info = {};
   app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
   app_info.apiVersion = VK_MAKE_VERSION(1, 0, 0);
+#ifdef VK_EXT_image_drm_format_modifier
+  // The dma-buf import used without VK_INTEL_dma_buf_image needs 1.1.
+  PFN_vkEnumerateInstanceVersion enumerate_instance_version =
+      (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(
+          NULL, "vkEnumerateInstanceVersion");
+  uint32_t instance_version = VK_API_VERSION_1_0;
+  if (enumerate_instance_version &&
+      enumerate_instance_version(&instance_version) == VK_SUCCESS &&
+      instance_version >= VK_API_VERSION_1_1)
+    app_info.apiVersion = VK_API_VERSION_1_1;
+#endif
 
   VkInstanceCreateInfo instance_create = {};
   instance_create.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -279,16 +305,86 @@ bool VKRenderer::Init() {
   queue_create.queueCount = 1;
   queue_create.pQueuePriorities = &queue_priority;
 
-  const char *device_extensions[] = {};
+  res = vkEnumerateDeviceExtensionProperties(phys_dev, NULL, &count, NULL);
+  if (res != VK_SUCCESS) {
+    ETRACE("vkEnumerateDeviceExtensionProperties failed (%d)\n", res);
+    return false;
+  }
+
+  std::vector<VkExtensionProperties> extension_props(count);
+  res = vkEnumerateDeviceExtensionProperties(phys_dev, NULL, &count,
+                                             extension_props.data());
+  if (res != VK_SUCCESS) {
+    ETRACE("vkEnumerateDeviceExtensionProperties failed (%d)\n", res);
+    return false;
+  }
 
+  std::vector<const char *> device_extensions;
   VkDeviceCreateInfo device_create = {};
   device_create.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   device_create.queueCreateInfoCount = 1;
   device_create.pQueueCreateInfos = &queue_create;
   device_create.enabledLayerCount = ARRAY_SIZE(enabled_layers);
   device_create.ppEnabledLayerNames = &enabled_layers[0];
-  device_create.enabledExtensionCount = ARRAY_SIZE(device_extensions);
-  device_create.ppEnabledExtensionNames = &device_extensions[0];
+
+  bool timeline_semaphore = false;
+#ifdef VK_KHR_timeline_semaphore
+  for (const VkExtensionProperties &props : extension_props) {
+    if (!strcmp(props.extensionName,
+                VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+      timeline_semaphore = true;
+      break;
+    }
+  }
+
+  // The feature is required to be supported by devices exposing the
+  // extension.
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = {};
+  timeline_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  timeline_features.timelineSemaphore = VK_TRUE;
+  if (timeline_semaphore) {
+    device_extensions.emplace_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    device_create.pNext = &timeline_features;
+  }
+#endif
+
+#ifdef VK_EXT_image_drm_format_modifier
+  // Drivers without VK_INTEL_dma_buf_image, like lavapipe, import the
+  // buffers with the standard dma-buf extensions, see
+  // DrmBuffer::GetGpuResource.
+  const char *dma_buf_extensions[] = {
+      VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+      VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+      VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME,
+      VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME,
+  };
+
+  VkPhysicalDeviceProperties phys_dev_props;
+  vkGetPhysicalDeviceProperties(phys_dev, &phys_dev_props);
+  size_t dma_buf_count = 0;
+  if (app_info.apiVersion >= VK_API_VERSION_1_1 &&
+      phys_dev_props.apiVersion >= VK_API_VERSION_1_1) {
+    for (const char *name : dma_buf_extensions) {
+      for (const VkExtensionProperties &props : extension_props) {
+        if (!strcmp(props.extensionName, name)) {
+          dma_buf_count++;
+          break;
+        }
+      }
+    }
+  }
+
+  if (dma_buf_count == ARRAY_SIZE(dma_buf_extensions)) {
+    device_extensions.insert(device_extensions.end(), &dma_buf_extensions[0],
+                             &dma_buf_extensions[dma_buf_count]);
+  } else {
+    ITRACE("dma-buf import extensions not supported\n");
+  }
+#endif
+
+  device_create.enabledExtensionCount = device_extensions.size();
+  device_create.ppEnabledExtensionNames = device_extensions.data();
 
   res = vkCreateDevice(phys_dev, &device_create, NULL, &dev_);
   if (res != VK_SUCCESS) {
@@ -305,6 +401,8 @@ bool VKRenderer::Init() {
 
   VkCommandPoolCreateInfo pool_create = {};
   pool_create.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  // Command buffers of the frames are reset when they are re-used.
+  pool_create.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
   res = vkCreateCommandPool(dev_, &pool_create, NULL, &cmd_pool_);
   if (res != VK_SUCCESS) {
@@ -372,26 +470,8 @@ bool VKRenderer::Init() {
 
   ring_buffer_ = RingBuffer(uniform_buffer_ptr, buffer_create.size);
 
-  VkDescriptorPoolSize pool_sizes[2];
-  pool_sizes[0] = {};
-  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  pool_sizes[0].descriptorCount = 256;
-  pool_sizes[1] = {};
-  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  pool_sizes[1].descriptorCount = 256;
-
-  VkDescriptorPoolCreateInfo desc_pool_create = {};
-  desc_pool_create.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  desc_pool_create.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-  desc_pool_create.maxSets = 256;
-  desc_pool_create.poolSizeCount = ARRAY_SIZE(pool_sizes);
-  desc_pool_create.pPoolSizes = &pool_sizes[0];
-
-  res = vkCreateDescriptorPool(dev_, &desc_pool_create, NULL, &desc_pool_);
-  if (res != VK_SUCCESS) {
-    ETRACE("vkCreateDescriptorPool failed (%d)\n", res);
+  if (!AddDescriptorPool())
     return false;
-  }
 
   VkSamplerCreateInfo sampler_create = {};
   sampler_create.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -461,9 +541,163 @@ bool VKRenderer::Init() {
     return false;
   }
 
+  return InitFrames(timeline_semaphore);
+}
+
+bool VKRenderer::InitFrames(bool timeline_semaphore) {
+  VkResult res;
+#ifdef VK_KHR_timeline_semaphore
+  if (timeline_semaphore) {
+    wait_semaphores_ = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(
+        dev_, "vkWaitSemaphoresKHR");
+  }
+
+  if (wait_semaphores_) {
+    VkSemaphoreTypeCreateInfoKHR semaphore_type = {};
+    semaphore_type.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    semaphore_type.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    semaphore_type.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_create = {};
+    semaphore_create.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_create.pNext = &semaphore_type;
+
+    res = vkCreateSemaphore(dev_, &semaphore_create, NULL,
+                            &timeline_semaphore_);
+    if (res != VK_SUCCESS) {
+      ETRACE("vkCreateSemaphore failed (%d)\n", res);
+      return false;
+    }
+  }
+#else
+  (void)timeline_semaphore;
+#endif
+
+  VkCommandBuffer cmd_buffers[kFramesInFlight];
+  VkCommandBufferAllocateInfo cmd_buffer_alloc = {};
+  cmd_buffer_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmd_buffer_alloc.commandPool = cmd_pool_;
+  cmd_buffer_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmd_buffer_alloc.commandBufferCount = kFramesInFlight;
+
+  res = vkAllocateCommandBuffers(dev_, &cmd_buffer_alloc, cmd_buffers);
+  if (res != VK_SUCCESS) {
+    ETRACE("vkAllocateCommandBuffers failed (%d)\n", res);
+    return false;
+  }
+
+  VkFenceCreateInfo fence_create = {};
+  fence_create.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  for (uint32_t i = 0; i < kFramesInFlight; i++) {
+    frames_[i].cmd_buffer = cmd_buffers[i];
+    if (timeline_semaphore_ != VK_NULL_HANDLE)
+      continue;
+
+    res = vkCreateFence(dev_, &fence_create, NULL, &frames_[i].fence);
+    if (res != VK_SUCCESS) {
+      ETRACE("vkCreateFence failed (%d)\n", res);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool VKRenderer::WaitForFrame(Frame &frame) {
+  if (!frame.submitted)
+    return true;
+
+  VkResult res;
+#ifdef VK_KHR_timeline_semaphore
+  if (timeline_semaphore_ != VK_NULL_HANDLE) {
+    VkSemaphoreWaitInfoKHR wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &timeline_semaphore_;
+    wait_info.pValues = &frame.timeline_value;
+    res = wait_semaphores_(dev_, &wait_info, UINT64_MAX);
+  } else
+#endif
+  {
+    res = vkWaitForFences(dev_, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+    if (res == VK_SUCCESS)
+      res = vkResetFences(dev_, 1, &frame.fence);
+  }
+
+  if (res != VK_SUCCESS) {
+    ETRACE("Failed to wait for frame (%d)\n", res);
+    return false;
+  }
+
+  frame.submitted = false;
   return true;
 }
 
+bool VKRenderer::AddDescriptorPool() {
+  // Each set has two uniform buffers and a sampler per layer.
+  VkDescriptorPoolSize pool_sizes[2];
+  pool_sizes[0] = {};
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  pool_sizes[0].descriptorCount = 2 * 256;
+  pool_sizes[1] = {};
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_sizes[1].descriptorCount = 4 * 256;
+
+  VkDescriptorPoolCreateInfo desc_pool_create = {};
+  desc_pool_create.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  desc_pool_create.maxSets = 256;
+  desc_pool_create.poolSizeCount = ARRAY_SIZE(pool_sizes);
+  desc_pool_create.pPoolSizes = &pool_sizes[0];
+
+  VkDescriptorPool pool;
+  VkResult res = vkCreateDescriptorPool(dev_, &desc_pool_create, NULL, &pool);
+  if (res != VK_SUCCESS) {
+    ETRACE("vkCreateDescriptorPool failed (%d)\n", res);
+    return false;
+  }
+
+  desc_pools_.emplace_back(pool);
+  return true;
+}
+
+VkDescriptorSet VKRenderer::GetDescriptorSet(Frame &frame, VKProgram *program,
+                                             size_t layer_count) {
+  if (frame.desc_sets.size() < layer_count) {
+    frame.desc_sets.resize(layer_count);
+    frame.used_desc_sets.resize(layer_count, 0);
+  }
+
+  std::vector<VkDescriptorSet> &desc_sets = frame.desc_sets[layer_count - 1];
+  size_t &used = frame.used_desc_sets[layer_count - 1];
+  if (used < desc_sets.size())
+    return desc_sets[used++];
+
+  VkDescriptorSetLayout desc_layout = program->getDescLayout();
+  VkDescriptorSetAllocateInfo alloc_desc_set = {};
+  alloc_desc_set.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_desc_set.descriptorPool = desc_pools_.back();
+  alloc_desc_set.descriptorSetCount = 1;
+  alloc_desc_set.pSetLayouts = &desc_layout;
+
+  VkDescriptorSet desc_set;
+  VkResult res = vkAllocateDescriptorSets(dev_, &alloc_desc_set, &desc_set);
+  // Without VK_KHR_maintenance1 running out of pool space may also be
+  // reported as out of memory, so retry with a new pool on any error.
+  if (res != VK_SUCCESS && AddDescriptorPool()) {
+    alloc_desc_set.descriptorPool = desc_pools_.back();
+    res = vkAllocateDescriptorSets(dev_, &alloc_desc_set, &desc_set);
+  }
+
+  if (res != VK_SUCCESS) {
+    ETRACE("vkAllocateDescriptorSets failed (%d)\n", res);
+    return VK_NULL_HANDLE;
+  }
+
+  desc_sets.emplace_back(desc_set);
+  used++;
+  return desc_set;
+}
+
 bool VKRenderer::Draw(const std::vector<RenderState> &render_states,
                       NativeSurface *surface) {
   VkResult res;
@@ -473,46 +707,53 @@ bool VKRenderer::Draw(const std::vector<RenderState> &render_states,
   surface->GetLayer()->SetProtected(false);
   surface->MakeCurrent();
 
+  Frame &frame = frames_[frame_index_];
+  if (!WaitForFrame(frame))
+    return false;
+
+  frame_index_ = (frame_index_ + 1) % kFramesInFlight;
+  std::fill(frame.used_desc_sets.begin(), frame.used_desc_sets.end(), 0);
+  // The gpu is done with the uniform data of the last draw of frame.
+  frame.ub_allocs.clear();
+
   src_image_infos_.clear();
   ub_allocs_.clear();
-  std::vector<VkDescriptorSetLayout> desc_layouts;
-  std::vector<VkDescriptorSet> desc_sets(render_states.size());
-  std::vector<VkDescriptorBufferInfo> ub_infos;
+  draw_desc_sets_.clear();
+  ub_infos_.clear();
   for (const RenderState &state : render_states) {
     unsigned size = state.layer_state_.size();
     if (size == 0)
       break;
 
+    // Leaving out a region would leave a hole in the surface, fail the
+    // whole draw instead.
     VKProgram *program = GetProgram(size);
     if (!program)
-      continue;
+      return false;
 
-    desc_layouts.emplace_back(program->getDescLayout());
+    VkDescriptorSet desc_set = GetDescriptorSet(frame, program, size);
+    if (desc_set == VK_NULL_HANDLE)
+      return false;
+
+    draw_desc_sets_.emplace_back(desc_set);
 
     program->UseProgram(state, frame_width, frame_height);
 
-    ub_infos.emplace_back(program->getVertUBInfo());
-    ub_infos.emplace_back(program->getFragUBInfo());
+    ub_infos_.emplace_back(program->getVertUBInfo());
+    ub_infos_.emplace_back(program->getFragUBInfo());
   }
 
-  VkDescriptorSetAllocateInfo alloc_desc_set = {};
-  alloc_desc_set.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  alloc_desc_set.descriptorPool = desc_pool_;
-  alloc_desc_set.descriptorSetCount = (uint32_t)desc_layouts.size();
-  alloc_desc_set.pSetLayouts = desc_layouts.data();
+  // Keep the uniform data till the gpu is done with this frame.
+  frame.ub_allocs.swap(ub_allocs_);
 
-  res = vkAllocateDescriptorSets(dev_, &alloc_desc_set, desc_sets.data());
-  if (res != VK_SUCCESS) {
-    ETRACE("vkAllocateDescriptorSets failed (%d)\n", res);
-    return false;
-  }
-
-  std::vector<VkWriteDescriptorSet> write_desc_sets;
+  write_desc_sets_.clear();
+  size_t ub_infos_offset = 0;
   size_t src_image_infos_offset = 0;
-  for (size_t cmd_index = 0; cmd_index < render_states.size(); cmd_index++) {
+  for (size_t cmd_index = 0; cmd_index < draw_desc_sets_.size();
+       cmd_index++) {
+    VkDescriptorSet desc_set = draw_desc_sets_[cmd_index];
     const RenderState &state = render_states[cmd_index];
     size_t layer_count = state.layer_state_.size();
-    VkDescriptorSet desc_set = desc_sets[cmd_index];
 
     VkWriteDescriptorSet write_desc_set = {};
     write_desc_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -520,8 +761,8 @@ bool VKRenderer::Draw(const std::vector<RenderState> &render_states,
     write_desc_set.dstBinding = 0;
     write_desc_set.descriptorCount = 1;
     write_desc_set.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    write_desc_set.pBufferInfo = &ub_infos[cmd_index * 2 + 0];
-    write_desc_sets.emplace_back(write_desc_set);
+    write_desc_set.pBufferInfo = &ub_infos_[ub_infos_offset + 0];
+    write_desc_sets_.emplace_back(write_desc_set);
 
     write_desc_set = {};
     write_desc_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -529,8 +770,8 @@ bool VKRenderer::Draw(const std::vector<RenderState> &render_states,
     write_desc_set.dstBinding = 1;
     write_desc_set.descriptorCount = 1;
     write_desc_set.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    write_desc_set.pBufferInfo = &ub_infos[cmd_index * 2 + 1];
-    write_desc_sets.emplace_back(write_desc_set);
+    write_desc_set.pBufferInfo = &ub_infos_[ub_infos_offset + 1];
+    write_desc_sets_.emplace_back(write_desc_set);
 
     write_desc_set = {};
     write_desc_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -539,46 +780,34 @@ bool VKRenderer::Draw(const std::vector<RenderState> &render_states,
     write_desc_set.descriptorCount = (uint32_t)layer_count;
     write_desc_set.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     write_desc_set.pImageInfo = &src_image_infos_[src_image_infos_offset];
-    write_desc_sets.emplace_back(write_desc_set);
+    write_desc_sets_.emplace_back(write_desc_set);
 
+    ub_infos_offset += 2;
     src_image_infos_offset += layer_count;
   }
 
-  vkUpdateDescriptorSets(dev_, write_desc_sets.size(), write_desc_sets.data(),
-                         0, NULL);
-
-  VkCommandBufferAllocateInfo cmd_buffer_alloc = {};
-  cmd_buffer_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  cmd_buffer_alloc.commandPool = cmd_pool_;
-  cmd_buffer_alloc.commandBufferCount = 1;
-
-  VkCommandBuffer cmd_buffer;
-  res = vkAllocateCommandBuffers(dev_, &cmd_buffer_alloc, &cmd_buffer);
-  if (res != VK_SUCCESS) {
-    ETRACE("vkAllocateCommandBuffer failed (%d)\n", res);
-    return false;
-  }
+  vkUpdateDescriptorSets(dev_, write_desc_sets_.size(),
+                         write_desc_sets_.data(), 0, NULL);
 
+  VkCommandBuffer cmd_buffer = frame.cmd_buffer;
   VkCommandBufferBeginInfo begin_info = {};
   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
   res = vkBeginCommandBuffer(cmd_buffer, &begin_info);
   if (res != VK_SUCCESS) {
-    ETRACE("vkAllocateCommandBuffer failed (%d)\n", res);
+    ETRACE("vkBeginCommandBuffer failed (%d)\n", res);
     return false;
   }
 
-  std::vector<VkImageMemoryBarrier> barrier_before_clear;
-  barrier_before_clear.emplace_back(dst_barrier_before_clear_);
-  barrier_before_clear.insert(barrier_before_clear.end(),
-                              src_barrier_before_clear_.begin(),
-                              src_barrier_before_clear_.end());
+  barriers_.clear();
+  barriers_.emplace_back(dst_barrier_before_clear_);
+  barriers_.insert(barriers_.end(), src_barrier_before_clear_.begin(),
+                   src_barrier_before_clear_.end());
 
   vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, NULL, 0, NULL,
-                       barrier_before_clear.size(),
-                       barrier_before_clear.data());
+                       barriers_.size(), barriers_.data());
 
   VkClearValue clear_value[1];
   clear_value[0] = {};
@@ -616,10 +845,11 @@ bool VKRenderer::Draw(const std::vector<RenderState> &render_states,
   vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &vert_buffer_, &zero_offset);
 
   size_t last_layer_count = 0;
-  for (size_t cmd_index = 0; cmd_index < render_states.size(); cmd_index++) {
+  for (size_t cmd_index = 0; cmd_index < draw_desc_sets_.size();
+       cmd_index++) {
+    VkDescriptorSet desc_set = draw_desc_sets_[cmd_index];
     const RenderState &state = render_states[cmd_index];
     size_t layer_count = state.layer_state_.size();
-    VkDescriptorSet desc_set = desc_sets[cmd_index];
 
     VkRect2D scissor = {};
     scissor.offset = {
@@ -658,34 +888,48 @@ bool VKRenderer::Draw(const std::vector<RenderState> &render_states,
   submit.commandBufferCount = 1;
   submit.pCommandBuffers = &cmd_buffer;
 
-  res = vkQueueSubmit(queue_, 1, &submit, VK_NULL_HANDLE);
-  if (res != VK_SUCCESS) {
-    ETRACE("%d: vkQueueSubmit failed (%d)\n", __LINE__, res);
-    return false;
+#ifdef VK_KHR_timeline_semaphore
+  VkTimelineSemaphoreSubmitInfoKHR timeline_submit = {};
+  if (timeline_semaphore_ != VK_NULL_HANDLE) {
+    frame.timeline_value = ++timeline_value_;
+    timeline_submit.sType =
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timeline_submit.signalSemaphoreValueCount = 1;
+    timeline_submit.pSignalSemaphoreValues = &frame.timeline_value;
+    submit.pNext = &timeline_submit;
+    submit.signalSemaphoreCount = 1;
+    submit.pSignalSemaphores = &timeline_semaphore_;
   }
+#endif
 
-  res = vkQueueWaitIdle(queue_);
+  res = vkQueueSubmit(queue_, 1, &submit, frame.fence);
   if (res != VK_SUCCESS) {
-    ETRACE("vkQueueWaitIdle failed (%d)\n", res);
+    ETRACE("%d: vkQueueSubmit failed (%d)\n", __LINE__, res);
     return false;
   }
 
-  vkFreeCommandBuffers(dev_, cmd_pool_, 1, &cmd_buffer);
-
-  res = vkFreeDescriptorSets(dev_, desc_pool_, desc_sets.size(),
-                             desc_sets.data());
-  if (res != VK_SUCCESS) {
-    ETRACE("vkFreeDescriptorSets failed (%d)\n", res);
-    return false;
-  }
+  frame.submitted = true;
+  last_frame_ = &frame;
+  // Without explicit sync, InsertFence waits for all draws of the request
+  // at once.
+  if (!disable_explicit_sync_)
+    return WaitForFrame(frame);
 
   return true;
 }
 
 void VKRenderer::InsertFence(int32_t kms_fence) {
+  if (kms_fence > 0 || !last_frame_)
+    return;
+
+  // Frames complete in submission order, the surfaces drawn so far are
+  // ready once the last one is.
+  WaitForFrame(*last_frame_);
+  last_frame_ = NULL;
 }
 
 void VKRenderer::SetDisableExplicitSync(bool disable_explicit_sync) {
+  disable_explicit_sync_ = disable_explicit_sync;
 }
 
 VKProgram *VKRenderer::GetProgram(unsigned texture_count) {
@@ -35,19 +35,66 @@ class VKRenderer : public Renderer {
   void SetDisableExplicitSync(bool disable_explicit_sync) override;
 
  private:
+  // Number of draws which can be in flight on the gpu at the same time.
+  static const uint32_t kFramesInFlight = 3;
+
+  // Resources used by a draw, re-used once the gpu has completed it.
+  struct Frame {
+    VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+    // Signalled on completion if timeline semaphores aren't supported.
+    VkFence fence = VK_NULL_HANDLE;
+    // Value of timeline_semaphore_ signalled on completion.
+    uint64_t timeline_value = 0;
+    bool submitted = false;
+    // Descriptor sets allocated so far, indexed by layer count - 1, and
+    // how many of them are used by the draw.
+    std::vector<std::vector<VkDescriptorSet>> desc_sets;
+    std::vector<size_t> used_desc_sets;
+    // Uniform data of the draw in ring_buffer_.
+    std::vector<RingBuffer::Allocation> ub_allocs;
+  };
+
   VKProgram *GetProgram(unsigned texture_count);
   uint32_t GetMemoryTypeIndex(uint32_t mem_type_bits, uint32_t required_props);
   VkBuffer UploadBuffer(size_t data_size, const uint8_t *data,
                         VkBufferUsageFlags usage);
+  bool InitFrames(bool timeline_semaphore);
+  // Waits till the gpu is done with frame.
+  bool WaitForFrame(Frame &frame);
+  // Adds a descriptor pool to desc_pools_, used once the others are full.
+  bool AddDescriptorPool();
+  // Returns a descriptor set for program which isn't used by frame yet.
+  VkDescriptorSet GetDescriptorSet(Frame &frame, VKProgram *program,
+                                   size_t layer_count);
 
   VkPhysicalDeviceProperties device_props_;
   VkPhysicalDeviceMemoryProperties device_mem_props_;
   VkDeviceMemory uniform_buffer_mem_;
-  VkDescriptorPool desc_pool_;
+  // Descriptor sets are kept by the frames and never freed, a new pool is
+  // added when the ones so far run out.
+  std::vector<VkDescriptorPool> desc_pools_;
   VkCommandPool cmd_pool_;
   VkQueue queue_;
   VkBuffer vert_buffer_;
 
+  Frame frames_[kFramesInFlight];
+  uint32_t frame_index_ = 0;
+  Frame *last_frame_ = NULL;
+  // Tracks completion of the frames if VK_KHR_timeline_semaphore is
+  // supported.
+  VkSemaphore timeline_semaphore_ = VK_NULL_HANDLE;
+  uint64_t timeline_value_ = 0;
+#ifdef VK_KHR_timeline_semaphore
+  PFN_vkWaitSemaphoresKHR wait_semaphores_ = NULL;
+#endif
+  bool disable_explicit_sync_ = false;
+
+  // Scratch space of Draw, kept to avoid allocations.
+  std::vector<VkDescriptorSet> draw_desc_sets_;
+  std::vector<VkDescriptorBufferInfo> ub_infos_;
+  std::vector<VkWriteDescriptorSet> write_desc_sets_;
+  std::vector<VkImageMemoryBarrier> barriers_;
+
   std::vector<std::unique_ptr<VKProgram>> programs_;
 };
 
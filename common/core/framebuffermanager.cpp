@@ -16,26 +16,43 @@
 
 #include "framebuffermanager.h"
 
+#include <hwcutils.h>
+
 #include "platformcommondefines.h"
 
 namespace hwcomposer {
 
+FrameBufferManager::FBShard &FrameBufferManager::LockShard(const FBKey &key) {
+  // Use the high bits for shard selection, low bits pick the bucket inside
+  // the shard's map.
+  size_t hash = FBHash()(key);
+  FBShard &shard = shards_[(hash >> 16) % kFBShards];
+  if (!shard.lock_.try_lock()) {
+    uint64_t start = GetMonotonicTimeNs();
+    shard.lock_.lock();
+    contended_locks_++;
+    contention_ns_ += GetMonotonicTimeNs() - start;
+  }
+
+  return shard;
+}
+
 void FrameBufferManager::RegisterGemHandles(const uint32_t &num_planes,
                                             const uint32_t (&igem_handles)[4]) {
-  lock_.lock();
   FBKey key(num_planes, igem_handles);
-  auto it = fb_map_.find(key);
-  if (it != fb_map_.end()) {
+  FBShard &shard = LockShard(key);
+  auto it = shard.fb_map_.find(key);
+  if (it != shard.fb_map_.end()) {
     it->second.fb_ref++;
   } else {
     FBValue value;
     value.fb_ref = 1;
     value.fb_id = 0;
     value.fb_created = false;
-    fb_map_.emplace(std::make_pair(key, value));
+    shard.fb_map_.emplace(std::make_pair(key, value));
   }
 
-  lock_.unlock();
+  shard.lock_.unlock();
 }
 
 uint32_t FrameBufferManager::FindFB(
@@ -43,13 +60,15 @@ uint32_t FrameBufferManager::FindFB(
     const uint32_t &iframe_buffer_format, const uint32_t &num_planes,
     const uint32_t (&igem_handles)[4], const uint32_t (&ipitches)[4],
     const uint32_t (&ioffsets)[4]) {
-  lock_.lock();
   FBKey key(num_planes, igem_handles);
+  FBShard &shard = LockShard(key);
+  lookups_++;
   uint32_t fb_id = 0;
-  auto it = fb_map_.find(key);
-  if (it != fb_map_.end()) {
+  auto it = shard.fb_map_.find(key);
+  if (it != shard.fb_map_.end()) {
     if (!it->second.fb_created) {
       it->second.fb_created = true;
+      creations_++;
       CreateFrameBuffer(iwidth, iheight, modifier, iframe_buffer_format,
                         num_planes, igem_handles, ipitches, ioffsets, gpu_fd_,
                         &it->second.fb_id);
@@ -57,51 +76,60 @@ uint32_t FrameBufferManager::FindFB(
 
     fb_id = it->second.fb_id;
   } else {
+    lookup_misses_++;
     ITRACE("Handle not found in Cache \n");
   }
 
-  lock_.unlock();
+  shard.lock_.unlock();
   return fb_id;
 }
 
 int FrameBufferManager::RemoveFB(uint32_t num_planes,
                                  const uint32_t (&igem_handles)[4]) {
-  lock_.lock();
-
   int ret = 0;
   FBKey key(num_planes, igem_handles);
+  FBShard &shard = LockShard(key);
 
-  auto it = fb_map_.find(key);
-  if (it != fb_map_.end()) {
+  auto it = shard.fb_map_.find(key);
+  if (it != shard.fb_map_.end()) {
     it->second.fb_ref -= 1;
     if (it->second.fb_ref == 0) {
       ret = ReleaseFrameBuffer(it->first, it->second.fb_id, gpu_fd_);
-      fb_map_.erase(it);
+      shard.fb_map_.erase(it);
+      removals_++;
     }
+  } else if (igem_handles[0] != 0 || igem_handles[1] != 0 ||
+             igem_handles[2] != 0 || igem_handles[3] != 0) {
+    ITRACE("Unable to find fb in cache. %d %d %d %d \n", igem_handles[0],
+           igem_handles[1], igem_handles[2], igem_handles[3]);
   }
 
-  if (it == fb_map_.end()) {
-    if (igem_handles[0] != 0 || igem_handles[1] != 0 || igem_handles[2] != 0 ||
-        igem_handles[3] != 0) {
-      ITRACE("Unable to find fb in cache. %d %d %d %d \n", igem_handles[0],
-             igem_handles[1], igem_handles[2], igem_handles[3]);
-    }
-  }
-
-  lock_.unlock();
+  shard.lock_.unlock();
 
   return ret;
 }
 
+FrameBufferManager::Stats FrameBufferManager::GetStats() const {
+  Stats stats;
+  stats.lookups = lookups_;
+  stats.lookup_misses = lookup_misses_;
+  stats.creations = creations_;
+  stats.removals = removals_;
+  stats.contended_locks = contended_locks_;
+  stats.contention_ns = contention_ns_;
+  return stats;
+}
+
 void FrameBufferManager::PurgeAllFBs() {
-  lock_.lock();
-  auto it = fb_map_.begin();
+  for (uint32_t i = 0; i < kFBShards; i++) {
+    FBShard &shard = shards_[i];
+    ScopedSpinLock lock(shard.lock_);
+    for (auto it = shard.fb_map_.begin(); it != shard.fb_map_.end(); ++it) {
+      ReleaseFrameBuffer(it->first, it->second.fb_id, gpu_fd_);
+    }
 
-  while (it != fb_map_.end()) {
-    ReleaseFrameBuffer(it->first, it->second.fb_id, gpu_fd_);
+    shard.fb_map_.clear();
   }
-
-  lock_.unlock();
 }
 
 }  // namespace hwcomposer
@@ -22,6 +22,7 @@
 #include <hwctrace.h>
 #include <platformdefines.h>
 
+#include <atomic>
 #include <memory>
 #include <unordered_map>
 
@@ -41,7 +42,14 @@ typedef struct {
 
 struct FBHash {
   size_t operator()(FBKey const &key) const {
-    return key.gem_handles_[0];
+    // Planes of multi-planar buffers often share the same gem handle,
+    // include all of them and the plane count to spread such buffers.
+    size_t seed = key.num_planes_;
+    for (uint32_t i = 0; i < 4; i++) {
+      hash_combine_hwc(seed, key.gem_handles_[i]);
+    }
+
+    return seed;
   }
 };
 
@@ -57,6 +65,17 @@ struct FBEqual {
 
 class FrameBufferManager {
  public:
+  struct Stats {
+    uint64_t lookups = 0;
+    uint64_t lookup_misses = 0;
+    // Number of frame buffers created with drmModeAddFB2.
+    uint64_t creations = 0;
+    uint64_t removals = 0;
+    // Lock acquisitions which had to wait and the total time spent waiting.
+    uint64_t contended_locks = 0;
+    uint64_t contention_ns = 0;
+  };
+
   FrameBufferManager(uint32_t gpu_fd) : gpu_fd_(gpu_fd) {
   }
   ~FrameBufferManager() {
@@ -103,15 +122,42 @@ class FrameBufferManager {
   */
   int RemoveFB(uint32_t num_planes, const uint32_t (&igem_handles)[4]);
 
+  /**
+  * Returns counters collected since the manager was created.
+  */
+  Stats GetStats() const;
+
  private:
-  SpinLock lock_;
+  // Number of independently locked parts of the cache. Buffers of
+  // different displays mostly hash to different shards, so they don't
+  // contend on a single lock.
+  static const uint32_t kFBShards = 8;
+
+  typedef std::unordered_map<FBKey, FBValue, FBHash, FBEqual> FBMap;
+
+  struct FBShard {
+    SpinLock lock_;
+    FBMap fb_map_;
+  };
+
+  /**
+  * Returns the shard owning key and takes its lock.
+  */
+  FBShard &LockShard(const FBKey &key);
+
   /**
-  * Release and remove all framebuffers in the hash fb_map_
+  * Release and remove all framebuffers in all shards.
   */
   void PurgeAllFBs();
 
-  std::unordered_map<FBKey, FBValue, FBHash, FBEqual> fb_map_;
+  FBShard shards_[kFBShards];
   uint32_t gpu_fd_ = 0;
+  std::atomic<uint64_t> lookups_{0};
+  std::atomic<uint64_t> lookup_misses_{0};
+  std::atomic<uint64_t> creations_{0};
+  std::atomic<uint64_t> removals_{0};
+  std::atomic<uint64_t> contended_locks_{0};
+  std::atomic<uint64_t> contention_ns_{0};
 };
 
 }  // namespace hwcomposer
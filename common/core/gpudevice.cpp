@@ -191,6 +191,37 @@ std::vector<uint32_t> GpuDevice::GetDisplayReservedPlanes(uint32_t display_id) {
     return pos->second;
 }
 
+const std::vector<uint32_t> &GpuDevice::GetCompositorWarmUpLayers() const {
+  return compositor_warmup_layers_;
+}
+
+bool GpuDevice::IsAsyncCompositionEnabled() const {
+  return async_composition_;
+}
+
+uint32_t GpuDevice::GetCommitLatchMarginUs() const {
+  return commit_latch_margin_us_;
+}
+
+bool GpuDevice::IsSoftwareCompositorReferenceEnabled() const {
+  return software_compositor_reference_;
+}
+
+void GpuDevice::ParseCompositorWarmUpSettings(std::string &value) {
+  std::string layer_count_str;
+  std::istringstream i_value(value);
+  compositor_warmup_layers_.clear();
+  while (std::getline(i_value, layer_count_str, '+')) {
+    if (layer_count_str.empty() ||
+        layer_count_str.find_first_not_of("0123456789") != std::string::npos)
+      continue;
+    uint32_t layer_count = atoi(layer_count_str.c_str());
+    if (layer_count == 0)
+      continue;
+    compositor_warmup_layers_.emplace_back(layer_count);
+  }
+}
+
 void GpuDevice::ParsePlaneReserveSettings(std::string &value) {
   std::string display_line_str;
   std::string reserved_plane_index_str;
@@ -861,6 +892,10 @@ void GpuDevice::HandleHWCSettings() {
 #endif
 
   std::string key_reserved_drm_plane("DRM_PLANE_RESERVED");
+  std::string key_compositor_warmup("COMPOSITOR_WARMUP_LAYERS");
+  std::string key_async_composition("ASYNC_COMPOSITION");
+  std::string key_commit_latch_margin("COMMIT_LATCH_MARGIN_US");
+  std::string key_software_reference("SOFTWARE_COMPOSITOR_REFERENCE");
 
   while (std::getline(fin, cfg_line)) {
     std::istringstream i_line(cfg_line);
@@ -945,6 +980,23 @@ void GpuDevice::HandleHWCSettings() {
           // Got plan reserve config
         } else if (!key.compare(key_reserved_drm_plane)) {
           ParsePlaneReserveSettings(value);
+          // Got compositor warm up layer counts
+        } else if (!key.compare(key_compositor_warmup)) {
+          ParseCompositorWarmUpSettings(value);
+          // Got async composition switch
+        } else if (!key.compare(key_async_composition)) {
+          if (!value.compare(enable_str)) {
+            async_composition_ = true;
+          }
+          // Got commit latch margin
+        } else if (!key.compare(key_commit_latch_margin)) {
+          commit_latch_margin_us_ =
+              static_cast<uint32_t>(atoi(value.c_str()));
+          // Got software compositor reference switch
+        } else if (!key.compare(key_software_reference)) {
+          if (!value.compare(enable_str)) {
+            software_compositor_reference_ = true;
+          }
         }
       }
     }
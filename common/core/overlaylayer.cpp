@@ -93,9 +93,7 @@ void OverlayLayer::SetBuffer(HWCNativeHandle handle, int32_t acquire_fence,
   uint32_t id;
 
   if (resource_manager && register_buffer) {
-    uint32_t gpu_fd = resource_manager->GetNativeBufferHandler()->GetFd();
-    id = GetNativeBuffer(gpu_fd, handle);
-    buffer = resource_manager->FindCachedBuffer(id);
+    buffer = resource_manager->FindCachedBuffer(handle, &id);
   }
 
   if (buffer == NULL) {
@@ -16,6 +16,8 @@
 
 #include "resourcemanager.h"
 
+#include "nativebufferhandler.h"
+
 namespace hwcomposer {
 
 ResourceManager::ResourceManager(NativeBufferHandler* buffer_handler)
@@ -82,6 +84,22 @@ std::shared_ptr<OverlayBuffer>& ResourceManager::FindCachedBuffer(
   return pBufNull;
 }
 
+std::shared_ptr<OverlayBuffer>& ResourceManager::FindCachedBuffer(
+    HWCNativeHandle handle, uint32_t* native_buffer) {
+  buffer_id_stats_.lookups++;
+  if (GetCachedNativeBuffer(handle, native_buffer)) {
+    // GEM handle might have been closed and re-used since, trust it only
+    // if it still maps to a buffer imported from this handle.
+    std::shared_ptr<OverlayBuffer>& buffer = FindCachedBuffer(*native_buffer);
+    if (buffer && buffer->GetOriginalHandle() == handle)
+      return buffer;
+  }
+
+  buffer_id_stats_.prime_fd_lookups++;
+  *native_buffer = GetNativeBuffer(buffer_handler_->GetFd(), handle);
+  return FindCachedBuffer(*native_buffer);
+}
+
 void ResourceManager::RegisterBuffer(const uint32_t& native_buffer,
                                      std::shared_ptr<OverlayBuffer>& pBuffer) {
   BUFFER_MAP& first_map = cached_buffers_[0];
@@ -60,8 +60,18 @@ class ResourceManager {
   ResourceManager(NativeBufferHandler* buffer_handler);
   ~ResourceManager();
   void Dump();
+  struct BufferIdStats {
+    uint64_t lookups = 0;
+    // Lookups which needed a drmPrimeFDToHandle call.
+    uint64_t prime_fd_lookups = 0;
+  };
+
   std::shared_ptr<OverlayBuffer>& FindCachedBuffer(
       const uint32_t& native_buffer);
+  // Looks up handle, re-using its GEM handle from an earlier frame when
+  // possible. native_buffer is set to the id to pass to RegisterBuffer.
+  std::shared_ptr<OverlayBuffer>& FindCachedBuffer(HWCNativeHandle handle,
+                                                   uint32_t* native_buffer);
   void RegisterBuffer(const uint32_t& native_buffer,
                       std::shared_ptr<OverlayBuffer>& pBuffer);
   void MarkResourceForDeletion(const ResourceHandle& handle,
@@ -83,6 +93,10 @@ class ResourceManager {
     return buffer_handler_;
   }
 
+  const BufferIdStats& GetBufferIdStats() const {
+    return buffer_id_stats_;
+  }
+
  private:
 #define BUFFER_CACHE_LENGTH 4
   typedef std::unordered_map<uint32_t, std::shared_ptr<OverlayBuffer>>
@@ -104,6 +118,9 @@ class ResourceManager {
   // This can be used from any thread.
   std::vector<MediaResourceHandle> destroy_media_resources_;
   NativeBufferHandler* buffer_handler_;
+  // This should be used in same thread handling
+  // Present in NativeDisplay.
+  BufferIdStats buffer_id_stats_;
   SpinLock lock_;
 #ifdef RESOURCE_CACHE_TRACING
   uint32_t hit_count_;
@@ -0,0 +1,71 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "commitscheduler.h"
+
+#include <errno.h>
+#include <time.h>
+
+#include <hwcutils.h>
+
+#include "hwctrace.h"
+#include "vblankeventhandler.h"
+
+namespace hwcomposer {
+
+static const int64_t kOneSecondNs = 1 * 1000 * 1000 * 1000;
+
+void CommitScheduler::SetLatchMargin(uint32_t margin_us) {
+  margin_ns_ = static_cast<int64_t>(margin_us) * 1000;
+  last_target_vblank_ = -1;
+}
+
+void CommitScheduler::WaitForLatchPoint(VblankEventHandler* vblank_handler) {
+  if (!IsEnabled())
+    return;
+
+  int64_t now = GetMonotonicTimeNs();
+  int64_t vblank;
+  int64_t period;
+  if (!vblank_handler->PredictVblank(now, &vblank, &period))
+    return;
+
+  stats_.frames++;
+  // Previous frame has been committed for this vblank already. Allow for
+  // some jitter between predicted and real vblank timestamps.
+  if (last_target_vblank_ > 0 && vblank <= last_target_vblank_ + period / 2)
+    vblank = last_target_vblank_ + period;
+
+  last_target_vblank_ = vblank;
+  int64_t latch_point = vblank - margin_ns_;
+  if (latch_point <= now) {
+    stats_.missed_latch_points++;
+    return;
+  }
+
+  struct timespec deadline;
+  deadline.tv_sec = latch_point / kOneSecondNs;
+  deadline.tv_nsec = latch_point % kOneSecondNs;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) ==
+         EINTR) {
+  }
+
+  stats_.total_wait_ns += latch_point - now;
+  IDISPLAYMANAGERTRACE("Held commit for %lld ns",
+                       static_cast<long long>(latch_point - now));
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,70 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_COMMITSCHEDULER_H_
+#define COMMON_DISPLAY_COMMITSCHEDULER_H_
+
+#include <stdint.h>
+
+namespace hwcomposer {
+
+class VblankEventHandler;
+
+// Holds the atomic commit of a frame till a configurable margin before the
+// vblank it is going to be latched at. Each vblank is targeted by at most
+// one frame, a frame presented while the next vblank is already taken
+// waits for the latch point of the following one instead of queueing
+// behind the previous commit in the kernel.
+class CommitScheduler {
+ public:
+  struct Stats {
+    uint64_t frames = 0;
+    // Frames which were ready only after the latch point of the vblank
+    // they were targeting.
+    uint64_t missed_latch_points = 0;
+    uint64_t total_wait_ns = 0;
+  };
+
+  CommitScheduler() = default;
+
+  // 0 disables scheduling, commits are issued as soon as frames are ready.
+  void SetLatchMargin(uint32_t margin_us);
+
+  bool IsEnabled() const {
+    return margin_ns_ > 0;
+  }
+
+  // Blocks till the latch point of the vblank the frame being committed is
+  // targeting. Returns immediately if no vblank can be predicted.
+  void WaitForLatchPoint(VblankEventHandler* vblank_handler);
+
+  // Forgets about the last targeted vblank, i.e. after a failed commit.
+  void Reset() {
+    last_target_vblank_ = -1;
+  }
+
+  const Stats& GetStats() const {
+    return stats_;
+  }
+
+ private:
+  int64_t margin_ns_ = 0;
+  int64_t last_target_vblank_ = -1;
+  Stats stats_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_COMMITSCHEDULER_H_
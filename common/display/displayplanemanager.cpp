@@ -29,6 +29,11 @@
 
 namespace hwcomposer {
 
+// Number of frames a plane and layer combination which failed a commit
+// isn't used, see DisplayPlaneManager::IsolateCommitFailure.
+static const uint32_t kBlacklistFrames = 120;
+static const uint32_t kMaxBlacklistFrames = 16 * kBlacklistFrames;
+
 DisplayPlaneManager::DisplayPlaneManager(DisplayPlaneHandler *plane_handler,
                                          ResourceManager *resource_manager)
     : plane_handler_(plane_handler),
@@ -97,7 +102,7 @@ bool DisplayPlaneManager::ValidateLayers(
         MarkSurfacesForRecycling(&plane, mark_later, true);
       }
 
-      DisplayPlaneStateList().swap(composition);
+      composition.clear();
     }
 
     if (add_index <= 0) {
@@ -105,7 +110,9 @@ bool DisplayPlaneManager::ValidateLayers(
     }
   }
 
-  std::vector<OverlayPlane> commit_planes;
+  // Re-use storage of the previous frame.
+  std::vector<OverlayPlane> &commit_planes = commit_planes_;
+  commit_planes.clear();
 
   for (DisplayPlaneState &temp : composition) {
     commit_planes.emplace_back(
@@ -358,11 +365,18 @@ bool DisplayPlaneManager::ValidateLayers(
           continue;
         }
         DisplayPlaneState &squashed_plane = composition.back();
-        // In this case we need to fallback to 3Dcomposition till Media
-        // backend adds support for multiple layers.
+        // Surfaces of a video plane with a single layer use a media
+        // format. Re-allocate them once other layers have been added, in
+        // 3D format if Media backend can't blend the layers together.
         bool force_buffer = false;
+        NativeSurface *target = squashed_plane.GetOffScreenTarget();
+        OverlayBuffer *target_buffer =
+            target ? target->GetLayer()->GetBuffer() : NULL;
         if (is_video && squashed_plane.GetSourceLayers().size() > 1 &&
-            squashed_plane.GetOffScreenTarget()) {
+            target &&
+            (!squashed_plane.IsVideoPlane() || !target_buffer ||
+             target_buffer->GetFormat() !=
+                 squashed_plane.GetDisplayPlane()->GetPreferredFormat())) {
           MarkSurfacesForRecycling(&squashed_plane, mark_later, true);
           force_buffer = true;
         }
@@ -515,7 +529,7 @@ void DisplayPlaneManager::ValidateCursorLayer(
 
       if (reset_overlay) {
         // Layer for the plane should have changed, reset commit planes.
-        std::vector<OverlayPlane>().swap(commit_planes);
+        commit_planes.clear();
         for (DisplayPlaneState &temp : composition) {
           commit_planes.emplace_back(
               OverlayPlane(temp.GetDisplayPlane(), temp.GetOverlayLayer()));
@@ -762,6 +776,10 @@ void DisplayPlaneManager::EnsureOffScreenTarget(DisplayPlaneState &plane) {
   uint64_t modifier = plane.GetDisplayPlane()->GetPreferredFormatModifier();
   if (plane.IsVideoPlane())
     modifier = 0;
+#ifdef USE_SW
+  // Software renderer writes linear buffers only.
+  modifier = 0;
+#endif
   for (auto &fb : surfaces_) {
     if (fb->GetSurfaceAge() == -1) {
       OverlayBuffer *layer_buffer = fb->GetLayer()->GetBuffer();
@@ -850,10 +868,21 @@ bool DisplayPlaneManager::FallbacktoGPU(
   if (!layer_buffer)
     return true;
 
+  // No need to ask the kernel about modifiers the plane doesn't list.
+  uint64_t modifier = layer_buffer->GetModifier();
+  if (modifier &&
+      !target_plane->IsSupportedModifier(modifier, layer_buffer->GetFormat()))
+    return true;
+
   if (layer_buffer->GetFb() == 0) {
     return true;
   }
 
+  // Kernel accepted a test commit of this combination earlier, but failed
+  // the real one.
+  if (IsBlacklisted(target_plane, layer))
+    return true;
+
   // TODO(kalyank): Take relevant factors into consideration to determine if
   // Plane Composition makes sense. i.e. layer size etc
   if (!plane_handler_->TestCommit(commit_planes)) {
@@ -864,6 +893,119 @@ bool DisplayPlaneManager::FallbacktoGPU(
   return false;
 }
 
+bool DisplayPlaneManager::IsolateCommitFailure(
+    const DisplayPlaneStateList &composition) {
+  std::vector<OverlayPlane> commit_planes;
+  commit_planes.reserve(composition.size());
+  for (const DisplayPlaneState &plane : composition) {
+    commit_planes.emplace_back(
+        OverlayPlane(plane.GetDisplayPlane(), plane.GetOverlayLayer()));
+  }
+
+  // Nothing to bisect if a TEST_ONLY commit can't reproduce the failure.
+  if (commit_planes.empty() || plane_handler_->TestCommit(commit_planes))
+    return false;
+
+  // Find the shortest prefix of the planes which fails. Planes outside of
+  // the prefix keep their current state in the test commits.
+  size_t good = 0;
+  size_t bad = commit_planes.size();
+  std::vector<OverlayPlane> test_planes;
+  test_planes.reserve(bad);
+  while (bad - good > 1) {
+    size_t mid = good + (bad - good) / 2;
+    test_planes.assign(commit_planes.begin(), commit_planes.begin() + mid);
+    if (plane_handler_->TestCommit(test_planes)) {
+      good = mid;
+    } else {
+      bad = mid;
+    }
+  }
+
+  const DisplayPlaneState &failed_plane = composition.at(bad - 1);
+  // Offscreen targets are composited by GPU already.
+  if (!failed_plane.Scanout()) {
+    ITRACE("Commit failure caused by offscreen target of plane %d.",
+           failed_plane.GetDisplayPlane()->id());
+    return false;
+  }
+
+  Blacklist(failed_plane.GetDisplayPlane(), failed_plane.GetOverlayLayer());
+  return true;
+}
+
+void DisplayPlaneManager::AgeBlacklist() {
+  for (auto it = blacklist_.begin(); it != blacklist_.end();) {
+    if (it->blocked_frames > 0) {
+      it->blocked_frames--;
+    } else if (it->remembered_frames > 0) {
+      it->remembered_frames--;
+    }
+
+    if (!it->blocked_frames && !it->remembered_frames) {
+      it = blacklist_.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+bool DisplayPlaneManager::BlacklistEntry::Matches(
+    const DisplayPlane *target_plane, const OverlayLayer *layer) const {
+  const OverlayBuffer *buffer = layer->GetBuffer();
+  return plane == target_plane && buffer &&
+         modifier == buffer->GetModifier() && format == buffer->GetFormat() &&
+         source_width == layer->GetSourceCropWidth() &&
+         source_height == layer->GetSourceCropHeight() &&
+         display_width == layer->GetDisplayFrameWidth() &&
+         display_height == layer->GetDisplayFrameHeight();
+}
+
+bool DisplayPlaneManager::IsBlacklisted(const DisplayPlane *plane,
+                                        const OverlayLayer *layer) const {
+  for (const BlacklistEntry &entry : blacklist_) {
+    if (entry.blocked_frames && entry.Matches(plane, layer))
+      return true;
+  }
+
+  return false;
+}
+
+void DisplayPlaneManager::Blacklist(const DisplayPlane *plane,
+                                    const OverlayLayer *layer) {
+  const OverlayBuffer *buffer = layer->GetBuffer();
+  if (!buffer)
+    return;
+
+  BlacklistEntry *entry = NULL;
+  for (BlacklistEntry &temp : blacklist_) {
+    if (temp.Matches(plane, layer)) {
+      entry = &temp;
+      break;
+    }
+  }
+
+  if (entry) {
+    entry->period = std::min(entry->period * 2, kMaxBlacklistFrames);
+  } else {
+    blacklist_.emplace_back();
+    entry = &blacklist_.back();
+    entry->plane = plane;
+    entry->modifier = buffer->GetModifier();
+    entry->format = buffer->GetFormat();
+    entry->source_width = layer->GetSourceCropWidth();
+    entry->source_height = layer->GetSourceCropHeight();
+    entry->display_width = layer->GetDisplayFrameWidth();
+    entry->display_height = layer->GetDisplayFrameHeight();
+    entry->period = kBlacklistFrames;
+  }
+
+  entry->blocked_frames = entry->period;
+  entry->remembered_frames = entry->period;
+  ETRACE("Commit failed with layer on plane %d, using GPU for %d frames.",
+         plane->id(), entry->period);
+}
+
 bool DisplayPlaneManager::CheckPlaneFormat(uint32_t format) {
   return overlay_planes_.at(0)->IsSupportedFormat(format);
 }
@@ -880,8 +1022,8 @@ void DisplayPlaneManager::ForceVppForAllLayers(
     for (DisplayPlaneState &plane : composition) {
       MarkSurfacesForRecycling(&plane, mark_later, recycle_resources);
     }
-    DisplayPlaneStateList().swap(composition);
-    std::vector<OverlayPlane>().swap(commit_planes);
+    composition.clear();
+    commit_planes.clear();
     auto overlay_begin = overlay_planes_.begin();
     // Let's mark all planes as free to be used.
     for (auto j = overlay_begin; j < overlay_planes_.end(); ++j) {
@@ -939,8 +1081,8 @@ void DisplayPlaneManager::ForceGpuForAllLayers(
 
   auto layer_begin = layers.begin();
   auto layer_end = layers.end();
-  DisplayPlaneStateList().swap(composition);
-  std::vector<OverlayPlane>().swap(commit_planes);
+  composition.clear();
+  commit_planes.clear();
   OverlayLayer *primary_layer = &(*(layers.begin()));
   DisplayPlane *current_plane = overlay_planes_.at(0).get();
 
@@ -1020,7 +1162,8 @@ bool DisplayPlaneManager::ReValidatePlanes(
   *request_full_validation = false;
   bool render = false;
   bool reset_composition_region = false;
-  std::vector<OverlayPlane> commit_planes;
+  std::vector<OverlayPlane> &commit_planes = commit_planes_;
+  commit_planes.clear();
   for (DisplayPlaneState &temp : composition) {
     commit_planes.emplace_back(
         OverlayPlane(temp.GetDisplayPlane(), temp.GetOverlayLayer()));
@@ -1235,7 +1378,7 @@ size_t DisplayPlaneManager::SquashNonVideoPlanes(
 
   if (!commit_planes.empty() && squashed_count) {
     // Layer for the plane should have changed, reset commit planes.
-    std::vector<OverlayPlane>().swap(commit_planes);
+    commit_planes.clear();
     for (DisplayPlaneState &temp : composition) {
       commit_planes.emplace_back(
           OverlayPlane(temp.GetDisplayPlane(), temp.GetOverlayLayer()));
@@ -1306,7 +1449,7 @@ bool DisplayPlaneManager::SquashPlanesAsNeeded(
 
         if (!commit_planes.empty()) {
           // Layer for the plane should have changed, reset commit planes.
-          std::vector<OverlayPlane>().swap(commit_planes);
+          commit_planes.clear();
           for (DisplayPlaneState &temp : composition) {
             commit_planes.emplace_back(
                 OverlayPlane(temp.GetDisplayPlane(), temp.GetOverlayLayer()));
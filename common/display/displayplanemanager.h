@@ -68,6 +68,11 @@ class DisplayPlaneManager {
                         bool needs_revalidation_checks,
                         bool re_validate_commit);
 
+  // Capacity of the storage re-used by ValidateLayers and ReValidatePlanes.
+  size_t GetCommitPlanesCapacity() const {
+    return commit_planes_.capacity();
+  }
+
   bool CheckPlaneFormat(uint32_t format);
 
   void SetOffScreenPlaneTarget(DisplayPlaneState &plane);
@@ -124,7 +129,42 @@ class DisplayPlaneManager {
 
   void ResetPlanes(drmModeAtomicReqPtr pset);
 
+  // Called after the kernel rejected a commit of composition. Bisects the
+  // planes of composition with TEST_ONLY commits to find the first one
+  // which makes the commit fail and keeps layers like the one it scanned
+  // out off that plane for a while. Returns false if the failure couldn't
+  // be pinned down to a layer scanned out directly.
+  bool IsolateCommitFailure(const DisplayPlaneStateList &composition);
+
+  // Should be called once per presented frame, combinations blacklisted by
+  // IsolateCommitFailure are tried again after a number of frames.
+  void AgeBlacklist();
+
  private:
+  // Properties of a plane and layer combination which failed a commit.
+  // blocked_frames is the number of frames the combination isn't used
+  // anymore, it is remembered for another period frames afterwards and
+  // period is doubled if it fails again during that time.
+  struct BlacklistEntry {
+    const DisplayPlane *plane;
+    uint64_t modifier;
+    uint32_t format;
+    uint32_t source_width;
+    uint32_t source_height;
+    uint32_t display_width;
+    uint32_t display_height;
+    uint32_t period;
+    uint32_t blocked_frames;
+    uint32_t remembered_frames;
+
+    bool Matches(const DisplayPlane *target_plane,
+                 const OverlayLayer *layer) const;
+  };
+
+  bool IsBlacklisted(const DisplayPlane *plane,
+                     const OverlayLayer *layer) const;
+  void Blacklist(const DisplayPlane *plane, const OverlayLayer *layer);
+
   DisplayPlaneState *GetLastUsedOverlay(DisplayPlaneStateList &composition);
   bool FallbacktoGPU(DisplayPlane *target_plane, OverlayLayer *layer,
                      const std::vector<OverlayPlane> &commit_planes) const;
@@ -193,6 +233,8 @@ class DisplayPlaneManager {
   DisplayPlane *cursor_plane_;
   std::vector<std::unique_ptr<NativeSurface>> surfaces_;
   std::vector<std::unique_ptr<DisplayPlane>> overlay_planes_;
+  std::vector<OverlayPlane> commit_planes_;
+  std::vector<BlacklistEntry> blacklist_;
 
   uint32_t width_;
   uint32_t height_;
@@ -85,6 +85,10 @@ const HwcRect<float> &DisplayPlaneState::GetSourceCrop() const {
 
 void DisplayPlaneState::AddLayer(const OverlayLayer *layer) {
   const HwcRect<int> &display_frame = layer->GetDisplayFrame();
+#ifdef VA_WITH_VPP
+  bool inside_plane =
+      IsEnclosedBy(display_frame, private_data_->display_frame_);
+#endif
   HwcRect<int> target_display_frame = private_data_->display_frame_;
   CalculateRect(display_frame, target_display_frame);
   HwcRect<float> target_source_crop = private_data_->source_crop_;
@@ -120,11 +124,23 @@ void DisplayPlaneState::AddLayer(const OverlayLayer *layer) {
   if (!private_data_->has_cursor_layer_)
     private_data_->has_cursor_layer_ = layer->IsCursorLayer();
 
-  // TODO: Add checks for Video type once our
-  // Media backend can support compositing more
-  // than one layer together.
-  private_data_->type_ = DisplayPlanePrivateState::PlaneType::kNormal;
-  private_data_->apply_effects_ = false;
+#ifdef VA_WITH_VPP
+  // Media backend blends all layers of the plane in one pass, i.e. video
+  // with subtitles on top. Solid color and cursor layers still need 3D, as
+  // do layers with coverage blending which VA can't express. Layers must
+  // stay inside the video layer, VPP doesn't write the parts of the target
+  // not covered by any layer.
+  bool keep_video =
+      private_data_->type_ == DisplayPlanePrivateState::PlaneType::kVideo &&
+      inside_plane && !layer->IsSolidColor() && !layer->IsCursorLayer() &&
+      layer->GetBlending() != HWCBlending::kBlendingCoverage;
+#else
+  bool keep_video = false;
+#endif
+  if (!keep_video) {
+    private_data_->type_ = DisplayPlanePrivateState::PlaneType::kNormal;
+    private_data_->apply_effects_ = false;
+  }
 
   // Reset Validation state.
   if (re_validate_layer_ & ReValidationType::kScanout)
@@ -146,6 +162,11 @@ void DisplayPlaneState::ResetLayers(const std::vector<OverlayLayer> &layers,
   HwcRect<int> target_display_frame;
   HwcRect<float> target_source_crop;
   bool has_video = false;
+#ifdef VA_WITH_VPP
+  // Whether the media backend can blend the layers, see AddLayer.
+  bool media_blending = true;
+  HwcRect<int> video_frame;
+#endif
   bool layer_removed = false;
   for (const size_t &index : current_layers) {
     if (index >= remove_index) {
@@ -162,8 +183,18 @@ void DisplayPlaneState::ResetLayers(const std::vector<OverlayLayer> &layers,
       private_data_->has_cursor_layer_ = true;
     } else if (!has_video) {
       has_video = layer.IsVideoLayer();
+#ifdef VA_WITH_VPP
+      if (has_video)
+        video_frame = layer.GetDisplayFrame();
+#endif
     }
 
+#ifdef VA_WITH_VPP
+    if (is_cursor || layer.IsSolidColor() ||
+        layer.GetBlending() == HWCBlending::kBlendingCoverage)
+      media_blending = false;
+#endif
+
     const HwcRect<int> &df = layer.GetDisplayFrame();
     const HwcRect<float> &source_crop = layer.GetSourceCrop();
     CalculateRect(df, target_display_frame);
@@ -204,6 +235,16 @@ void DisplayPlaneState::ResetLayers(const std::vector<OverlayLayer> &layers,
 
   *rects_updated = rect_updated;
 
+#ifdef VA_WITH_VPP
+  // All layers must be inside the video layer.
+  if (has_video && new_layers.size() > 1 &&
+      (!media_blending || !(target_display_frame == video_frame))) {
+    has_video = false;
+    private_data_->type_ = DisplayPlanePrivateState::PlaneType::kNormal;
+    private_data_->apply_effects_ = false;
+  }
+#endif
+
   if (has_video)
     private_data_->type_ = DisplayPlanePrivateState::PlaneType::kVideo;
 
@@ -465,10 +506,16 @@ std::vector<CompositionRegion> &DisplayPlaneState::GetCompositionRegion() {
   return private_data_->composition_region_;
 }
 
+RenderStateCache &DisplayPlaneState::GetRenderStateCache() {
+  return private_data_->render_state_cache_;
+}
+
 void DisplayPlaneState::ResetCompositionRegion() {
   if (!private_data_->composition_region_.empty())
     std::vector<CompositionRegion>().swap(private_data_->composition_region_);
 
+  private_data_->render_state_cache_.states_.clear();
+
   recycled_surface_ = false;
 }
 
@@ -24,6 +24,7 @@
 #include "displayplane.h"
 #include "nativesurface.h"
 #include "overlaylayer.h"
+#include "renderstate.h"
 
 namespace hwcomposer {
 
@@ -123,7 +124,10 @@ class DisplayPlaneState {
   // Returns composition region used by this plane.
   std::vector<CompositionRegion> &GetCompositionRegion();
 
-  // Resets composition region to null.
+  // Returns RenderStates calculated for the composition region.
+  RenderStateCache &GetRenderStateCache();
+
+  // Resets composition region and its RenderStates to null.
   void ResetCompositionRegion();
 
   bool IsCursorPlane() const;
@@ -260,6 +264,7 @@ class DisplayPlaneState {
     HwcRect<float> source_crop_;
     std::vector<size_t> source_layers_;
     std::vector<CompositionRegion> composition_region_;
+    RenderStateCache render_state_cache_;
 
     bool use_plane_scalar_ = false;
     // Even if layer can be scanned out
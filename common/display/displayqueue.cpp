@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "displayplanemanager.h"
+#include "gpudevice.h"
 #include "hwctrace.h"
 #include "hwcutils.h"
 #include "nativesurface.h"
@@ -68,6 +69,8 @@ DisplayQueue::DisplayQueue(uint32_t gpu_fd, bool disable_explictsync,
 }
 
 DisplayQueue::~DisplayQueue() {
+  // Make sure no vblank callback runs while we are being destroyed.
+  vblank_handler_->SetPowerMode(kOff);
 }
 
 bool DisplayQueue::Initialize(uint32_t pipe, uint32_t width, uint32_t height,
@@ -110,6 +113,10 @@ bool DisplayQueue::SetPowerMode(uint32_t power_mode) {
       power_mode_lock_.lock();
       state_ &= ~kIgnoreIdleRefresh;
       compositor_.Init(resource_manager_.get(), gpu_fd_);
+      compositor_.SetAsyncDraw(
+          GpuDevice::getInstance().IsAsyncCompositionEnabled());
+      commit_scheduler_.SetLatchMargin(
+          GpuDevice::getInstance().GetCommitLatchMarginUs());
       power_mode_lock_.unlock();
       break;
     default:
@@ -655,6 +662,12 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
 
   size_t previous_size = in_flight_layers_.size();
   std::vector<OverlayLayer> layers;
+  ScopedFrameStorage<OverlayLayer> layers_storage(recycled_layers_, layers);
+  DisplayPlaneStateList current_composition_planes;
+  ScopedFrameStorage<DisplayPlaneState> planes_storage(
+      recycled_planes_, current_composition_planes);
+  size_t storage_capacity =
+      GetFrameStorageCapacity(layers, current_composition_planes);
   int remove_index = -1;
   int add_index = -1;
   // If last commit failed, lets force full validation as
@@ -713,7 +726,6 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
         previous_plane_state_.empty(), tracker.RenderIdleMode());
   }
 
-  DisplayPlaneStateList current_composition_planes;
   bool render_layers;
   bool force_media_composition = false;
   bool requested_video_effect = false;
@@ -901,18 +913,37 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
 
   int32_t fence = 0;
   bool fence_released = false;
+  bool commit_failed = false;
   if (!IsIgnoreUpdates()) {
+    // Composition keeps running on the compositor thread while we wait.
+    commit_scheduler_.WaitForLatchPoint(vblank_handler_.get());
     composition_passed = display_->Commit(
         current_composition_planes, previous_plane_state_, disable_explictsync,
         kms_fence_, &fence, &fence_released);
+    commit_failed = !composition_passed;
   }
 
+  // Usually already done by display_ right before the commit, but we might
+  // have skipped it.
+  if (!WaitForComposition())
+    composition_passed = false;
+
   if (fence_released) {
     kms_fence_ = 0;
   }
 
+  if (commit_failed &&
+      RetryFailedCommit(layers, current_composition_planes,
+                        requested_video_effect, disable_explictsync, &fence,
+                        &fence_released)) {
+    composition_passed = true;
+    if (fence_released)
+      kms_fence_ = 0;
+  }
+
   if (!composition_passed) {
     last_commit_failed_update_ = true;
+    commit_scheduler_.Reset();
     HandleCommitFailure(current_composition_planes);
     return false;
   }
@@ -932,10 +963,16 @@ bool DisplayQueue::QueueUpdate(std::vector<HwcLayer*>& source_layers,
     tracker.ForceSurfaceRelease();
   }
 
+  if (GetFrameStorageCapacity(layers, current_composition_planes) >
+      storage_capacity) {
+    frame_storage_allocations_++;
+  }
+
   in_flight_layers_.swap(layers);
 
   // Swap current and previous composition results.
   previous_plane_state_.swap(current_composition_planes);
+  display_plane_manager_->AgeBlacklist();
 
   // Set Age for all offscreen surfaces.
   UpdateOnScreenSurfaces();
@@ -999,6 +1036,10 @@ void DisplayQueue::PresentClonedCommit(DisplayQueue* queue) {
   }
 
   std::vector<OverlayLayer> layers;
+  ScopedFrameStorage<OverlayLayer> layers_storage(recycled_layers_, layers);
+  DisplayPlaneStateList current_composition_planes;
+  ScopedFrameStorage<DisplayPlaneState> planes_storage(
+      recycled_planes_, current_composition_planes);
   int add_index = -1;
   int remove_index = -1;
   size_t z_order = 0;
@@ -1059,7 +1100,6 @@ void DisplayQueue::PresentClonedCommit(DisplayQueue* queue) {
   if (previous_plane_state_.size() != source_planes.size())
     validate_layers = true;
 
-  DisplayPlaneStateList current_composition_planes;
   // Validate Overlays and Layers usage.
   if (!validate_layers) {
     bool can_ignore_commit = false;
@@ -1166,6 +1206,9 @@ void DisplayQueue::PresentClonedCommit(DisplayQueue* queue) {
       display_->Commit(current_composition_planes, previous_plane_state_, false,
                        kms_fence_, &fence, &fence_released);
 
+  if (!WaitForComposition())
+    composition_passed = false;
+
   if (fence_released) {
     kms_fence_ = 0;
   }
@@ -1261,6 +1304,72 @@ void DisplayQueue::IgnoreUpdates() {
   idle_tracker_.revalidate_frames_counter_ = 0;
 }
 
+bool DisplayQueue::WaitForComposition() {
+  return compositor_.WaitForDraw();
+}
+
+uint32_t DisplayQueue::GetFrameStorageAllocations() const {
+  return frame_storage_allocations_ + compositor_.GetFrameStorageAllocations();
+}
+
+size_t DisplayQueue::GetFrameStorageCapacity(
+    const std::vector<OverlayLayer>& layers,
+    const DisplayPlaneStateList& composition) const {
+  return layers.capacity() + composition.capacity() +
+         display_plane_manager_->GetCommitPlanesCapacity();
+}
+
+bool DisplayQueue::RetryFailedCommit(
+    std::vector<OverlayLayer>& layers,
+    DisplayPlaneStateList& current_composition_planes,
+    bool requested_video_effect, bool disable_explictsync, int32_t* fence,
+    bool* fence_released) {
+  // Display frames of the layers have already been rotated for the failed
+  // commit.
+  if (plane_transform_ != kIdentity)
+    return false;
+
+  if (!display_plane_manager_->IsolateCommitFailure(
+          current_composition_planes))
+    return false;
+
+  // Layer which made the commit fail is blacklisted for the plane it was
+  // on now, a full validation moves it to GPU composition and keeps the
+  // other layers on their planes if possible.
+  HandleCommitFailure(current_composition_planes);
+  bool test_commit = false;
+  bool render_layers = display_plane_manager_->ValidateLayers(
+      layers, 0, false, &test_commit, &test_commit, current_composition_planes,
+      previous_plane_state_, surfaces_not_inuse_);
+  // Same as for the first attempt, video effects need a composition pass.
+  if (requested_video_effect) {
+    SetMediaEffectsState(requested_video_effect, layers,
+                         current_composition_planes);
+    render_layers = true;
+  }
+
+  if (render_layers) {
+    compositor_.BeginFrame(disable_explictsync);
+    std::vector<HwcRect<int>> layers_rects;
+    for (const OverlayLayer& layer : layers) {
+      layers_rects.emplace_back(layer.GetDisplayFrame());
+    }
+
+    if (!compositor_.Draw(current_composition_planes, layers, layers_rects)) {
+      ETRACE("Failed to prepare for the frame composition. ");
+      return false;
+    }
+  }
+
+  bool committed =
+      display_->Commit(current_composition_planes, previous_plane_state_,
+                       disable_explictsync, kms_fence_, fence, fence_released);
+  if (!WaitForComposition())
+    return false;
+
+  return committed;
+}
+
 bool DisplayQueue::IsIgnoreUpdates() {
   return idle_tracker_.state_ & FrameStateTracker::kIgnoreUpdates;
 }
@@ -1531,6 +1640,14 @@ void DisplayQueue::VSyncControl(bool enabled) {
   vblank_handler_->VSyncControl(enabled);
 }
 
+void* DisplayQueue::RequestPageFlipEvent() {
+  return vblank_handler_->RequestPageFlipEvent();
+}
+
+void DisplayQueue::CancelPageFlipEvent(void* user_data) {
+  vblank_handler_->CancelPageFlipEvent(user_data);
+}
+
 void DisplayQueue::HandleIdleCase() {
   idle_tracker_.idle_lock_.lock();
   if (idle_tracker_.state_ & FrameStateTracker::kPrepareComposition) {
@@ -1620,6 +1737,8 @@ void DisplayQueue::ResetQueue() {
   last_commit_failed_update_ = false;
   std::vector<OverlayLayer>().swap(in_flight_layers_);
   DisplayPlaneStateList().swap(previous_plane_state_);
+  std::vector<OverlayLayer>().swap(recycled_layers_);
+  DisplayPlaneStateList().swap(recycled_planes_);
   std::vector<NativeSurface*>().swap(mark_not_inuse_);
   std::vector<NativeSurface*>().swap(surfaces_not_inuse_);
   if (display_plane_manager_.get() && display_plane_manager_->HasSurfaces())
@@ -26,6 +26,7 @@
 #include <queue>
 #include <vector>
 
+#include "commitscheduler.h"
 #include "compositor.h"
 #include "displayplanemanager.h"
 #include "hwcthread.h"
@@ -99,6 +100,25 @@ class DisplayQueue {
 
   void ForceRefresh();
 
+  // Waits for GPU composition of the frame being presented to be submitted.
+  // Needs to be called before fences of offscreen surfaces are consumed.
+  bool WaitForComposition();
+
+  // Returns user data for atomic commits requesting
+  // DRM_MODE_PAGE_FLIP_EVENT, NULL if the commit shouldn't request it. The
+  // event is counted as pending, CancelPageFlipEvent must be called if the
+  // commit fails.
+  void* RequestPageFlipEvent();
+  void CancelPageFlipEvent(void* user_data);
+
+  // Number of frames which had to grow the storage recycled from frame to
+  // frame. Expected to stay constant in steady state.
+  uint32_t GetFrameStorageAllocations() const;
+
+  const CommitScheduler::Stats& GetCommitSchedulerStats() const {
+    return commit_scheduler_.GetStats();
+  }
+
   void ForceIgnoreUpdates(bool force);
 
   void UpdateScalingRatio(uint32_t primary_width, uint32_t primary_height,
@@ -326,6 +346,30 @@ class DisplayQueue {
     DisplayQueue* queue_;
   };
 
+  // Lends storage of a container which is rebuilt every frame from pool.
+  // Once the frame is done, storage (which might have been swapped with
+  // the in flight state meanwhile) is cleared and goes back to the pool.
+  template <typename T>
+  struct ScopedFrameStorage {
+    ScopedFrameStorage(std::vector<T>& pool, std::vector<T>& storage)
+        : pool_(pool), storage_(storage) {
+      storage_.swap(pool_);
+    }
+
+    ~ScopedFrameStorage() {
+      storage_.clear();
+      storage_.swap(pool_);
+    }
+
+   private:
+    std::vector<T>& pool_;
+    std::vector<T>& storage_;
+  };
+
+  size_t GetFrameStorageCapacity(
+      const std::vector<OverlayLayer>& layers,
+      const DisplayPlaneStateList& composition) const;
+
   void HandleExit();
   bool ForcePlaneValidation(int add_index, int remove_index,
                             int total_layers_size, size_t total_planes);
@@ -348,6 +392,15 @@ class DisplayQueue {
   void ResetQueue();
 
   void HandleCommitFailure(DisplayPlaneStateList& current_composition_planes);
+  // Called when the kernel rejected the commit of
+  // current_composition_planes. If the failure can be pinned down to a
+  // layer, re-validates the frame without it on its plane and commits it
+  // again. requested_video_effect is applied as for the failed commit.
+  // Returns true if that commit passed.
+  bool RetryFailedCommit(std::vector<OverlayLayer>& layers,
+                         DisplayPlaneStateList& current_composition_planes,
+                         bool requested_video_effect, bool disable_explictsync,
+                         int32_t* fence, bool* fence_released);
   void InitializeOverlayLayers(std::vector<HwcLayer*>& source_layers,
                                bool handle_constraints, bool validate_layers,
                                std::vector<OverlayLayer>& layers,
@@ -365,10 +418,16 @@ class DisplayQueue {
   struct gamma_colors gamma_;
   struct canvas_color_comps canvas_;
   std::unique_ptr<VblankEventHandler> vblank_handler_;
+  CommitScheduler commit_scheduler_;
   std::unique_ptr<DisplayPlaneManager> display_plane_manager_;
   std::unique_ptr<ResourceManager> resource_manager_;
   std::vector<OverlayLayer> in_flight_layers_;
   DisplayPlaneStateList previous_plane_state_;
+  // Storage of the per frame layers and composition planes, see
+  // ScopedFrameStorage.
+  std::vector<OverlayLayer> recycled_layers_;
+  DisplayPlaneStateList recycled_planes_;
+  uint32_t frame_storage_allocations_ = 0;
   FrameStateTracker idle_tracker_;
   ScalingTracker scaling_tracker_;
   // shared_ptr since we need to use this outside of the thread lock (to
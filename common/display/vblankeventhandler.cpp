@@ -16,44 +16,46 @@
 
 #include "vblankeventhandler.h"
 
-#include <stdlib.h>
-#include <time.h>
-
 #include "displayqueue.h"
 #include "hwctrace.h"
 
 namespace hwcomposer {
 
-static const int64_t kOneSecondNs = 1 * 1000 * 1000 * 1000;
-
 VblankEventHandler::VblankEventHandler(DisplayQueue* queue)
-    : HWCThread(-8, "VblankEventHandler"),
-      display_(0),
+    : display_(0),
       enabled_(false),
-      fd_(-1),
+      active_(false),
       last_timestamp_(-1),
+      last_flip_timestamp_(-1),
+      pipe_(0),
+      crtc_(NULL),
       queue_(queue) {
-  memset(&type_, 0, sizeof(type_));
 }
 
 VblankEventHandler::~VblankEventHandler() {
+  SetPowerMode(kOff);
 }
 
 void VblankEventHandler::Init(int fd, int pipe) {
-  fd_ = fd;
-  uint32_t high_crtc = (pipe << DRM_VBLANK_HIGH_CRTC_SHIFT);
-  type_ = (drmVBlankSeqType)(DRM_VBLANK_RELATIVE |
-                             (high_crtc & DRM_VBLANK_HIGH_CRTC_MASK));
+  SetPowerMode(kOff);
+  pipe_ = pipe;
+  loop_ = VblankEventLoop::GetInstance(fd);
+  crtc_ = loop_->GetCrtc(pipe_);
+  loop_->EnableVblankEvents(pipe_, enabled_);
 }
 
 bool VblankEventHandler::SetPowerMode(uint32_t power_mode) {
+  if (!loop_)
+    return true;
+
   if (power_mode != kOn) {
-    Exit();
-  } else {
-    if (!InitWorker()) {
-      ETRACE("Failed to initalize thread for VblankEventHandler. %s",
-             PRINTERROR());
+    if (active_) {
+      active_ = false;
+      loop_->RemoveDisplay(pipe_);
     }
+  } else if (!active_) {
+    loop_->AddDisplay(pipe_, this);
+    active_ = true;
   }
 
   return true;
@@ -79,41 +81,61 @@ int VblankEventHandler::VSyncControl(bool enabled) {
   last_timestamp_ = -1;
   spin_lock_.unlock();
 
+  // Vblank interrupts are kept enabled only while someone listens to them.
+  if (loop_)
+    loop_->EnableVblankEvents(pipe_, enabled);
+
   return 0;
 }
 
-void VblankEventHandler::HandlePageFlipEvent(unsigned int sec,
-                                             unsigned int usec) {
-  int64_t timestamp = ((int64_t)sec * kOneSecondNs) + ((int64_t)usec * 1000);
+bool VblankEventHandler::PredictVblank(int64_t time, int64_t* vblank,
+                                       int64_t* period) {
+  if (!active_)
+    return false;
+
+  return loop_->PredictVblank(crtc_, time, vblank, period);
+}
+
+void* VblankEventHandler::RequestPageFlipEvent() {
+  if (!active_)
+    return NULL;
+
+  VblankEventLoop::PageFlipRequested(crtc_);
+  return crtc_;
+}
+
+void VblankEventHandler::CancelPageFlipEvent(void* user_data) {
+  if (user_data)
+    VblankEventLoop::PageFlipFailed(static_cast<VblankEventLoop::Crtc*>(
+        user_data));
+}
+
+int64_t VblankEventHandler::GetLastPageFlipTimestamp() {
+  ScopedSpinLock lock(spin_lock_);
+  return last_flip_timestamp_;
+}
+
+void VblankEventHandler::HandleIdleTick() {
+  queue_->HandleIdleCase();
+}
+
+void VblankEventHandler::HandleVblank(int64_t timestamp) {
   IPAGEFLIPEVENTTRACE("HandleVblankCallBack Frame Time %f",
                       static_cast<float>(timestamp - last_timestamp_) / (1000));
-  last_timestamp_ = timestamp;
-
-  IPAGEFLIPEVENTTRACE("Callback called from HandlePageFlipEvent. %lu",
-                      timestamp);
   spin_lock_.lock();
+  last_timestamp_ = timestamp;
   if (enabled_ && callback_) {
     callback_->Callback(display_, timestamp);
   }
   spin_lock_.unlock();
 }
 
-void VblankEventHandler::HandleWait() {
-}
-
-void VblankEventHandler::HandleRoutine() {
-  queue_->HandleIdleCase();
-
-  drmVBlank vblank;
-  memset(&vblank, 0, sizeof(vblank));
-  vblank.request.sequence = 1;
-
-  int fd = fd_;
-  vblank.request.type = type_;
-
-  int ret = drmWaitVBlank(fd, &vblank);
-  if (!ret)
-    HandlePageFlipEvent(vblank.reply.tval_sec, (int64_t)vblank.reply.tval_usec);
+void VblankEventHandler::HandlePageFlip(int64_t timestamp) {
+  IPAGEFLIPEVENTTRACE("Page flip completed at %lld",
+                      static_cast<long long>(timestamp));
+  spin_lock_.lock();
+  last_flip_timestamp_ = timestamp;
+  spin_lock_.unlock();
 }
 
 }  // namespace hwcomposer
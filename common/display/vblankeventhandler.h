@@ -18,38 +18,53 @@
 #define COMMON_DISPLAY_VBLANK_EVENT_HANDLER_H_
 
 #include <stdint.h>
-#include <xf86drm.h>
 
 #include <nativedisplay.h>
 #include <spinlock.h>
 
 #include <memory>
 
-#include "hwcthread.h"
+#include "vblankeventloop.h"
 
 namespace hwcomposer {
 
 class DisplayQueue;
 
-class VblankEventHandler : public HWCThread {
+// Receives vblank and page flip events of a display from the
+// VblankEventLoop of its gpu fd while the display is powered on.
+class VblankEventHandler {
  public:
   VblankEventHandler(DisplayQueue* queue);
-  ~VblankEventHandler() override;
+  ~VblankEventHandler();
 
   void Init(int fd, int pipe);
 
   bool SetPowerMode(uint32_t power_mode);
 
-  void HandlePageFlipEvent(unsigned int sec, unsigned int usec);
-
   int RegisterCallback(std::shared_ptr<VsyncCallback> callback,
                        uint32_t display_id);
 
   int VSyncControl(bool enabled);
 
- protected:
-  void HandleRoutine() override;
-  void HandleWait() override;
+  // Returns user data to be passed with atomic commits requesting
+  // DRM_MODE_PAGE_FLIP_EVENT, NULL if page flip events are not handled
+  // currently. The event is counted as pending till it has been read, call
+  // CancelPageFlipEvent if the commit fails.
+  void* RequestPageFlipEvent();
+  void CancelPageFlipEvent(void* user_data);
+
+  // Predicts first vblank after time, see VblankEventLoop::PredictVblank.
+  // Returns false if the display is not powered on or no vblank has been
+  // seen yet.
+  bool PredictVblank(int64_t time, int64_t* vblank, int64_t* period);
+
+  // Returns completion time of the last page flip, -1 if not known.
+  int64_t GetLastPageFlipTimestamp();
+
+  // Called from VblankEventLoop.
+  void HandleVblank(int64_t timestamp);
+  void HandleIdleTick();
+  void HandlePageFlip(int64_t timestamp);
 
  private:
   // shared_ptr since we need to use this outside of the thread lock (to
@@ -59,10 +74,13 @@ class VblankEventHandler : public HWCThread {
   SpinLock spin_lock_;
   uint32_t display_;
   bool enabled_ = false;
+  bool active_ = false;
 
-  int fd_;
   int64_t last_timestamp_;
-  drmVBlankSeqType type_;
+  int64_t last_flip_timestamp_;
+  uint32_t pipe_;
+  std::shared_ptr<VblankEventLoop> loop_;
+  VblankEventLoop::Crtc* crtc_;
   DisplayQueue* queue_;
 };
 
@@ -0,0 +1,416 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "vblankeventloop.h"
+
+#include <string.h>
+#include <xf86drm.h>
+
+#include <hwcutils.h>
+
+#include "hwctrace.h"
+#include "vblankeventhandler.h"
+
+namespace hwcomposer {
+
+static const int64_t kOneSecondNs = 1 * 1000 * 1000 * 1000;
+static const int64_t kOneMilliSecondNs = 1000 * 1000;
+// Used till the first two vblanks of a pipe have been seen.
+static const int64_t kDefaultPeriodNs = kOneSecondNs / 60;
+// Vblank periods outside of this range are assumed to be measuring errors,
+// i.e. after the vblank counter has been reset.
+static const int64_t kMinPeriodNs = kOneSecondNs / 240;
+static const int64_t kMaxPeriodNs = kOneSecondNs / 10;
+// Interval of idle detection ticks, see DisplayQueue::HandleIdleCase.
+static const int64_t kIdleTickNs = kOneSecondNs / 60;
+// Time to wait for events still queued in the kernel when the loop exits.
+static const int kDrainTimeoutMs = 50;
+
+static SpinLock loops_lock;
+static std::map<int, std::weak_ptr<VblankEventLoop>> loops;
+
+std::shared_ptr<VblankEventLoop> VblankEventLoop::GetInstance(int fd) {
+  ScopedSpinLock lock(loops_lock);
+  std::shared_ptr<VblankEventLoop> loop = loops[fd].lock();
+  if (loop)
+    return loop;
+
+  loop.reset(new VblankEventLoop(fd));
+  if (!loop->InitWorker()) {
+    ETRACE("Failed to initalize thread for VblankEventLoop. %s",
+           PRINTERROR());
+  }
+
+  loops[fd] = loop;
+  return loop;
+}
+
+VblankEventLoop::VblankEventLoop(int fd)
+    : HWCThread(-8, "VblankEventLoop"), fd_(fd) {
+  fd_handler_.AddFd(fd_, this);
+  idle_timer_ = fd_handler_.AddTimer(this);
+}
+
+VblankEventLoop::~VblankEventLoop() {
+  // Make sure HandleExit runs while this object is still alive.
+  Exit();
+}
+
+VblankEventLoop::Crtc* VblankEventLoop::GetCrtc(uint32_t pipe) {
+  ScopedSpinLock lock(lock_);
+  auto it = crtcs_.find(pipe);
+  if (it != crtcs_.end())
+    return &it->second;
+
+  Crtc& crtc = crtcs_[pipe];
+  crtc.loop = this;
+  crtc.pipe = pipe;
+  crtc.period_ns = kDefaultPeriodNs;
+  return &crtc;
+}
+
+void VblankEventLoop::PageFlipRequested(Crtc* crtc) {
+  ScopedSpinLock lock(crtc->loop->lock_);
+  crtc->pending_flips++;
+}
+
+void VblankEventLoop::PageFlipFailed(Crtc* crtc) {
+  ScopedSpinLock lock(crtc->loop->lock_);
+  if (crtc->pending_flips)
+    crtc->pending_flips--;
+}
+
+void VblankEventLoop::AddDisplay(uint32_t pipe, VblankEventHandler* handler) {
+  Crtc* crtc = GetCrtc(pipe);
+  lock_.lock();
+  if (!crtc->handler && !active_displays_++)
+    fd_handler_.SetTimer(idle_timer_, kIdleTickNs, kIdleTickNs);
+
+  crtc->handler = handler;
+  if (crtc->vblank_enabled)
+    RequestVblank(crtc);
+
+  lock_.unlock();
+  // Let the loop pick up the new software vsync deadline, if any.
+  Resume();
+}
+
+void VblankEventLoop::EnableVblankEvents(uint32_t pipe, bool enable) {
+  Crtc* crtc = GetCrtc(pipe);
+  lock_.lock();
+  crtc->vblank_enabled = enable;
+  if (!enable) {
+    // A request already queued in the kernel is not re-armed.
+    crtc->next_software_vsync_ns = -1;
+  } else if (crtc->handler) {
+    RequestVblank(crtc);
+  }
+
+  lock_.unlock();
+  Resume();
+}
+
+bool VblankEventLoop::PredictVblank(Crtc* crtc, int64_t time,
+                                    int64_t* vblank, int64_t* period) {
+  ScopedSpinLock lock(lock_);
+  if (crtc->phase_ns < 0)
+    return false;
+
+  int64_t elapsed = time - crtc->phase_ns;
+  if (elapsed < 0) {
+    *vblank = crtc->phase_ns;
+  } else {
+    *vblank = crtc->phase_ns +
+              (elapsed / crtc->period_ns + 1) * crtc->period_ns;
+  }
+
+  *period = crtc->period_ns;
+  return true;
+}
+
+void VblankEventLoop::RemoveDisplay(uint32_t pipe) {
+  ScopedSpinLock lock(lock_);
+  auto it = crtcs_.find(pipe);
+  if (it == crtcs_.end())
+    return;
+
+  Crtc* crtc = &it->second;
+  // A vblank request still queued in the kernel is consumed by the loop
+  // without being re-armed.
+  if (crtc->handler && !--active_displays_)
+    fd_handler_.SetTimer(idle_timer_, 0, 0);
+
+  crtc->handler = NULL;
+  crtc->next_software_vsync_ns = -1;
+  if (std::this_thread::get_id() == callback_thread_)
+    return;
+
+  callbacks_done_.wait(lock_, [crtc] { return !crtc->callbacks; });
+}
+
+void VblankEventLoop::QueueCallback(Crtc* crtc, int64_t timestamp) {
+  crtc->callbacks++;
+  callback_thread_ = std::this_thread::get_id();
+  callbacks_.emplace_back(PendingCallback{crtc, crtc->handler, timestamp});
+}
+
+void VblankEventLoop::RunCallbacks(CallbackType type) {
+  for (const PendingCallback& callback : callbacks_) {
+    // Skip handlers removed since the callback was queued. RemoveDisplay
+    // waits for the callback to be done with, so handler stays valid.
+    lock_.lock();
+    bool removed = callback.crtc->handler != callback.handler;
+    lock_.unlock();
+    if (!removed) {
+      switch (type) {
+        case kVblank:
+          callback.handler->HandleVblank(callback.timestamp);
+          break;
+        case kPageFlip:
+          callback.handler->HandlePageFlip(callback.timestamp);
+          break;
+        case kIdleTick:
+          callback.handler->HandleIdleTick();
+          break;
+      }
+    }
+
+    lock_.lock();
+    if (!--callback.crtc->callbacks)
+      callbacks_done_.notify_all();
+
+    lock_.unlock();
+  }
+
+  callbacks_.clear();
+}
+
+void VblankEventLoop::VblankHandler(int /*fd*/, unsigned int sequence,
+                                    unsigned int sec, unsigned int usec,
+                                    void* user_data) {
+  Crtc* crtc = static_cast<Crtc*>(user_data);
+  int64_t timestamp = ((int64_t)sec * kOneSecondNs) + ((int64_t)usec * 1000);
+  crtc->loop->HandleVblank(crtc, sequence, timestamp);
+}
+
+void VblankEventLoop::PageFlipHandler(int /*fd*/, unsigned int sequence,
+                                      unsigned int sec, unsigned int usec,
+                                      void* user_data) {
+  Crtc* crtc = static_cast<Crtc*>(user_data);
+  if (!crtc)
+    return;
+
+  int64_t timestamp = ((int64_t)sec * kOneSecondNs) + ((int64_t)usec * 1000);
+  crtc->loop->HandlePageFlip(crtc, sequence, timestamp);
+}
+
+void VblankEventLoop::HandleEvents() {
+  drmEventContext context;
+  memset(&context, 0, sizeof(context));
+  context.version = 2;
+  context.vblank_handler = VblankHandler;
+  context.page_flip_handler = PageFlipHandler;
+  if (drmHandleEvent(fd_, &context)) {
+    ETRACE("Failed to read drm events. %s", PRINTERROR());
+  }
+}
+
+void VblankEventLoop::HandleVblank(Crtc* crtc, uint32_t sequence,
+                                   int64_t timestamp) {
+  lock_.lock();
+  crtc->vblank_requested = false;
+  UpdateModel(crtc, sequence, timestamp);
+  if (!crtc->handler || !crtc->vblank_enabled) {
+    lock_.unlock();
+    return;
+  }
+
+  RequestVblank(crtc);
+  QueueCallback(crtc, timestamp);
+  lock_.unlock();
+  RunCallbacks(kVblank);
+}
+
+void VblankEventLoop::HandlePageFlip(Crtc* crtc, uint32_t sequence,
+                                     int64_t timestamp) {
+  lock_.lock();
+  if (crtc->pending_flips)
+    crtc->pending_flips--;
+
+  UpdateModel(crtc, sequence, timestamp);
+  if (!crtc->handler) {
+    lock_.unlock();
+    return;
+  }
+
+  QueueCallback(crtc, timestamp);
+  lock_.unlock();
+  RunCallbacks(kPageFlip);
+}
+
+void VblankEventLoop::HandleSoftwareVsync() {
+  lock_.lock();
+  int64_t now = GetMonotonicTimeNs();
+  int64_t next_wakeup = -1;
+  for (auto& it : crtcs_) {
+    Crtc* crtc = &it.second;
+    if (!crtc->handler || !crtc->vblank_enabled ||
+        crtc->next_software_vsync_ns < 0)
+      continue;
+
+    if (crtc->next_software_vsync_ns <= now) {
+      int64_t timestamp = crtc->next_software_vsync_ns;
+      // Don't try to catch up with vsyncs we slept through.
+      while (crtc->next_software_vsync_ns <= now)
+        crtc->next_software_vsync_ns += crtc->period_ns;
+
+      // Switches back to hardware events if kernel can deliver them again.
+      RequestVblank(crtc);
+      QueueCallback(crtc, timestamp);
+      if (crtc->next_software_vsync_ns < 0)
+        continue;
+    }
+
+    if (next_wakeup < 0 || crtc->next_software_vsync_ns < next_wakeup)
+      next_wakeup = crtc->next_software_vsync_ns;
+  }
+
+  if (next_wakeup < 0) {
+    wait_timeout_ms_ = -1;
+  } else {
+    wait_timeout_ms_ =
+        (next_wakeup - now + kOneMilliSecondNs - 1) / kOneMilliSecondNs;
+  }
+
+  lock_.unlock();
+  RunCallbacks(kVblank);
+}
+
+void VblankEventLoop::RequestVblank(Crtc* crtc) {
+  if (crtc->vblank_requested)
+    return;
+
+  drmVBlank vblank;
+  memset(&vblank, 0, sizeof(vblank));
+  uint32_t high_crtc = (crtc->pipe << DRM_VBLANK_HIGH_CRTC_SHIFT);
+  vblank.request.type =
+      (drmVBlankSeqType)(DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT |
+                         (high_crtc & DRM_VBLANK_HIGH_CRTC_MASK));
+  vblank.request.sequence = 1;
+  vblank.request.signal = reinterpret_cast<unsigned long>(crtc);
+  if (!drmWaitVBlank(fd_, &vblank)) {
+    crtc->vblank_requested = true;
+    crtc->next_software_vsync_ns = -1;
+    return;
+  }
+
+  if (crtc->next_software_vsync_ns >= 0)
+    return;
+
+  // Continue with the last known phase and period of the pipe.
+  int64_t now = GetMonotonicTimeNs();
+  if (crtc->phase_ns < 0)
+    crtc->phase_ns = now;
+
+  int64_t elapsed = now - crtc->phase_ns;
+  crtc->next_software_vsync_ns =
+      crtc->phase_ns + (elapsed / crtc->period_ns + 1) * crtc->period_ns;
+  IPAGEFLIPEVENTTRACE("Using software vsync for pipe %d. %s", crtc->pipe,
+                      PRINTERROR());
+}
+
+bool VblankEventLoop::HasPendingEvents() const {
+  for (const auto& it : crtcs_) {
+    if (it.second.vblank_requested || it.second.pending_flips)
+      return true;
+  }
+
+  return false;
+}
+
+void VblankEventLoop::UpdateModel(Crtc* crtc, uint32_t sequence,
+                                  int64_t timestamp) {
+  uint32_t frames = sequence - crtc->sequence;
+  if (crtc->phase_ns >= 0 && frames > 0 && timestamp > crtc->phase_ns) {
+    int64_t period = (timestamp - crtc->phase_ns) / frames;
+    if (period >= kMinPeriodNs && period <= kMaxPeriodNs)
+      crtc->period_ns += (period - crtc->period_ns) / 4;
+  }
+
+  if (timestamp < crtc->phase_ns)
+    return;
+
+  crtc->sequence = sequence;
+  crtc->phase_ns = timestamp;
+}
+
+void VblankEventLoop::Callback(int fd) {
+  if (fd == idle_timer_) {
+    lock_.lock();
+    for (auto& it : crtcs_) {
+      if (it.second.handler)
+        QueueCallback(&it.second, 0);
+    }
+
+    lock_.unlock();
+    RunCallbacks(kIdleTick);
+    return;
+  }
+
+  if (fd_handler_.IsReady(fd_) > 0)
+    HandleEvents();
+}
+
+void VblankEventLoop::HandleRoutine() {
+  if (fd_handler_.IsReady(fd_) < 0) {
+    ETRACE("Stopped reading events of fd %d.", fd_);
+    fd_handler_.RemoveFd(fd_);
+  }
+
+  HandleSoftwareVsync();
+}
+
+void VblankEventLoop::HandleExit() {
+  // Events still queued in the kernel point to our Crtc objects, read them
+  // before the objects go away. A later loop for the same fd would read
+  // them otherwise.
+  int64_t deadline =
+      GetMonotonicTimeNs() + kDrainTimeoutMs * kOneMilliSecondNs;
+  while (true) {
+    lock_.lock();
+    bool pending = HasPendingEvents();
+    lock_.unlock();
+    int64_t remaining = deadline - GetMonotonicTimeNs();
+    if (!pending || remaining <= 0)
+      break;
+
+    // Events are read from Callback.
+    fd_handler_.Poll((remaining + kOneMilliSecondNs - 1) / kOneMilliSecondNs);
+  }
+
+  lock_.lock();
+  if (HasPendingEvents())
+    ETRACE("Events of fd %d still pending after %d ms.", fd_, kDrainTimeoutMs);
+
+  lock_.unlock();
+
+  ScopedSpinLock lock(loops_lock);
+  auto it = loops.find(fd_);
+  if (it != loops.end() && it->second.expired())
+    loops.erase(it);
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,153 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_DISPLAY_VBLANKEVENTLOOP_H_
+#define COMMON_DISPLAY_VBLANKEVENTLOOP_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <spinlock.h>
+
+#include "hwcthread.h"
+
+namespace hwcomposer {
+
+class VblankEventHandler;
+
+// Reads vblank and page flip events of all displays driven by a gpu fd on
+// a single thread and dispatches them to the VblankEventHandler of the
+// display. Each pipe with vsync enabled has one vblank event request
+// queued in the kernel, which is re-armed from the event itself. The loop
+// keeps track of the phase and period of every pipe, so that vsync can
+// still be generated in software while the kernel can't deliver vblank
+// events for it. Idle detection of the displays runs from a timer on the
+// same thread, so it doesn't keep vblank interrupts enabled. Handlers are
+// called without holding the lock of the loop, so they may call back into
+// it.
+class VblankEventLoop : public HWCThread, public FDCallback {
+ public:
+  // Per pipe state, owned by the loop and valid for its lifetime.
+  struct Crtc {
+    VblankEventLoop* loop = NULL;
+    VblankEventHandler* handler = NULL;
+    uint32_t pipe = 0;
+    // Vblank counter and timestamp of the last vblank or page flip and
+    // estimated time between two vblanks.
+    uint32_t sequence = 0;
+    int64_t phase_ns = -1;
+    int64_t period_ns = 0;
+    // Time of the next software vsync, -1 when hardware events are used.
+    int64_t next_software_vsync_ns = -1;
+    bool vblank_enabled = false;
+    bool vblank_requested = false;
+    // Number of calls to handler in flight, see RemoveDisplay.
+    uint32_t callbacks = 0;
+    // Number of page flip events requested and not read yet.
+    uint32_t pending_flips = 0;
+  };
+
+  // Returns loop handling events of fd, creating it if needed. The loop is
+  // destroyed once the last reference to it has been dropped.
+  static std::shared_ptr<VblankEventLoop> GetInstance(int fd);
+
+  ~VblankEventLoop() override;
+
+  // Returns state of pipe. Pointer to it should be passed as user data of
+  // atomic commits with DRM_MODE_PAGE_FLIP_EVENT set, see PageFlipRequested.
+  Crtc* GetCrtc(uint32_t pipe);
+
+  // Counts a page flip event of crtc about to be requested, so that the
+  // loop reads it before going away. Must be undone with PageFlipFailed if
+  // the commit requesting it fails.
+  static void PageFlipRequested(Crtc* crtc);
+  static void PageFlipFailed(Crtc* crtc);
+
+  // Starts dispatching events of pipe to handler.
+  void AddDisplay(uint32_t pipe, VblankEventHandler* handler);
+
+  // Sets vblank to the first vblank of crtc after time and period to its
+  // estimated period. Returns false if crtc hasn't seen any vblank yet.
+  bool PredictVblank(Crtc* crtc, int64_t time, int64_t* vblank,
+                     int64_t* period);
+
+  // Starts or stops delivering vsync events to the handler of pipe.
+  void EnableVblankEvents(uint32_t pipe, bool enable);
+
+  // Stops dispatching events of pipe. Callbacks of the handler are not
+  // running and won't be called anymore once this returns. When called from
+  // one of its callbacks, only that callback may still be running.
+  void RemoveDisplay(uint32_t pipe);
+
+ protected:
+  // Called from Poll for the gpu fd and the idle timer.
+  void Callback(int fd) override;
+  void HandleRoutine() override;
+  void HandleExit() override;
+
+ private:
+  explicit VblankEventLoop(int fd);
+
+  static void VblankHandler(int fd, unsigned int sequence, unsigned int sec,
+                            unsigned int usec, void* user_data);
+  static void PageFlipHandler(int fd, unsigned int sequence, unsigned int sec,
+                              unsigned int usec, void* user_data);
+
+  enum CallbackType { kVblank, kPageFlip, kIdleTick };
+
+  struct PendingCallback {
+    Crtc* crtc;
+    VblankEventHandler* handler;
+    int64_t timestamp;
+  };
+
+  // Marks a call to handler of crtc as in flight and queues it in
+  // callbacks_. Called with lock_ held.
+  void QueueCallback(Crtc* crtc, int64_t timestamp);
+  // Calls handlers queued in callbacks_. Called without lock_ held.
+  void RunCallbacks(CallbackType type);
+  void HandleEvents();
+  void HandleVblank(Crtc* crtc, uint32_t sequence, int64_t timestamp);
+  void HandlePageFlip(Crtc* crtc, uint32_t sequence, int64_t timestamp);
+  void HandleSoftwareVsync();
+  // Queues vblank event request for next vblank of crtc. Falls back to
+  // software vsync if kernel can't deliver it.
+  void RequestVblank(Crtc* crtc);
+  // Returns true if events are still queued in the kernel for one of the
+  // Crtcs. Called with lock_ held.
+  bool HasPendingEvents() const;
+  void UpdateModel(Crtc* crtc, uint32_t sequence, int64_t timestamp);
+
+  int fd_;
+  int idle_timer_;
+  uint32_t active_displays_ = 0;
+  SpinLock lock_;
+  std::map<uint32_t, Crtc> crtcs_;
+  // Signaled when the last callback in flight of a Crtc has returned.
+  std::condition_variable_any callbacks_done_;
+  // Thread running the callbacks, RemoveDisplay called from it doesn't wait.
+  std::thread::id callback_thread_;
+  // Only used by the loop thread, kept around to re-use its storage.
+  std::vector<PendingCallback> callbacks_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_DISPLAY_VBLANKEVENTLOOP_H_
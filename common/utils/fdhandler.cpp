@@ -17,88 +17,187 @@
 #include "fdhandler.h"
 
 #include <errno.h>
-#include <poll.h>
 #include <string.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "hwctrace.h"
 
 namespace hwcomposer {
 
-FDHandler::FDHandler() {
+static const int64_t kOneSecondNs = 1 * 1000 * 1000 * 1000;
+
+FDHandler::FDHandler()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)), events_(1) {
+  if (epoll_fd_ < 0) {
+    ETRACE("Failed to create epoll instance. %s", PRINTERROR());
+  }
 }
 
 FDHandler::~FDHandler() {
+  for (const FDWatch &watch : watches_) {
+    if (watch.timer)
+      close(watch.fd);
+  }
+
+  if (epoll_fd_ >= 0)
+    close(epoll_fd_);
 }
 
-bool FDHandler::AddFd(int fd) {
+bool FDHandler::AddFd(int fd, FDCallback *callback, Mode mode) {
   if (fd < 0) {
     ETRACE("Cannot add negative fd: %d", fd);
     return false;
   }
 
-  auto it = fds_.find(fd);
-  if (it != fds_.end()) {
-    ETRACE("FD already being watched: %d\n", it->first);
+  if (FindWatch(fd)) {
+    ETRACE("FD already being watched: %d\n", fd);
     return false;
   }
 
-  fds_.emplace(fd, FDWatch());
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  if (mode == kEdgeTriggered)
+    event.events |= EPOLLET;
 
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event)) {
+    ETRACE("Failed to watch fd %d. %s", fd, PRINTERROR());
+    return false;
+  }
+
+  FDWatch watch;
+  watch.fd = fd;
+  watch.revents = 0;
+  watch.callback = callback;
+  watch.timer = false;
+  watches_.emplace_back(watch);
+  events_.resize(watches_.size());
   return true;
 }
 
 bool FDHandler::RemoveFd(int fd) {
-  const auto &fd_iter = fds_.find(fd);
-  if (fd_iter == fds_.end()) {
-    ETRACE("FD %d is not being watched.\n", fd);
+  size_t size = watches_.size();
+  for (size_t i = 0; i < size; i++) {
+    if (watches_[i].fd != fd)
+      continue;
+
+    // fd might have been closed already, which removes it from epoll too.
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, NULL);
+    watches_.erase(watches_.begin() + i);
+    return true;
+  }
+
+  ETRACE("FD %d is not being watched.\n", fd);
+  return false;
+}
+
+int FDHandler::AddTimer(FDCallback *callback) {
+  int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (timer < 0) {
+    ETRACE("Failed to create timer. %s", PRINTERROR());
+    return -1;
+  }
+
+  if (!AddFd(timer, callback)) {
+    close(timer);
+    return -1;
+  }
+
+  watches_.back().timer = true;
+  return timer;
+}
+
+bool FDHandler::SetTimer(int timer, int64_t delay_ns, int64_t interval_ns) {
+  struct itimerspec spec;
+  spec.it_value.tv_sec = delay_ns / kOneSecondNs;
+  spec.it_value.tv_nsec = delay_ns % kOneSecondNs;
+  spec.it_interval.tv_sec = interval_ns / kOneSecondNs;
+  spec.it_interval.tv_nsec = interval_ns % kOneSecondNs;
+  if (timerfd_settime(timer, 0, &spec, NULL)) {
+    ETRACE("Failed to arm timer %d. %s", timer, PRINTERROR());
+    return false;
+  }
+
+  return true;
+}
+
+bool FDHandler::RemoveTimer(int timer) {
+  FDWatch *watch = FindWatch(timer);
+  if (!watch || !watch->timer) {
+    ETRACE("FD %d is not a timer.\n", timer);
     return false;
   }
 
-  fds_.erase(fd_iter);
+  RemoveFd(timer);
+  close(timer);
   return true;
 }
 
 int FDHandler::Poll(int timeout) {
-  nfds_t nfds = fds_.size();
-  struct pollfd fds[nfds];
+  for (FDWatch &watch : watches_) {
+    watch.revents = 0;
+  }
 
-  int i = 0;
-  for (auto &it : fds_) {
-    fds[i].fd = it.first;
-    fds[i].events = POLLIN;
-    it.second.idx = i;
-    i++;
+  int ret = epoll_wait(epoll_fd_, events_.data(), events_.size(), timeout);
+  for (int i = 0; i < ret; i++) {
+    FDWatch *watch = FindWatch(events_[i].data.fd);
+    if (watch)
+      watch->revents = events_[i].events;
   }
 
-  int ret = poll(fds, nfds, timeout);
+  // Callbacks may add or remove fds, look them up again every time.
+  for (int i = 0; i < ret; i++) {
+    int fd = events_[i].data.fd;
+    FDWatch *watch = FindWatch(fd);
+    if (!watch || !watch->callback)
+      continue;
+
+    if (watch->timer) {
+      uint64_t expirations;
+      if (read(fd, &expirations, sizeof(expirations)) < 0)
+        continue;
+    }
 
-  for (auto &it : fds_) {
-    it.second.revents = fds[it.second.idx].revents;
+    watch->callback->Callback(fd);
   }
 
   return ret;
 }
 
 int FDHandler::IsReady(int fd) const {
-  const auto &it = fds_.find(fd);
-  if (it == fds_.end()) {
+  const FDWatch *watch = FindWatch(fd);
+  if (!watch) {
     ETRACE("FD %d is being watched but we can't find it.\n", fd);
     return false;
   }
 
-  int revents = it->second.revents;
-  if (revents & POLLIN)
+  if (watch->revents & EPOLLIN)
     return 1;
-  else if (revents & POLLERR)
+  else if (watch->revents & EPOLLERR)
     return -1;
-  else if (revents & POLLNVAL)
-    return -2;
   else
     return 0;
 }
 
-FDHandler::FDWatch::FDWatch() : idx(0), revents(0) {
+FDHandler::FDWatch *FDHandler::FindWatch(int fd) {
+  for (FDWatch &watch : watches_) {
+    if (watch.fd == fd)
+      return &watch;
+  }
+
+  return NULL;
+}
+
+const FDHandler::FDWatch *FDHandler::FindWatch(int fd) const {
+  for (const FDWatch &watch : watches_) {
+    if (watch.fd == fd)
+      return &watch;
+  }
+
+  return NULL;
 }
 
 }  // namespace hwcomposer
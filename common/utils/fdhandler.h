@@ -17,28 +17,64 @@
 #ifndef COMMON_UTILS_FDHANDLER_H_
 #define COMMON_UTILS_FDHANDLER_H_
 
-#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#include <vector>
 
 namespace hwcomposer {
 
-// Class wrapper around poll() and struct pollfd.
-// It keeps the fds added on it so one doesn't have to keep
-// recreating/populating the pollfd manually.
+// Interface for being notified by FDHandler::Poll about fds becoming ready.
+class FDCallback {
+ public:
+  virtual ~FDCallback() {
+  }
+
+  virtual void Callback(int fd) = 0;
+};
+
+// Class wrapper around epoll.
+// fds are registered with the kernel once when added, so Poll costs a
+// single epoll_wait no matter how many fds are being watched.
 class FDHandler {
  public:
+  enum Mode {
+    // fd is reported by every Poll as long as it is ready.
+    kLevelTriggered,
+    // fd is reported only once each time it becomes ready.
+    kEdgeTriggered
+  };
+
   FDHandler();
+  FDHandler(const FDHandler &) = delete;
+  FDHandler &operator=(const FDHandler &) = delete;
   virtual ~FDHandler();
 
   // Add fd to the list of fds that we care about. This makes ::Poll watch for
-  // this fd when called.
-  bool AddFd(int fd);
+  // this fd when called. If callback is not NULL, it is called from Poll
+  // whenever fd is ready.
+  bool AddFd(int fd, FDCallback* callback = NULL, Mode mode = kLevelTriggered);
 
   // Remove the fd from the list of fds that we are watching.
   bool RemoveFd(int fd);
 
-  // Call poll() on the list of fds that we are watching. Will block if
+  // Creates a timer owned by this handler and returns its fd, -1 on error.
+  // The timer is disarmed initially. callback is called from Poll every
+  // time the timer expires.
+  int AddTimer(FDCallback* callback);
+
+  // Arms timer to expire after delay_ns and then every interval_ns, if
+  // interval_ns is not 0. A delay_ns of 0 disarms the timer. Can be called
+  // from any thread.
+  bool SetTimer(int timer, int64_t delay_ns, int64_t interval_ns);
+
+  // Stops watching timer and destroys it.
+  bool RemoveTimer(int timer);
+
+  // Wait for events on the fds that we are watching. Will block if
   // timemout > 0. Store the result from the poll request, so it can be queried
-  // with ::IsReady().
+  // with ::IsReady(), and runs callbacks of the ready fds.
   //  - timeout: time in miliseconds to stay blocked before returning if no fd
   //  is ready.
   //  - return: number of fds ready. If return is 0, it means we timed out. If
@@ -49,17 +85,24 @@ class FDHandler {
   // - return: 1 if fd is ready to read
   //           0 if fd is not ready
   //           -1 if there's an error on the fd
-  //           -2 if the fd is closed and can't be polled
   int IsReady(int fd) const;
 
  private:
   struct FDWatch {
-    FDWatch();
-    int idx;
-    short revents;
+    int fd;
+    uint32_t revents;
+    FDCallback* callback;
+    bool timer;
   };
 
-  std::map<int, FDWatch> fds_;
+  FDWatch* FindWatch(int fd);
+  const FDWatch* FindWatch(int fd) const;
+
+  int epoll_fd_;
+  // Usually there are only a few fds being watched, looking them up
+  // linearly is faster than a map.
+  std::vector<FDWatch> watches_;
+  std::vector<struct epoll_event> events_;
 };
 
 }  // namespace hwcomposer
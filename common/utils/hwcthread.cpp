@@ -25,7 +25,10 @@
 namespace hwcomposer {
 
 HWCThread::HWCThread(int priority, const char *name)
-    : initialized_(false), priority_(priority), name_(name) {
+    : initialized_(false),
+      wait_timeout_ms_(-1),
+      priority_(priority),
+      name_(name) {
 }
 
 HWCThread::~HWCThread() {
@@ -71,11 +74,15 @@ void HWCThread::HandleExit() {
 }
 
 void HWCThread::HandleWait() {
-  if (fd_handler_.Poll(-1) <= 0) {
+  int ret = fd_handler_.Poll(wait_timeout_ms_);
+  if (ret < 0) {
     ETRACE("Poll Failed in DisplayManager %s", PRINTERROR());
     return;
   }
 
+  if (ret == 0)
+    return;
+
   if (fd_handler_.IsReady(event_.get_fd())) {
     // If eventfd_ is ready, we need to wait on it (using read()) to clean
     // the flag that says it is ready.
@@ -43,6 +43,9 @@ class HWCThread {
 
   FDHandler fd_handler_;
   bool initialized_;
+  // Timeout used by HandleWait when polling fd_handler_. HandleRoutine is
+  // called even if poll timed out.
+  int wait_timeout_ms_;
 
  private:
   void ProcessThread();
@@ -17,6 +17,7 @@
 #include "hwcutils.h"
 
 #include <poll.h>
+#include <time.h>
 
 #include "hwctrace.h"
 
@@ -37,6 +38,13 @@ int HWCPoll(int fd, int timeout) {
   return ret;
 }
 
+uint64_t GetMonotonicTimeNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
 void ResetRectToRegion(const HwcRegion& hwc_region, HwcRect<int>& rect) {
   size_t total_rects = hwc_region.size();
   if (total_rects == 0) {
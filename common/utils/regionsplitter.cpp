@@ -0,0 +1,227 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "regionsplitter.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace hwcomposer {
+
+void RegionSplitter::Split(const std::vector<HwcRect<int>> &rects,
+                           const HwcRect<int> &damage_region) {
+  regions_.clear();
+  ids_.clear();
+  clipped_.clear();
+  clipped_ids_.clear();
+  x_edges_.clear();
+  open_cells_.clear();
+  open_bits_.clear();
+
+  size_t size = rects.size();
+  words_ = std::max<uint32_t>((size + 63) / 64, 1);
+  for (size_t i = 0; i < size; i++) {
+    const HwcRect<int> &rect = rects[i];
+    HwcRect<int> clipped(std::max(damage_region.left, rect.left),
+                         std::max(damage_region.top, rect.top),
+                         std::min(damage_region.right, rect.right),
+                         std::min(damage_region.bottom, rect.bottom));
+    // Filter out empty or invalid rects and the ones outside the damage
+    // region.
+    if (clipped.left >= clipped.right || clipped.top >= clipped.bottom)
+      continue;
+
+    clipped_.emplace_back(clipped);
+    clipped_ids_.emplace_back(i);
+    x_edges_.emplace_back(clipped.left);
+    x_edges_.emplace_back(clipped.right);
+  }
+
+  std::sort(x_edges_.begin(), x_edges_.end());
+  x_edges_.erase(std::unique(x_edges_.begin(), x_edges_.end()),
+                 x_edges_.end());
+
+  size_t num_clipped = clipped_.size();
+  by_left_.resize(num_clipped);
+  by_right_.resize(num_clipped);
+  for (size_t i = 0; i < num_clipped; i++) {
+    by_left_[i] = i;
+    by_right_[i] = i;
+  }
+
+  std::sort(by_left_.begin(), by_left_.end(), [this](uint32_t a, uint32_t b) {
+    return clipped_[a].left < clipped_[b].left;
+  });
+  std::sort(by_right_.begin(), by_right_.end(), [this](uint32_t a, uint32_t b) {
+    return clipped_[a].right < clipped_[b].right;
+  });
+
+  // Sweep through the vertical slabs between consecutive x edges. Inside a
+  // slab the set of covering rectangles changes only along y.
+  y_events_.clear();
+  next_start_ = 0;
+  next_end_ = 0;
+  size_t num_slabs = x_edges_.empty() ? 0 : x_edges_.size() - 1;
+  for (size_t i = 0; i < num_slabs; i++) {
+    UpdateYEvents(x_edges_[i]);
+    SplitSlab(x_edges_[i]);
+  }
+
+  for (const Cell &cell : open_cells_) {
+    EmitRegion(cell, x_edges_.back());
+  }
+
+  open_cells_.clear();
+}
+
+void RegionSplitter::UpdateYEvents(int x) {
+  // Drop rectangles which end at x.
+  size_t num_clipped = clipped_.size();
+  if (next_end_ < num_clipped && clipped_[by_right_[next_end_]].right == x) {
+    ending_bits_.assign(words_, 0);
+    for (; next_end_ < num_clipped &&
+           clipped_[by_right_[next_end_]].right == x;
+         next_end_++) {
+      uint32_t id = clipped_ids_[by_right_[next_end_]];
+      ending_bits_[id / 64] |= ((uint64_t)1) << (id % 64);
+    }
+
+    y_events_.erase(
+        std::remove_if(y_events_.begin(), y_events_.end(),
+                       [this](const YEvent &event) {
+                         return ending_bits_[event.id / 64] &
+                                (((uint64_t)1) << (event.id % 64));
+                       }),
+        y_events_.end());
+  }
+
+  // Add rectangles which start at x.
+  for (; next_start_ < num_clipped &&
+         clipped_[by_left_[next_start_]].left == x;
+       next_start_++) {
+    const HwcRect<int> &rect = clipped_[by_left_[next_start_]];
+    uint32_t id = clipped_ids_[by_left_[next_start_]];
+    YEvent top{rect.top, id};
+    YEvent bottom{rect.bottom, id};
+    y_events_.insert(
+        std::upper_bound(y_events_.begin(), y_events_.end(), top), top);
+    y_events_.insert(
+        std::upper_bound(y_events_.begin(), y_events_.end(), bottom), bottom);
+  }
+}
+
+void RegionSplitter::SplitSlab(int left) {
+  // Every rectangle has exactly one event at its top and one at its
+  // bottom, so toggling its bit maintains the set of active rectangles.
+  slab_cells_.clear();
+  slab_bits_.clear();
+  active_bits_.assign(words_, 0);
+  size_t num_events = y_events_.size();
+  size_t event = 0;
+  while (event < num_events) {
+    int y = y_events_[event].y;
+    while (event < num_events && y_events_[event].y == y) {
+      uint32_t id = y_events_[event].id;
+      active_bits_[id / 64] ^= ((uint64_t)1) << (id % 64);
+      event++;
+    }
+
+    if (event == num_events || IsEmpty(active_bits_.data()))
+      continue;
+
+    int bottom = y_events_[event].y;
+    // Grow previous cell if it is covered by the same rectangles.
+    if (!slab_cells_.empty()) {
+      Cell &last = slab_cells_.back();
+      if (last.bottom == y &&
+          IsEqual(slab_bits_.data() + last.bits, active_bits_.data())) {
+        last.bottom = bottom;
+        continue;
+      }
+    }
+
+    slab_cells_.emplace_back(
+        Cell{left, y, bottom, static_cast<uint32_t>(slab_bits_.size())});
+    slab_bits_.insert(slab_bits_.end(), active_bits_.begin(),
+                      active_bits_.end());
+  }
+
+  // Cells of the previous slab which line up with a cell of this slab and
+  // are covered by the same rectangles continue into it, the others are
+  // done. Both lists are sorted by top and don't overlap.
+  size_t num_open = open_cells_.size();
+  size_t open = 0;
+  for (Cell &cell : slab_cells_) {
+    while (open < num_open && open_cells_[open].top < cell.top) {
+      EmitRegion(open_cells_[open], left);
+      open++;
+    }
+
+    if (open < num_open && open_cells_[open].top == cell.top) {
+      const Cell &open_cell = open_cells_[open];
+      if (open_cell.bottom == cell.bottom &&
+          IsEqual(open_bits_.data() + open_cell.bits,
+                  slab_bits_.data() + cell.bits)) {
+        cell.left = open_cell.left;
+      } else {
+        EmitRegion(open_cell, left);
+      }
+
+      open++;
+    }
+  }
+
+  for (; open < num_open; open++) {
+    EmitRegion(open_cells_[open], left);
+  }
+
+  open_cells_.swap(slab_cells_);
+  open_bits_.swap(slab_bits_);
+}
+
+void RegionSplitter::EmitRegion(const Cell &cell, int right) {
+  Region region;
+  region.rect = HwcRect<int>(cell.left, cell.top, right, cell.bottom);
+  region.ids_offset = ids_.size();
+  const uint64_t *bits = open_bits_.data() + cell.bits;
+  for (uint32_t word = 0; word < words_; word++) {
+    uint64_t value = bits[word];
+    while (value) {
+      uint32_t bit = __builtin_ctzll(value);
+      ids_.emplace_back(word * 64 + bit);
+      value &= value - 1;
+    }
+  }
+
+  region.ids_count = ids_.size() - region.ids_offset;
+  regions_.emplace_back(region);
+}
+
+bool RegionSplitter::IsEmpty(const uint64_t *bits) const {
+  for (uint32_t word = 0; word < words_; word++) {
+    if (bits[word])
+      return false;
+  }
+
+  return true;
+}
+
+bool RegionSplitter::IsEqual(const uint64_t *lhs, const uint64_t *rhs) const {
+  return !memcmp(lhs, rhs, words_ * sizeof(uint64_t));
+}
+
+}  // namespace hwcomposer
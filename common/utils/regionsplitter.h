@@ -0,0 +1,112 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_REGIONSPLITTER_H_
+#define COMMON_UTILS_REGIONSPLITTER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <hwcdefs.h>
+
+namespace hwcomposer {
+
+// Splits a set of, possibly overlapping, rectangles into disjoint regions
+// and tells which of the input rectangles cover each region. There is no
+// limit on the number of input rectangles. All the state lives in flat
+// arrays which are re-used between calls to Split, so nothing is allocated
+// once they have grown to fit the usual layer stacks.
+class RegionSplitter {
+ public:
+  struct Region {
+    HwcRect<int> rect;
+    // Indices of the input rectangles covering rect, in ascending order,
+    // are stored at GetIds(region)[0 ... ids_count - 1].
+    uint32_t ids_offset;
+    uint32_t ids_count;
+  };
+
+  RegionSplitter() = default;
+  RegionSplitter(const RegionSplitter &) = delete;
+  RegionSplitter &operator=(const RegionSplitter &) = delete;
+
+  // Replaces result of the previous call with the regions of rects which
+  // lie inside damage_region. Empty rectangles are ignored.
+  void Split(const std::vector<HwcRect<int>> &rects,
+             const HwcRect<int> &damage_region);
+
+  const std::vector<Region> &GetRegions() const {
+    return regions_;
+  }
+
+  const uint32_t *GetIds(const Region &region) const {
+    return ids_.data() + region.ids_offset;
+  }
+
+ private:
+  // Part of a vertical slab covered by the same set of rectangles. bits is
+  // the offset of the set in the bitset pool of the slab.
+  struct Cell {
+    int left;
+    int top;
+    int bottom;
+    uint32_t bits;
+  };
+
+  struct YEvent {
+    int y;
+    uint32_t id;
+
+    bool operator<(const YEvent &rhs) const {
+      return y < rhs.y;
+    }
+  };
+
+  void UpdateYEvents(int x);
+  void SplitSlab(int left);
+  void EmitRegion(const Cell &cell, int right);
+  bool IsEmpty(const uint64_t *bits) const;
+  bool IsEqual(const uint64_t *lhs, const uint64_t *rhs) const;
+
+  // Number of 64 bit words in a rectangle set.
+  uint32_t words_ = 0;
+  // Input rectangles clipped to the damage region.
+  std::vector<HwcRect<int>> clipped_;
+  std::vector<uint32_t> clipped_ids_;
+  std::vector<int> x_edges_;
+  // Indices into clipped_ sorted by left and right edge.
+  std::vector<uint32_t> by_left_;
+  std::vector<uint32_t> by_right_;
+  size_t next_start_ = 0;
+  size_t next_end_ = 0;
+  // Top and bottom edges of the rectangles crossing the current slab,
+  // sorted by y.
+  std::vector<YEvent> y_events_;
+  std::vector<uint64_t> ending_bits_;
+  std::vector<uint64_t> active_bits_;
+  // Cells of the previous slab which can still grow to the right.
+  std::vector<Cell> open_cells_;
+  std::vector<uint64_t> open_bits_;
+  // Cells of the slab being split.
+  std::vector<Cell> slab_cells_;
+  std::vector<uint64_t> slab_bits_;
+  std::vector<Region> regions_;
+  std::vector<uint32_t> ids_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_REGIONSPLITTER_H_
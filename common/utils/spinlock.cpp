@@ -0,0 +1,79 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include <spinlock.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace hwcomposer {
+
+// Most critical sections guarded by SpinLock are a few hundred cycles
+// long, spinning for about as long avoids parking in the common case.
+static const int kMaxSpins = 128;
+
+static_assert(sizeof(std::atomic<int>) == sizeof(int),
+              "futex needs to operate on the lock state directly");
+
+static inline void CpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#else
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+static inline long Futex(std::atomic<int>* address, int op, int value) {
+  return syscall(SYS_futex, reinterpret_cast<int*>(address), op, value, NULL,
+                 NULL, 0);
+}
+
+SpinLock::Stats SpinLock::GetStats() const {
+  Stats stats;
+  stats.contended = contended_.load(std::memory_order_relaxed);
+  stats.parked = parked_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void SpinLock::LockContended() {
+  contended_.fetch_add(1, std::memory_order_relaxed);
+  for (int i = 0; i < kMaxSpins; i++) {
+    CpuRelax();
+    if (state_.load(std::memory_order_relaxed) != kUnlocked)
+      continue;
+
+    int expected = kUnlocked;
+    if (state_.compare_exchange_weak(expected, kLocked,
+                                     std::memory_order_acquire))
+      return;
+  }
+
+  // Lock is taken as kLockedWithWaiters from here on, as we can't know
+  // whether other threads are still parked. Worst case unlock makes a
+  // redundant wake up call.
+  while (state_.exchange(kLockedWithWaiters, std::memory_order_acquire) !=
+         kUnlocked) {
+    parked_.fetch_add(1, std::memory_order_relaxed);
+    Futex(&state_, FUTEX_WAIT_PRIVATE, kLockedWithWaiters);
+  }
+}
+
+void SpinLock::WakeWaiter() {
+  Futex(&state_, FUTEX_WAKE_PRIVATE, 1);
+}
+
+}  // namespace hwcomposer
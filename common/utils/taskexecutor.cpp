@@ -0,0 +1,230 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "taskexecutor.h"
+
+#include <algorithm>
+
+#include <hwcutils.h>
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+// Enough to keep work of two displays apart, while staying cheap on
+// embedded targets.
+static const size_t kNumWorkers = 2;
+
+TaskExecutor::Completion::Completion(Task* task, bool can_run_inline)
+    : task_(task), can_run_inline_(can_run_inline), state_(kQueued) {
+}
+
+TaskExecutor::Completion::~Completion() {
+}
+
+void TaskExecutor::Completion::Wait() {
+  if (can_run_inline_ && Run(true)) {
+    TaskExecutor::GetInstance().RecordTask(true, false);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(done_mutex_);
+  done_.wait(lock, [this] { return IsDone(); });
+}
+
+bool TaskExecutor::Completion::Run(bool inline_run) {
+  int expected = kQueued;
+  if (!state_.compare_exchange_strong(expected, kRunning,
+                                      std::memory_order_acquire))
+    return false;
+
+  ITRACE("Running task %p %s", task_, inline_run ? "inline" : "on worker");
+  task_->Run();
+  done_mutex_.lock();
+  state_.store(kDone, std::memory_order_release);
+  done_mutex_.unlock();
+  done_.notify_all();
+  return true;
+}
+
+TaskExecutor::Worker::Worker(TaskExecutor* executor)
+    : HWCThread(-8, "TaskWorker"), executor_(executor) {
+}
+
+TaskExecutor::Worker::~Worker() {
+  // Make sure HandleRoutine doesn't run while members are destroyed.
+  Exit();
+}
+
+bool TaskExecutor::Worker::Start() {
+  if (!InitWorker()) {
+    ETRACE("Failed to initalize thread for TaskExecutor. %s", PRINTERROR());
+    return false;
+  }
+
+  return true;
+}
+
+void TaskExecutor::Worker::Queue(const QueuedTask& task) {
+  lock_.lock();
+  queue_.emplace_back(task);
+  std::push_heap(queue_.begin(), queue_.end(), TaskExecutor::RunsLater);
+  lock_.unlock();
+  Resume();
+}
+
+size_t TaskExecutor::Worker::GetQueuedTasks() {
+  ScopedSpinLock lock(lock_);
+  return queue_.size();
+}
+
+void TaskExecutor::Worker::HandleRoutine() {
+  while (true) {
+    lock_.lock();
+    if (queue_.empty()) {
+      lock_.unlock();
+      return;
+    }
+
+    std::pop_heap(queue_.begin(), queue_.end(), TaskExecutor::RunsLater);
+    QueuedTask task = queue_.back();
+    queue_.pop_back();
+    lock_.unlock();
+    executor_->RunTask(task);
+  }
+}
+
+TaskExecutor& TaskExecutor::GetInstance() {
+  static TaskExecutor executor;
+  return executor;
+}
+
+TaskExecutor::TaskExecutor() : workers_(kNumWorkers) {
+}
+
+std::shared_ptr<TaskExecutor::Completion> TaskExecutor::Post(
+    Task* task, Priority priority, uint64_t deadline_ns, uint32_t affinity) {
+  std::shared_ptr<Completion> completion =
+      std::make_shared<Completion>(task, affinity == kNoAffinity);
+  Worker* worker = GetWorker(affinity);
+  if (!worker) {
+    // Nobody else can run it, Wait would block forever for tasks with an
+    // affinity.
+    if (completion->Run(true))
+      RecordTask(true, false);
+
+    return completion;
+  }
+
+  QueuedTask queued;
+  queued.completion = completion;
+  queued.deadline_ns = deadline_ns;
+  queued.priority = priority;
+  lock_.lock();
+  queued.sequence = sequence_++;
+  lock_.unlock();
+  worker->Queue(queued);
+  return completion;
+}
+
+TaskExecutor::Stats TaskExecutor::GetStats() {
+  ScopedSpinLock lock(lock_);
+  return stats_;
+}
+
+TaskExecutor::Worker* TaskExecutor::GetWorker(uint32_t affinity) {
+  ScopedSpinLock lock(lock_);
+  size_t index = 0;
+  if (affinity != kNoAffinity) {
+    index = affinity % kNumWorkers;
+  } else {
+    // Prefer an idle worker, then a new one, then the least busy one.
+    size_t min_queued = 0;
+    bool found = false;
+    for (size_t i = 0; i < kNumWorkers; i++) {
+      if (!workers_[i]) {
+        if (!start_failed_) {
+          index = i;
+          break;
+        }
+
+        continue;
+      }
+
+      size_t queued_tasks = workers_[i]->GetQueuedTasks();
+      if (!found || queued_tasks < min_queued) {
+        index = i;
+        min_queued = queued_tasks;
+        found = true;
+      }
+
+      if (!queued_tasks)
+        break;
+    }
+  }
+
+  if (!workers_[index]) {
+    if (start_failed_)
+      return NULL;
+
+    std::unique_ptr<Worker> worker(new Worker(this));
+    if (!worker->Start()) {
+      start_failed_ = true;
+      return NULL;
+    }
+
+    workers_[index] = std::move(worker);
+  }
+
+  return workers_[index].get();
+}
+
+bool TaskExecutor::RunsLater(const QueuedTask& lhs, const QueuedTask& rhs) {
+  if (lhs.priority != rhs.priority)
+    return lhs.priority < rhs.priority;
+
+  // Tasks without deadline run after the ones with a deadline.
+  if (lhs.deadline_ns != rhs.deadline_ns) {
+    if (!lhs.deadline_ns)
+      return true;
+
+    if (!rhs.deadline_ns)
+      return false;
+
+    return lhs.deadline_ns > rhs.deadline_ns;
+  }
+
+  return lhs.sequence > rhs.sequence;
+}
+
+void TaskExecutor::RunTask(const QueuedTask& task) {
+  bool missed_deadline =
+      task.deadline_ns && GetMonotonicTimeNs() > task.deadline_ns;
+  if (task.completion->Run(false))
+    RecordTask(false, missed_deadline);
+}
+
+void TaskExecutor::RecordTask(bool inline_run, bool missed_deadline) {
+  ScopedSpinLock lock(lock_);
+  stats_.tasks++;
+  if (inline_run)
+    stats_.inline_tasks++;
+
+  if (missed_deadline)
+    stats_.missed_deadlines++;
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,153 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef COMMON_UTILS_TASKEXECUTOR_H_
+#define COMMON_UTILS_TASKEXECUTOR_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <spinlock.h>
+
+#include "hwcthread.h"
+
+namespace hwcomposer {
+
+// Work which can be posted to TaskExecutor. The task needs to stay alive
+// till its completion has been signalled.
+class Task {
+ public:
+  virtual ~Task() {
+  }
+
+  virtual void Run() = 0;
+};
+
+// Runs tasks on a small pool of worker threads shared by the whole process.
+// Workers are started on first use, up to a fixed limit. Each worker
+// has a queue ordered by priority, then deadline, then posting order.
+// Tasks posted with the same affinity run on the same worker in order,
+// i.e. all work of a display can be kept serial. Tasks must not block for
+// long, as that holds up everything else queued on the worker.
+class TaskExecutor {
+ public:
+  enum Priority { kLow = 0, kNormal = 1, kHigh = 2 };
+
+  static const uint32_t kNoAffinity = 0xffffffff;
+
+  struct Stats {
+    uint64_t tasks = 0;
+    // Tasks run by a thread waiting for them instead of a worker.
+    uint64_t inline_tasks = 0;
+    // Tasks which started running after their deadline.
+    uint64_t missed_deadlines = 0;
+  };
+
+  // Tells when a posted task has run.
+  class Completion {
+   public:
+    Completion(Task* task, bool can_run_inline);
+    ~Completion();
+
+    bool IsDone() const {
+      return state_.load(std::memory_order_acquire) == kDone;
+    }
+
+    // Blocks till the task has run. If no worker has started the task yet
+    // and it has no affinity, it is run on the calling thread, saving the
+    // hand off to the worker.
+    void Wait();
+
+   private:
+    enum State { kQueued, kRunning, kDone };
+
+    friend class TaskExecutor;
+
+    // Returns false if the task has been claimed by someone else already.
+    bool Run(bool inline_run);
+
+    Task* task_;
+    bool can_run_inline_;
+    std::atomic<int> state_;
+    // Waiters block on done_ till state_ is kDone.
+    std::mutex done_mutex_;
+    std::condition_variable done_;
+  };
+
+  static TaskExecutor& GetInstance();
+
+  // Queues task. deadline_ns is the CLOCK_MONOTONIC time by which the task
+  // should have started, 0 if there is none. If no worker can be started,
+  // the task is run on the calling thread before returning.
+  std::shared_ptr<Completion> Post(Task* task, Priority priority = kNormal,
+                                   uint64_t deadline_ns = 0,
+                                   uint32_t affinity = kNoAffinity);
+
+  Stats GetStats();
+
+ private:
+  struct QueuedTask {
+    std::shared_ptr<Completion> completion;
+    uint64_t deadline_ns;
+    uint64_t sequence;
+    Priority priority;
+  };
+
+  class Worker : public HWCThread {
+   public:
+    Worker(TaskExecutor* executor);
+    ~Worker() override;
+
+    bool Start();
+    void Queue(const QueuedTask& task);
+    size_t GetQueuedTasks();
+
+   protected:
+    void HandleRoutine() override;
+
+   private:
+    TaskExecutor* executor_;
+    SpinLock lock_;
+    // Heap of tasks, see RunsLater.
+    std::vector<QueuedTask> queue_;
+  };
+
+  TaskExecutor();
+
+  // Comparator for the task heaps, true if lhs should run after rhs.
+  static bool RunsLater(const QueuedTask& lhs, const QueuedTask& rhs);
+
+  // Returns worker for affinity, starting workers as needed. Returns NULL
+  // if no worker could be started.
+  Worker* GetWorker(uint32_t affinity);
+  void RunTask(const QueuedTask& task);
+  void RecordTask(bool inline_run, bool missed_deadline);
+
+  // Fixed number of slots, NULL till the worker has been started.
+  std::vector<std::unique_ptr<Worker>> workers_;
+  bool start_failed_ = false;
+  SpinLock lock_;
+  uint64_t sequence_ = 0;
+  Stats stats_;
+};
+
+}  // namespace hwcomposer
+#endif  // COMMON_UTILS_TASKEXECUTOR_H_
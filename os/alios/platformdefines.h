@@ -106,6 +106,14 @@ inline uint32_t GetNativeBuffer(uint32_t gpu_fd, HWCNativeHandle handle) {
   return id;
 }
 
+// Layers re-use their handle for different gralloc buffers, whose fds and
+// handles may be recycled once freed. There is nothing identifying a
+// buffer without a syscall, so always look up the GEM handle.
+inline bool GetCachedNativeBuffer(HWCNativeHandle /*handle*/,
+                                  uint32_t* /*id*/) {
+  return false;
+}
+
 inline bool IsBufferProtected(HWCNativeHandle handle) {
   native_array_t* attrib_array = &native_handle->target_->attributes;
   if (attrib_array->data[4] & YALLOC_FLAG_PROTECTED) {
@@ -69,6 +69,14 @@ inline uint32_t GetNativeBuffer(uint32_t gpu_fd, HWCNativeHandle handle) {
   return id;
 }
 
+// Layers re-use their handle for different gralloc buffers, whose fds and
+// handles may be recycled once freed. There is nothing identifying a
+// buffer without a syscall, so always look up the GEM handle.
+inline bool GetCachedNativeBuffer(HWCNativeHandle /*handle*/,
+                                  uint32_t* /*id*/) {
+  return false;
+}
+
 inline bool IsBufferProtected(HWCNativeHandle handle) {
   auto gr_handle = (const struct cros_gralloc_handle*)handle->handle_;
   if (gr_handle->consumer_usage & GRALLOC1_PRODUCER_USAGE_PROTECTED) {
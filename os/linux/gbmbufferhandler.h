@@ -45,6 +45,9 @@ class GbmBufferHandler : public NativeBufferHandler {
   void *Map(HWCNativeHandle handle, uint32_t x, uint32_t y, uint32_t width,
             uint32_t height, uint32_t *stride, void **map_data,
             size_t plane) const override;
+  void *MapForRead(HWCNativeHandle handle, uint32_t x, uint32_t y,
+                   uint32_t width, uint32_t height, uint32_t *stride,
+                   void **map_data, size_t plane) const override;
   int32_t UnMap(HWCNativeHandle handle, void *map_data) const override;
   uint32_t GetFd() const override {
     return fd_;
@@ -477,31 +477,31 @@ IAHWC::IAHWCLayer::IAHWCLayer(PixelUploader* uploader)
 
 IAHWC::IAHWCLayer::~IAHWCLayer() {
   if (pixel_buffer_) {
-    const NativeBufferHandler* buffer_handler =
-        raw_data_uploader_->GetNativeBufferHandler();
-    if (upload_in_progress_) {
-      raw_data_uploader_->Synchronize();
-    }
-    buffer_handler->ReleaseBuffer(pixel_buffer_);
-    buffer_handler->DestroyHandle(pixel_buffer_);
-    pixel_buffer_ = NULL;
+    ReleasePixelBuffer();
   } else {
     ClosePrimeHandles();
   }
 }
 
+void IAHWC::IAHWCLayer::ReleasePixelBuffer() {
+  const NativeBufferHandler* buffer_handler =
+      raw_data_uploader_->GetNativeBufferHandler();
+  if (upload_in_progress_) {
+    raw_data_uploader_->Synchronize();
+  }
+
+  // Drop cached mapping before the prime fd can be re-used.
+  raw_data_uploader_->ReleaseMapping(pixel_buffer_);
+  buffer_handler->ReleaseBuffer(pixel_buffer_);
+  buffer_handler->DestroyHandle(pixel_buffer_);
+  pixel_buffer_ = NULL;
+}
+
 int IAHWC::IAHWCLayer::SetBo(gbm_bo* bo) {
   int32_t width, height;
 
   if (pixel_buffer_) {
-    const NativeBufferHandler* buffer_handler =
-        raw_data_uploader_->GetNativeBufferHandler();
-    if (upload_in_progress_) {
-      raw_data_uploader_->Synchronize();
-    }
-    buffer_handler->ReleaseBuffer(pixel_buffer_);
-    buffer_handler->DestroyHandle(pixel_buffer_);
-    pixel_buffer_ = NULL;
+    ReleasePixelBuffer();
   } else {
     ClosePrimeHandles();
   }
@@ -532,13 +532,7 @@ int IAHWC::IAHWCLayer::SetRawPixelData(iahwc_raw_pixel_data bo) {
   ClosePrimeHandles();
   if (pixel_buffer_ &&
       ((orig_height_ != bo.height) || (orig_stride_ != bo.stride))) {
-    if (upload_in_progress_) {
-      raw_data_uploader_->Synchronize();
-    }
-
-    buffer_handler->ReleaseBuffer(pixel_buffer_);
-    buffer_handler->DestroyHandle(pixel_buffer_);
-    pixel_buffer_ = NULL;
+    ReleasePixelBuffer();
   }
 
   if (!pixel_buffer_) {
@@ -594,11 +588,7 @@ int IAHWC::IAHWCLayer::SetLayerUsage(int32_t layer_usage) {
     }
 
     if (pixel_buffer_) {
-      const NativeBufferHandler* buffer_handler =
-          raw_data_uploader_->GetNativeBufferHandler();
-      buffer_handler->ReleaseBuffer(pixel_buffer_);
-      buffer_handler->DestroyHandle(pixel_buffer_);
-      pixel_buffer_ = NULL;
+      ReleasePixelBuffer();
     }
   }
 
@@ -63,6 +63,7 @@ class IAHWC : public iahwc_device {
 
    private:
     void ClosePrimeHandles();
+    void ReleasePixelBuffer();
     hwcomposer::HwcLayer iahwc_layer_;
     struct gbm_handle hwc_handle_;
     HWCNativeHandle pixel_buffer_ = NULL;
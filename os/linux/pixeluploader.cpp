@@ -44,8 +44,11 @@ struct dma_buf_sync {
   __u64 flags;
 };
 
+// Number of buffers which stay mapped between uploads.
+static const size_t kMaxCachedMappings = 16;
+
 PixelUploader::PixelUploader(const NativeBufferHandler* buffer_handler)
-    : HWCThread(-8, "PixelUploader"), buffer_handler_(buffer_handler) {
+    : buffer_handler_(buffer_handler) {
   if (!cevent_.Initialize())
     return;
 
@@ -54,12 +57,12 @@ PixelUploader::PixelUploader(const NativeBufferHandler* buffer_handler)
 }
 
 PixelUploader::~PixelUploader() {
+  UnmapAll();
 }
 
 void PixelUploader::Initialize() {
-  if (!InitWorker()) {
-    ETRACE("Failed to initalize PixelUploader. %s", PRINTERROR());
-  }
+  ScopedSpinLock lock(tasks_lock_);
+  running_ = true;
 }
 
 void PixelUploader::RegisterPixelUploaderCallback(
@@ -84,9 +87,22 @@ void PixelUploader::UpdateLayerPixelData(
   temp.surfaceDamage = surfaceDamage;
 
   tasks_lock_.lock();
-  tasks_ |= kRefreshRawPixelMap;
+  if (!running_) {
+    tasks_lock_.unlock();
+    pixel_data_lock_.unlock();
+    return;
+  }
+
+  // Upload already queued picks up the new data too.
+  if (!(tasks_ & kRefreshRawPixelMap)) {
+    tasks_ |= kRefreshRawPixelMap;
+    uint32_t affinity =
+        static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this) >> 4);
+    pending_upload_ = TaskExecutor::GetInstance().Post(
+        this, TaskExecutor::kHigh, 0, affinity);
+  }
+
   tasks_lock_.unlock();
-  Resume();
   pixel_data_lock_.unlock();
   Wait();
 }
@@ -96,15 +112,33 @@ void PixelUploader::Synchronize() {
   sync_lock_.unlock();
 }
 
-void PixelUploader::ExitThread() {
-  HWCThread::Exit();
-  std::vector<PixelData>().swap(pixel_data_);
+void PixelUploader::ReleaseMapping(HWCNativeHandle handle) {
+  ScopedSpinLock lock(sync_lock_);
+  for (auto it = mappings_.begin(); it != mappings_.end(); ++it) {
+    if (it->handle_ == handle) {
+      munmap(it->addr_, it->size_);
+      mappings_.erase(it);
+      return;
+    }
+  }
 }
 
-void PixelUploader::HandleExit() {
+void PixelUploader::ExitThread() {
+  tasks_lock_.lock();
+  running_ = false;
+  std::shared_ptr<TaskExecutor::Completion> pending_upload;
+  pending_upload.swap(pending_upload_);
+  tasks_lock_.unlock();
+  if (pending_upload)
+    pending_upload->Wait();
+
+  std::vector<PixelData>().swap(pixel_data_);
+  sync_lock_.lock();
+  UnmapAll();
+  sync_lock_.unlock();
 }
 
-void PixelUploader::HandleRoutine() {
+void PixelUploader::Run() {
   HandleRawPixelUpdate();
 }
 
@@ -154,8 +188,8 @@ void PixelUploader::HandleRawPixelUpdate() {
     }
 
     uint8_t* ptr = NULL;
-    size_t size = buffer.handle_->meta_data_.height_ *
-                  buffer.handle_->meta_data_.pitches_[0];
+    uint32_t pitch = buffer.handle_->meta_data_.pitches_[0];
+    size_t size = buffer.handle_->meta_data_.height_ * pitch;
     uint32_t prime_fd = buffer.handle_->meta_data_.prime_fds_[0];
 
     uint32_t mapStride = buffer.original_stride_;
@@ -165,21 +199,29 @@ void PixelUploader::HandleRawPixelUpdate() {
     uint32_t startx = x1 * bpp;
     uint32_t block_size = (x2 - x1) * bpp;
 
-    if (prime_fd > 0) {
-      ptr = (uint8_t*)Map(buffer.handle_->meta_data_.prime_fds_[0], size);
+    if (prime_fd > 0 && y2 > y1 && block_size) {
+      ptr = GetMapping(buffer.handle_, prime_fd, size);
     }
 
     if (!ptr) {
       // FIXME: Create texture and do texture upload.
-    } else {
-      for (int i = y1; i < y2; i++) {
-        memcpy(ptr + (i * buffer.handle_->meta_data_.pitches_[0] + startx),
-               buffer.data_ + (i * mapStride + startx), block_size);
+    } else if (SyncAccess(prime_fd, true)) {
+      if (pitch == mapStride) {
+        // Rows are laid out the same way in both buffers. Source has the
+        // whole image, so copy the damaged rows including the gaps
+        // between them at once.
+        size_t offset = y1 * pitch + startx;
+        memcpy(ptr + offset, buffer.data_ + offset,
+               (y2 - y1 - 1) * pitch + block_size);
+      } else {
+        for (uint32_t i = y1; i < y2; i++) {
+          memcpy(ptr + (i * pitch + startx),
+                 buffer.data_ + (i * mapStride + startx), block_size);
+        }
       }
-    }
 
-    if (ptr)
-      Unmap(buffer.handle_->meta_data_.prime_fds_[0], ptr, size);
+      SyncAccess(prime_fd, false);
+    }
 
     if (callback_) {
       // Notify everyone that we are done accessing this data.
@@ -194,31 +236,72 @@ void PixelUploader::HandleRawPixelUpdate() {
   sync_lock_.unlock();
 }
 
-void* PixelUploader::Map(uint32_t prime_fd, size_t size) {
+uint8_t* PixelUploader::GetMapping(HWCNativeHandle handle, uint32_t prime_fd,
+                                   size_t size) {
+  size_t count = mappings_.size();
+  for (size_t i = 0; i < count; i++) {
+    Mapping& mapping = mappings_[i];
+    if (mapping.handle_ != handle)
+      continue;
+
+    if (mapping.prime_fd_ != prime_fd || mapping.size_ != size) {
+      // Buffer has been re-allocated behind our back.
+      munmap(mapping.addr_, mapping.size_);
+      mappings_.erase(mappings_.begin() + i);
+      break;
+    }
+
+    uint8_t* addr = mapping.addr_;
+    if (i != count - 1) {
+      Mapping temp = mapping;
+      mappings_.erase(mappings_.begin() + i);
+      mappings_.emplace_back(temp);
+    }
+
+    return addr;
+  }
+
   void* addr =
       mmap(nullptr, size, (PROT_READ | PROT_WRITE), MAP_SHARED, prime_fd, 0);
-  if (addr == MAP_FAILED)
-    return nullptr;
-
-  struct dma_buf_sync sync_start = {0};
-  sync_start.flags = DMA_BUF_SYNC_START | DMA_BUF_SYNC_RW;
-  int rv = ioctl(prime_fd, DMA_BUF_IOCTL_SYNC, &sync_start);
-  if (rv) {
-    ETRACE("DMA_BUF_IOCTL_SYNC failed during Map \n");
-    munmap(addr, size);
-    return nullptr;
+  if (addr == MAP_FAILED) {
+    ETRACE("Failed to map buffer for pixel upload %s", PRINTERROR());
+    return NULL;
+  }
+
+  if (mappings_.size() >= kMaxCachedMappings) {
+    const Mapping& oldest = mappings_.front();
+    munmap(oldest.addr_, oldest.size_);
+    mappings_.erase(mappings_.begin());
+  }
+
+  mappings_.emplace_back();
+  Mapping& mapping = mappings_.back();
+  mapping.handle_ = handle;
+  mapping.prime_fd_ = prime_fd;
+  mapping.size_ = size;
+  mapping.addr_ = static_cast<uint8_t*>(addr);
+  return mapping.addr_;
+}
+
+void PixelUploader::UnmapAll() {
+  for (const Mapping& mapping : mappings_) {
+    munmap(mapping.addr_, mapping.size_);
   }
 
-  return addr;
+  std::vector<Mapping>().swap(mappings_);
 }
 
-void PixelUploader::Unmap(uint32_t prime_fd, void* addr, size_t size) {
-  if (addr) {
-    struct dma_buf_sync sync_start = {0};
-    sync_start.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_RW;
-    ioctl(prime_fd, DMA_BUF_IOCTL_SYNC, &sync_start);
-    munmap(addr, size);
+bool PixelUploader::SyncAccess(uint32_t prime_fd, bool start) {
+  // We only write to the buffer.
+  struct dma_buf_sync sync = {0};
+  sync.flags = (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END) |
+               DMA_BUF_SYNC_WRITE;
+  if (ioctl(prime_fd, DMA_BUF_IOCTL_SYNC, &sync)) {
+    ETRACE("DMA_BUF_IOCTL_SYNC failed %s", PRINTERROR());
+    return false;
   }
+
+  return true;
 }
 
 }  // namespace hwcomposer
@@ -24,10 +24,10 @@
 #include <vector>
 
 #include "factory.h"
-#include "hwcthread.h"
 
 #include "fdhandler.h"
 #include "hwcevent.h"
+#include "taskexecutor.h"
 
 namespace hwcomposer {
 
@@ -47,7 +47,9 @@ class PixelUploaderLayerCallback {
   virtual void UploadDone() = 0;
 };
 
-class PixelUploader : public HWCThread {
+// Uploads run on TaskExecutor. All uploads of an uploader are posted with
+// the same affinity, so they run in order.
+class PixelUploader : public Task {
  public:
   PixelUploader(const NativeBufferHandler* buffer_handler);
   ~PixelUploader() override;
@@ -67,12 +69,15 @@ class PixelUploader : public HWCThread {
     return buffer_handler_;
   }
 
-  void HandleRoutine() override;
-  void HandleExit() override;
+  void Run() override;
   void ExitThread();
 
   void Synchronize();
 
+  // Unmaps handle, if it has been mapped for an earlier upload. Needs to be
+  // called before handle is destroyed.
+  void ReleaseMapping(HWCNativeHandle handle);
+
  private:
   enum Tasks {
     kNone = 0,  // No tasks
@@ -91,9 +96,18 @@ class PixelUploader : public HWCThread {
     HwcRect<int> surfaceDamage;
   };
 
+  // Mapping of a buffer kept around across uploads.
+  struct Mapping {
+    HWCNativeHandle handle_;
+    uint32_t prime_fd_ = 0;
+    size_t size_ = 0;
+    uint8_t* addr_ = NULL;
+  };
+
   void HandleRawPixelUpdate();
-  void* Map(uint32_t prime_fd, size_t size);
-  void Unmap(uint32_t prime_fd, void* addr, size_t size);
+  uint8_t* GetMapping(HWCNativeHandle handle, uint32_t prime_fd, size_t size);
+  void UnmapAll();
+  bool SyncAccess(uint32_t prime_fd, bool start);
   void Wait();
 
   std::shared_ptr<RawPixelUploadCallback> callback_ = NULL;
@@ -101,7 +115,12 @@ class PixelUploader : public HWCThread {
   SpinLock pixel_data_lock_;
   SpinLock sync_lock_;
   std::vector<PixelData> pixel_data_;
+  // Most recently used mapping last. Accessed with sync_lock_ held.
+  std::vector<Mapping> mappings_;
   uint32_t tasks_ = kNone;
+  // Accessed with tasks_lock_ held.
+  std::shared_ptr<TaskExecutor::Completion> pending_upload_;
+  bool running_ = false;
   uint32_t gpu_fd_ = 0;
   FDHandler fd_chandler_;
   HWCEvent cevent_;
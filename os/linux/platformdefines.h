@@ -63,20 +63,40 @@ extern "C" {
 #define ETRACE(fmt, ...) fprintf(stderr, "%s: \n" fmt, __func__, ##__VA_ARGS__)
 #define STRACE() ((void)0)
 
-inline uint32_t GetNativeBuffer(uint32_t gpu_fd, HWCNativeHandle handle) {
-  uint32_t id = 0;
-  uint32_t prime_fd = -1;
+inline int GetNativeBufferPrimeFd(HWCNativeHandle handle) {
   if (!handle->meta_data_.fb_modifiers_[0]) {
-    prime_fd = handle->import_data.fd_data.fd;
-  } else {
-    prime_fd = handle->import_data.fd_modifier_data.fds[0];
+    return handle->import_data.fd_data.fd;
   }
+
+  return handle->import_data.fd_modifier_data.fds[0];
+}
+
+inline uint32_t GetNativeBuffer(uint32_t gpu_fd, HWCNativeHandle handle) {
+  uint32_t id = 0;
+  int prime_fd = GetNativeBufferPrimeFd(handle);
   if (drmPrimeFDToHandle(gpu_fd, prime_fd, &id)) {
     ETRACE("Error generate handle from prime fd %d", prime_fd);
+    return id;
   }
+
+  handle->meta_data_.native_buffer_id_ = id;
+  handle->meta_data_.native_buffer_fd_ = prime_fd;
   return id;
 }
 
+// Returns GEM handle found by an earlier GetNativeBuffer call for handle.
+// Frontend resets meta data of a gbm_handle whenever it attaches another
+// buffer to it, so this is valid as long as the prime fd didn't change.
+inline bool GetCachedNativeBuffer(HWCNativeHandle handle, uint32_t* id) {
+  const HwcMeta& meta = handle->meta_data_;
+  if (!meta.native_buffer_id_ ||
+      meta.native_buffer_fd_ != GetNativeBufferPrimeFd(handle))
+    return false;
+
+  *id = meta.native_buffer_id_;
+  return true;
+}
+
 inline bool IsBufferProtected(HWCNativeHandle handle) {
   return false;
 }
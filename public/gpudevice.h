@@ -23,6 +23,7 @@
 
 #include <stdint.h>
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <string>
 
@@ -112,6 +113,22 @@ class GpuDevice : public HWCThread {
 
   std::vector<uint32_t> GetDisplayReservedPlanes(uint32_t display_id);
 
+  // Layer counts for which compositor programs are prepared when a display
+  // is powered on.
+  const std::vector<uint32_t>& GetCompositorWarmUpLayers() const;
+
+  // Whether GPU composition of a frame runs in parallel with preparing its
+  // atomic commit.
+  bool IsAsyncCompositionEnabled() const;
+
+  // Time before the predicted vblank at which atomic commits are issued, 0
+  // if commits are issued as soon as a frame is ready.
+  uint32_t GetCommitLatchMarginUs() const;
+
+  // Whether the software compositor uses its plain C reference code instead
+  // of SIMD instructions. Output is the same, only slower.
+  bool IsSoftwareCompositorReferenceEnabled() const;
+
  private:
   GpuDevice();
 
@@ -129,6 +146,7 @@ class GpuDevice : public HWCThread {
   void HandleRoutine() override;
   void HandleWait() override;
   void ParsePlaneReserveSettings(std::string& value);
+  void ParseCompositorWarmUpSettings(std::string& value);
   std::unique_ptr<DisplayManager> display_manager_;
   std::vector<std::unique_ptr<LogicalDisplayManager>> logical_display_manager_;
   std::vector<std::unique_ptr<NativeDisplay>> mosaic_displays_;
@@ -191,6 +209,10 @@ class GpuDevice : public HWCThread {
   bool reserve_plane_ = false;
   bool enable_all_display_ = false;
   std::map<uint8_t, std::vector<uint32_t>> reserved_drm_display_planes_map_;
+  std::vector<uint32_t> compositor_warmup_layers_;
+  bool async_composition_ = false;
+  uint32_t commit_latch_margin_us_ = 0;
+  bool software_compositor_reference_ = false;
   uint32_t initialization_state_ = kUnInitialized;
   SpinLock initialization_state_lock_;
   SpinLock drm_master_lock_;
@@ -40,6 +40,10 @@ struct HwcMeta {
   uint32_t fb_modifiers_[8];
   uint32_t dataspace_ = 0;
   hwcomposer::HWCLayerType usage_ = hwcomposer::kLayerNormal;
+  // GEM handle looked up by GetNativeBuffer and the prime fd it was looked
+  // up for. Only used on platforms implementing GetCachedNativeBuffer.
+  uint32_t native_buffer_id_ = 0;
+  int native_buffer_fd_ = 0;
 };
 
 #endif  // PUBLIC_HWCMETA_H_
@@ -52,6 +52,14 @@ class NativeBufferHandler {
                     uint32_t width, uint32_t height, uint32_t *stride,
                     void **map_data, size_t plane) const = 0;
 
+  // Same as Map, for mappings which are only read from. Handlers which
+  // can't map buffers read-only map them for writing as well.
+  virtual void *MapForRead(HWCNativeHandle handle, uint32_t x, uint32_t y,
+                           uint32_t width, uint32_t height, uint32_t *stride,
+                           void **map_data, size_t plane) const {
+    return Map(handle, x, y, width, height, stride, map_data, plane);
+  }
+
   virtual int32_t UnMap(HWCNativeHandle handle, void *map_data) const = 0;
 
   virtual uint32_t GetFd() const = 0;
@@ -17,23 +17,56 @@
 #ifndef PUBLIC_SPINLOCK_H_
 #define PUBLIC_SPINLOCK_H_
 
+#include <stdint.h>
+
 #include <atomic>
 
 namespace hwcomposer {
 
+// Mutex which spins for a short while when contended and then parks the
+// thread in the kernel till the lock is released. Uncontended lock and
+// unlock are a single atomic operation each.
 class SpinLock {
  public:
+  struct Stats {
+    // Number of lock calls which found the lock held.
+    uint32_t contended;
+    // Number of times a thread was parked waiting for the lock.
+    uint32_t parked;
+  };
+
   void lock() {
-    while (atomic_lock_.test_and_set(std::memory_order_acquire)) {
-    }
+    int expected = kUnlocked;
+    if (!state_.compare_exchange_strong(expected, kLocked,
+                                        std::memory_order_acquire))
+      LockContended();
+  }
+
+  // Returns false instead of waiting if the lock is held.
+  bool try_lock() {
+    int expected = kUnlocked;
+    return state_.compare_exchange_strong(expected, kLocked,
+                                          std::memory_order_acquire);
   }
 
   void unlock() {
-    atomic_lock_.clear(std::memory_order_release);
+    if (state_.exchange(kUnlocked, std::memory_order_release) ==
+        kLockedWithWaiters)
+      WakeWaiter();
   }
 
+  // Contention statistics of this lock.
+  Stats GetStats() const;
+
  private:
-  std::atomic_flag atomic_lock_ = ATOMIC_FLAG_INIT;
+  enum State { kUnlocked = 0, kLocked = 1, kLockedWithWaiters = 2 };
+
+  void LockContended();
+  void WakeWaiter();
+
+  std::atomic<int> state_{kUnlocked};
+  std::atomic<uint32_t> contended_{0};
+  std::atomic<uint32_t> parked_{0};
 };
 
 class ScopedSpinLock {
@@ -80,6 +80,51 @@ LOCAL_PROPRIETARY_MODULE := true
 
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+
+LOCAL_CPPFLAGS += \
+	-fPIC -O2 \
+	-D_FORTIFY_SOURCE=2 \
+	-fstack-protector-strong \
+	-fPIE -Wformat -Wformat-security
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/../public \
+	$(LOCAL_PATH)/../common/utils
+
+LOCAL_SRC_FILES := \
+    ../common/utils/regionsplitter.cpp \
+    apps/regionsplitter_benchmark.cpp
+
+LOCAL_MODULE_TAGS := optional eng
+
+LOCAL_MODULE := regionsplitter_benchmark
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_CPPFLAGS += \
+	-fPIC -O2 \
+	-D_FORTIFY_SOURCE=2 \
+	-fstack-protector-strong \
+	-fPIE -Wformat -Wformat-security
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/../public
+
+LOCAL_SRC_FILES := \
+    ../common/utils/spinlock.cpp \
+    apps/spinlock_stress.cpp
+
+LOCAL_MODULE_TAGS := optional eng
+
+LOCAL_MODULE := spinlock_stress
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
 
 # To copy json files on the target
 # $1 is the *.sh file to copy
@@ -0,0 +1,184 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Times RegionSplitter::Split on stacks of random, overlapping rectangles
+// and checks each result against a brute force cover map. The time
+// includes turning every region into its list of layers, the same way
+// Compositor::SeparateLayers does.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <hwcdefs.h>
+
+#include "regionsplitter.h"
+
+using hwcomposer::HwcRect;
+using hwcomposer::RegionSplitter;
+
+static const int kAreaSize = 1920;
+
+static void GenerateRects(size_t count, std::mt19937 &generator,
+                          std::vector<HwcRect<int>> &rects) {
+  std::uniform_int_distribution<int> position(0, kAreaSize - 1);
+  rects.clear();
+  for (size_t i = 0; i < count; i++) {
+    int x0 = position(generator);
+    int x1 = position(generator);
+    int y0 = position(generator);
+    int y1 = position(generator);
+    rects.emplace_back(std::min(x0, x1), std::min(y0, y1),
+                       std::max(x0, x1) + 1, std::max(y0, y1) + 1);
+  }
+}
+
+// Every cell of the grid made by the rectangle edges must be part of
+// exactly one region if any rectangle covers it, and that region must list
+// exactly the rectangles covering the cell.
+static bool Verify(const std::vector<HwcRect<int>> &rects,
+                   const RegionSplitter &splitter) {
+  std::vector<int> xs;
+  std::vector<int> ys;
+  for (const HwcRect<int> &rect : rects) {
+    xs.emplace_back(rect.left);
+    xs.emplace_back(rect.right);
+    ys.emplace_back(rect.top);
+    ys.emplace_back(rect.bottom);
+  }
+
+  std::sort(xs.begin(), xs.end());
+  xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+  std::sort(ys.begin(), ys.end());
+  ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+  size_t columns = xs.size() - 1;
+  size_t rows = ys.size() - 1;
+  std::vector<int> owner(columns * rows, -1);
+  const std::vector<RegionSplitter::Region> &regions = splitter.GetRegions();
+  for (size_t i = 0; i < regions.size(); i++) {
+    const HwcRect<int> &rect = regions[i].rect;
+    size_t left =
+        std::lower_bound(xs.begin(), xs.end(), rect.left) - xs.begin();
+    size_t right =
+        std::lower_bound(xs.begin(), xs.end(), rect.right) - xs.begin();
+    size_t top = std::lower_bound(ys.begin(), ys.end(), rect.top) - ys.begin();
+    size_t bottom =
+        std::lower_bound(ys.begin(), ys.end(), rect.bottom) - ys.begin();
+    if (left >= right || top >= bottom || xs[left] != rect.left ||
+        xs[right] != rect.right || ys[top] != rect.top ||
+        ys[bottom] != rect.bottom) {
+      printf("Region %zu is not aligned to the rectangle edges.\n", i);
+      return false;
+    }
+
+    for (size_t y = top; y < bottom; y++) {
+      for (size_t x = left; x < right; x++) {
+        int &cell = owner[y * columns + x];
+        if (cell != -1) {
+          printf("Regions %d and %zu overlap.\n", cell, i);
+          return false;
+        }
+
+        cell = i;
+      }
+    }
+  }
+
+  std::vector<uint32_t> cover;
+  for (size_t y = 0; y < rows; y++) {
+    for (size_t x = 0; x < columns; x++) {
+      cover.clear();
+      for (size_t id = 0; id < rects.size(); id++) {
+        const HwcRect<int> &rect = rects[id];
+        if (rect.left <= xs[x] && xs[x] < rect.right && rect.top <= ys[y] &&
+            ys[y] < rect.bottom)
+          cover.emplace_back(id);
+      }
+
+      int cell = owner[y * columns + x];
+      if (cell == -1) {
+        if (!cover.empty()) {
+          printf("Cell (%d, %d) is covered but in no region.\n", xs[x], ys[y]);
+          return false;
+        }
+
+        continue;
+      }
+
+      const RegionSplitter::Region &region = regions[cell];
+      const uint32_t *ids = splitter.GetIds(region);
+      if (cover.size() != region.ids_count ||
+          !std::equal(cover.begin(), cover.end(), ids)) {
+        printf("Region %d lists the wrong rectangles.\n", cell);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = 100;
+  if (argc > 1)
+    iterations = std::max(atoi(argv[1]), 1);
+
+  const size_t kCounts[] = {8, 32, 64, 256};
+  HwcRect<int> damage(0, 0, kAreaSize, kAreaSize);
+  RegionSplitter splitter;
+  std::vector<HwcRect<int>> rects;
+  std::vector<size_t> region_layers;
+  std::mt19937 generator(1);
+  bool success = true;
+  for (size_t count : kCounts) {
+    GenerateRects(count, generator, rects);
+    splitter.Split(rects, damage);
+    if (!Verify(rects, splitter)) {
+      printf("%3zu rects: verification failed\n", count);
+      success = false;
+      continue;
+    }
+
+    size_t layers = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      splitter.Split(rects, damage);
+      for (const RegionSplitter::Region &region : splitter.GetRegions()) {
+        const uint32_t *ids = splitter.GetIds(region);
+        region_layers.clear();
+        for (size_t id = region.ids_count; id > 0; id--)
+          region_layers.emplace_back(ids[id - 1]);
+
+        layers += region_layers.size();
+      }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double us =
+        std::chrono::duration<double, std::micro>(end - start).count() /
+        iterations;
+    printf("%3zu rects: %10.1fus / %zu regions, %zu layer entries\n", count,
+           us, splitter.GetRegions().size(), layers / iterations);
+  }
+
+  return success ? 0 : 1;
+}
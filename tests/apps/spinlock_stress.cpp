@@ -0,0 +1,165 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Contention stress test for SpinLock. A number of threads increment a
+// shared counter under the lock, with some busy work inside and outside of
+// the critical section. The result is checked for lost updates and wall
+// and cpu time are compared with a plain busy waiting lock, which is how
+// SpinLock used to be implemented.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <spinlock.h>
+
+using hwcomposer::SpinLock;
+
+namespace {
+
+class BusyLock {
+ public:
+  void lock() {
+    while (flag_.test_and_set(std::memory_order_acquire)) {
+    }
+  }
+
+  void unlock() {
+    flag_.clear(std::memory_order_release);
+  }
+
+ private:
+  std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+};
+
+struct Config {
+  int threads;
+  int critical_work;
+  int outside_work;
+};
+
+struct Result {
+  double wall_s;
+  double cpu_s;
+  uint64_t counter;
+};
+
+static volatile uint32_t sink;
+
+static void BusyWork(int amount) {
+  for (int i = 0; i < amount; i++)
+    sink = sink + 1;
+}
+
+static double GetTime(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <typename Lock>
+Result Run(const Config &config, int iterations) {
+  Lock lock;
+  uint64_t counter = 0;
+  std::vector<std::thread> threads;
+  double wall = GetTime(CLOCK_MONOTONIC);
+  double cpu = GetTime(CLOCK_PROCESS_CPUTIME_ID);
+  for (int i = 0; i < config.threads; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < iterations; j++) {
+        lock.lock();
+        counter++;
+        BusyWork(config.critical_work);
+        lock.unlock();
+        BusyWork(config.outside_work);
+      }
+    });
+  }
+
+  for (std::thread &thread : threads)
+    thread.join();
+
+  Result result;
+  result.wall_s = GetTime(CLOCK_MONOTONIC) - wall;
+  result.cpu_s = GetTime(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+  result.counter = counter;
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int iterations = 2000;
+  if (argc > 1)
+    iterations = std::max(atoi(argv[1]), 1);
+
+  const Config kConfigs[] = {{4, 50, 200},
+                             {8, 50, 200},
+                             {4, 5000, 5000},
+                             {8, 5000, 5000},
+                             {16, 5000, 1000}};
+  bool success = true;
+  printf("threads  cs/out work  busy wall/cpu s  SpinLock wall/cpu s\n");
+  for (const Config &config : kConfigs) {
+    uint64_t expected = (uint64_t)config.threads * iterations;
+    Result busy = Run<BusyLock>(config, iterations);
+    Result spin = Run<SpinLock>(config, iterations);
+    printf("%-8d %4d/%-8d %7.2f/%-8.2f %7.2f/%.2f\n", config.threads,
+           config.critical_work, config.outside_work, busy.wall_s, busy.cpu_s,
+           spin.wall_s, spin.cpu_s);
+    if (busy.counter != expected || spin.counter != expected) {
+      printf("Lost updates: expected %llu, got %llu and %llu.\n",
+             (unsigned long long)expected, (unsigned long long)busy.counter,
+             (unsigned long long)spin.counter);
+      success = false;
+    }
+  }
+
+  // try_lock must fail while the lock is held and stats must count the
+  // contended acquisitions.
+  SpinLock lock;
+  lock.lock();
+  if (lock.try_lock()) {
+    printf("try_lock succeeded on a held lock.\n");
+    success = false;
+  }
+
+  std::thread waiter([&lock]() {
+    lock.lock();
+    lock.unlock();
+  });
+
+  while (!lock.GetStats().contended)
+    std::this_thread::yield();
+
+  lock.unlock();
+  waiter.join();
+  SpinLock::Stats stats = lock.GetStats();
+  printf("contended %u, parked %u\n", stats.contended, stats.parked);
+  if (!lock.try_lock()) {
+    printf("try_lock failed on a free lock.\n");
+    success = false;
+  }
+
+  lock.unlock();
+  return success ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Checks that the row operations of the software compositor picked for
+// this cpu produce the same pixels as the reference C version, which
+// SOFTWARE_COMPOSITOR_REFERENCE in hwc_display.ini selects. Rows of random
+// layers are unpacked, blended from top to bottom and packed again with
+// both versions, for all pixel orders, blending modes and odd widths.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "swkernels.h"
+
+using hwcomposer::SWKernels;
+
+static const uint32_t kMaxWidth = 67;
+static const uint32_t kNumLayers = 4;
+
+struct Rows {
+  explicit Rows(uint32_t width) : data(8 * width) {
+    for (int i = 0; i < 4; i++) {
+      acc[i] = data.data() + i * width;
+      src[i] = data.data() + (4 + i) * width;
+    }
+  }
+
+  std::vector<float> data;
+  float *acc[4];
+  float *src[4];
+};
+
+// Blends layers into a row of width pixels with kernels and packs it to
+// output.
+static void Compose(const SWKernels &kernels,
+                    const std::vector<std::vector<uint8_t>> &layers,
+                    const float *alpha, const float *premult, uint32_t width,
+                    bool bgra, bool opaque, uint8_t *output) {
+  Rows rows(width);
+  std::fill(rows.acc[0], rows.acc[0] + 3 * width, 0.0f);
+  std::fill(rows.acc[3], rows.acc[3] + width, 1.0f);
+  for (uint32_t i = 0; i < layers.size(); i++) {
+    kernels.unpack(layers[i].data(), width, bgra, opaque, rows.src);
+    kernels.blend(rows.src, alpha[i], premult[i], rows.acc, width);
+  }
+
+  kernels.pack(rows.acc, width, bgra, output);
+}
+
+int main() {
+  const SWKernels &reference = SWKernels::Get(true);
+  const SWKernels &fastest = SWKernels::Get(false);
+  if (&reference == &fastest)
+    printf("No SIMD version for this cpu, checking C against itself.\n");
+
+  std::mt19937 generator(1);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<std::vector<uint8_t>> layers(kNumLayers);
+  std::vector<uint8_t> expected(4 * kMaxWidth);
+  std::vector<uint8_t> output(4 * kMaxWidth);
+  uint32_t failures = 0;
+  uint32_t runs = 0;
+  for (uint32_t width = 1; width <= kMaxWidth; width++) {
+    for (int mode = 0; mode < 4; mode++) {
+      bool bgra = mode & 1;
+      bool opaque = mode & 2;
+      float alpha[kNumLayers];
+      float premult[kNumLayers];
+      for (uint32_t i = 0; i < kNumLayers; i++) {
+        layers[i].resize(4 * width);
+        for (uint8_t &value : layers[i])
+          value = byte(generator);
+
+        alpha[i] = (i % 2) ? byte(generator) / 255.0f : 1.0f;
+        premult[i] = (i + mode) % 2 ? 1.0f : 0.0f;
+      }
+
+      Compose(reference, layers, alpha, premult, width, bgra, opaque,
+              expected.data());
+      Compose(fastest, layers, alpha, premult, width, bgra, opaque,
+              output.data());
+      runs++;
+      if (memcmp(expected.data(), output.data(), 4 * width)) {
+        printf("Mismatch for width %u, bgra %d, opaque %d.\n", width, bgra,
+               opaque);
+        failures++;
+      }
+    }
+  }
+
+  printf("%u of %u rows differ from the reference.\n", failures, runs);
+  return failures ? 1 : 0;
+}
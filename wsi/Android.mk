@@ -56,9 +56,12 @@ LOCAL_SRC_FILES := \
         physicaldisplay.cpp \
         drm/drmdisplay.cpp \
         drm/drmbuffer.cpp \
+        drm/drmformattable.cpp \
         drm/drmplane.cpp \
+        drm/drmpropertyregistry.cpp \
         drm/drmdisplaymanager.cpp \
-	drm/drmscopedtypes.cpp
+	drm/drmscopedtypes.cpp \
+	drm/drmtestcommitcache.cpp
 
 ifeq ($(strip $(ENABLE_HYPER_DMABUF_SHARING)), true)
 LOCAL_CPPFLAGS += -DHYPER_DMABUF_SHARING
@@ -35,6 +35,13 @@ class DisplayPlane {
 
   virtual bool IsSupportedFormat(uint32_t format) = 0;
 
+  /**
+   * API for querying if buffers of format using modifier can
+   * be scanned out by this plane. Should return true if this
+   * isn't known.
+   */
+  virtual bool IsSupportedModifier(uint64_t modifier, uint32_t format) = 0;
+
   /**
    * API for querying if transform is supported by this
    * plane.
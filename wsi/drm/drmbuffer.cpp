@@ -52,6 +52,116 @@
 
 namespace hwcomposer {
 
+#if defined(USE_VK) && defined(VK_EXT_image_drm_format_modifier)
+// Imports the first plane of meta with the standard dma-buf extensions,
+// for drivers without VK_INTEL_dma_buf_image like lavapipe. VKRenderer
+// enables the extensions when the device supports them.
+static VkResult ImportDmaBufImage(VkDevice dev, const HwcMeta &meta,
+                                  VkFormat vk_format, ResourceHandle &image) {
+  PFN_vkGetMemoryFdPropertiesKHR vkGetMemoryFdPropertiesKHR =
+      (PFN_vkGetMemoryFdPropertiesKHR)vkGetDeviceProcAddr(
+          dev, "vkGetMemoryFdPropertiesKHR");
+  if (vkGetMemoryFdPropertiesKHR == NULL) {
+    ETRACE("vkGetDeviceProcAddr(\"vkGetMemoryFdPropertiesKHR\") failed\n");
+    return VK_ERROR_EXTENSION_NOT_PRESENT;
+  }
+
+  VkSubresourceLayout plane_layout = {};
+  plane_layout.offset = meta.offsets_[0];
+  plane_layout.rowPitch = meta.pitches_[0];
+
+  VkImageDrmFormatModifierExplicitCreateInfoEXT modifier_create = {};
+  modifier_create.sType =
+      VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT;
+  modifier_create.drmFormatModifier =
+      (uint64_t)meta.fb_modifiers_[1] << 32 | meta.fb_modifiers_[0];
+  modifier_create.drmFormatModifierPlaneCount = 1;
+  modifier_create.pPlaneLayouts = &plane_layout;
+
+  VkExternalMemoryImageCreateInfo external_create = {};
+  external_create.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO;
+  external_create.pNext = &modifier_create;
+  external_create.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+  VkImageCreateInfo image_create = {};
+  image_create.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create.pNext = &external_create;
+  image_create.imageType = VK_IMAGE_TYPE_2D;
+  image_create.format = vk_format;
+  image_create.extent.width = meta.width_;
+  image_create.extent.height = meta.height_;
+  image_create.extent.depth = 1;
+  image_create.mipLevels = 1;
+  image_create.arrayLayers = 1;
+  image_create.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_create.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+  image_create.usage =
+      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  image_create.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_create.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VkImage vk_image;
+  VkResult res = vkCreateImage(dev, &image_create, NULL, &vk_image);
+  if (res != VK_SUCCESS) {
+    ETRACE("vkCreateImage failed (%d)\n", res);
+    return res;
+  }
+
+  // The driver owns the fd once the import succeeded.
+  int fd = dup(meta.prime_fds_[0]);
+  VkMemoryFdPropertiesKHR fd_props = {};
+  fd_props.sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR;
+  res = vkGetMemoryFdPropertiesKHR(
+      dev, VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT, fd, &fd_props);
+  VkMemoryRequirements mem_reqs;
+  vkGetImageMemoryRequirements(dev, vk_image, &mem_reqs);
+  uint32_t mem_type_bits = mem_reqs.memoryTypeBits & fd_props.memoryTypeBits;
+  if (res != VK_SUCCESS || mem_type_bits == 0) {
+    ETRACE("No memory type to import the dma-buf (%d)\n", res);
+    close(fd);
+    vkDestroyImage(dev, vk_image, NULL);
+    return VK_ERROR_INVALID_EXTERNAL_HANDLE;
+  }
+
+  VkMemoryDedicatedAllocateInfo dedicated_alloc = {};
+  dedicated_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicated_alloc.image = vk_image;
+
+  VkImportMemoryFdInfoKHR import_info = {};
+  import_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR;
+  import_info.pNext = &dedicated_alloc;
+  import_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+  import_info.fd = fd;
+
+  VkMemoryAllocateInfo mem_alloc = {};
+  mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  mem_alloc.pNext = &import_info;
+  mem_alloc.allocationSize = mem_reqs.size;
+  mem_alloc.memoryTypeIndex = __builtin_ctz(mem_type_bits);
+
+  VkDeviceMemory memory;
+  res = vkAllocateMemory(dev, &mem_alloc, NULL, &memory);
+  if (res != VK_SUCCESS) {
+    ETRACE("vkAllocateMemory failed (%d)\n", res);
+    close(fd);
+    vkDestroyImage(dev, vk_image, NULL);
+    return res;
+  }
+
+  res = vkBindImageMemory(dev, vk_image, memory, 0);
+  if (res != VK_SUCCESS) {
+    ETRACE("vkBindImageMemory failed (%d)\n", res);
+    vkFreeMemory(dev, memory, NULL);
+    vkDestroyImage(dev, vk_image, NULL);
+    return res;
+  }
+
+  image.image_ = vk_image;
+  image.memory_ = memory;
+  return VK_SUCCESS;
+}
+#endif
+
 DrmBuffer::~DrmBuffer() {
   bool texture_initialized = false;
 #if USE_GL
@@ -271,16 +381,21 @@ const ResourceHandle& DrmBuffer::GetGpuResource(GpuDisplay egl_display,
     VkDevice dev = egl_display;
     VkResult res;
 
+    VkFormat vk_format = NativeToVkFormat(format_);
+    if (vk_format == VK_FORMAT_UNDEFINED) {
+      ETRACE("Failed DRM -> Vulkan format conversion\n");
+    }
+
     PFN_vkCreateDmaBufImageINTEL vkCreateDmaBufImageINTEL =
         (PFN_vkCreateDmaBufImageINTEL)vkGetDeviceProcAddr(
             dev, "vkCreateDmaBufImageINTEL");
     if (vkCreateDmaBufImageINTEL == NULL) {
+#ifdef VK_EXT_image_drm_format_modifier
+      ImportDmaBufImage(dev, image_.handle_->meta_data_, vk_format, image_);
+#else
       ETRACE("vkGetDeviceProcAddr(\"vkCreateDmaBufImageINTEL\") failed\n");
-    }
-
-    VkFormat vk_format = NativeToVkFormat(format_);
-    if (vk_format == VK_FORMAT_UNDEFINED) {
-      ETRACE("Failed DRM -> Vulkan format conversion\n");
+#endif
+      return image_;
     }
 
     VkExtent3D image_extent = {};
@@ -415,6 +530,8 @@ bool DrmBuffer::CreateFrameBufferWithModifier(uint64_t modifier) {
       METADATA(num_planes_), METADATA(gem_handles_), METADATA(pitches_),
       METADATA(offsets_));
   media_image_.drm_fd_ = image_.drm_fd_;
+  if (image_.drm_fd_)
+    modifier_ = modifier;
   return true;
 }
 
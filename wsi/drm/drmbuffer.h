@@ -85,6 +85,10 @@ class DrmBuffer : public OverlayBuffer {
     return METADATA(tiling_mode_);
   }
 
+  uint64_t GetModifier() const override {
+    return modifier_;
+  }
+
   void SetDataSpace(uint32_t dataspace) override {
     METADATA(dataspace_) = dataspace;
   }
@@ -123,6 +127,7 @@ class DrmBuffer : public OverlayBuffer {
   uint32_t frame_buffer_format_ = 0;
   uint32_t previous_width_ = 0;   // For Media usage.
   uint32_t previous_height_ = 0;  // For Media usage.
+  uint64_t modifier_ = 0;
   ResourceManager* resource_manager_ = 0;
   ResourceHandle image_;
   MediaResourceHandle media_image_;
@@ -17,6 +17,7 @@
 #include "drmdisplay.h"
 #include "hdr_metadata_defs.h"
 
+#include <errno.h>
 #include <sys/time.h>
 #include <cmath>
 #include <limits>
@@ -61,12 +62,15 @@ DrmDisplay::~DrmDisplay() {
   if (old_blob_id_)
     drmModeDestroyPropertyBlob(gpu_fd_, old_blob_id_);
 
+  free(display_hdrMd);
+
   display_queue_->SetPowerMode(kOff);
 }
 
 bool DrmDisplay::InitializeDisplay() {
-  ScopedDrmObjectPropertyPtr crtc_props(
-      drmModeObjectGetProperties(gpu_fd_, crtc_id_, DRM_MODE_OBJECT_CRTC));
+  DrmPropertyRegistry::ObjectProperties crtc_props;
+  manager_->GetPropertyRegistry()->GetObjectProperties(
+      crtc_id_, DRM_MODE_OBJECT_CRTC, &crtc_props);
   GetDrmObjectProperty("ACTIVE", crtc_props, &active_prop_);
   GetDrmObjectProperty("MODE_ID", crtc_props, &mode_id_prop_);
   GetDrmObjectProperty("CTM", crtc_props, &ctm_id_prop_);
@@ -121,8 +125,10 @@ void DrmDisplay::DrmConnectorGetHDRStaticMetadata(uint8_t *b, uint8_t length) {
     return;
   }
 
-  display_hdrMd = (struct drm_edid_hdr_metadata_static *)malloc(
-      sizeof(struct drm_edid_hdr_metadata_static));
+  if (!display_hdrMd)
+    display_hdrMd = (struct drm_edid_hdr_metadata_static *)malloc(
+        sizeof(struct drm_edid_hdr_metadata_static));
+
   if (!display_hdrMd) {
     ITRACE("OOM while parsing static metadata\n");
     return;
@@ -232,6 +238,52 @@ void DrmDisplay::ParseCTAFromExtensionBlock(uint8_t *edid) {
   }
 }
 
+void DrmDisplay::ParseEdid(uint8_t *edid, uint32_t length) {
+  size_t hash = length;
+  for (uint32_t i = 0; i < length; i++) {
+    hash_combine_hwc(hash, edid[i]);
+  }
+
+  EdidCapabilities caps;
+  if (manager_->FindEdidCapabilities(hash, edid, length, &caps)) {
+    IHOTPLUGEVENTTRACE("Using cached capabilities of EDID %zx", hash);
+    dcip3_ = caps.dcip3;
+    clrspaces = caps.color_spaces;
+    primaries = caps.primaries;
+    if (caps.has_hdr_metadata) {
+      if (!display_hdrMd)
+        display_hdrMd = (struct drm_edid_hdr_metadata_static *)malloc(
+            sizeof(struct drm_edid_hdr_metadata_static));
+
+      if (display_hdrMd)
+        *display_hdrMd = caps.hdr_metadata;
+    } else {
+      free(display_hdrMd);
+      display_hdrMd = NULL;
+    }
+
+    return;
+  }
+
+  // Don't keep capabilities of a previously connected monitor.
+  dcip3_ = false;
+  clrspaces = 0;
+  memset(&primaries, 0, sizeof(primaries));
+  free(display_hdrMd);
+  display_hdrMd = NULL;
+  ParseCTAFromExtensionBlock(edid);
+
+  caps.dcip3 = dcip3_;
+  caps.color_spaces = clrspaces;
+  caps.primaries = primaries;
+  if (display_hdrMd) {
+    caps.has_hdr_metadata = true;
+    caps.hdr_metadata = *display_hdrMd;
+  }
+
+  manager_->AddEdidCapabilities(hash, edid, length, caps);
+}
+
 bool DrmDisplay::ConnectDisplay(const drmModeModeInfo &mode_info,
                                 const drmModeConnector *connector,
                                 uint32_t config) {
@@ -249,6 +301,7 @@ bool DrmDisplay::ConnectDisplay(const drmModeModeInfo &mode_info,
       "Display is being connected to a new connector.%d %d %p \n",
       connector->connector_id, connector_, this);
   connector_ = connector->connector_id;
+  test_commit_cache_.Invalidate();
   mmWidth_ = connector->mmWidth;
   mmHeight_ = connector->mmHeight;
 
@@ -264,15 +317,16 @@ bool DrmDisplay::ConnectDisplay(const drmModeModeInfo &mode_info,
   config_ = config;
 #endif
 
-  ScopedDrmObjectPropertyPtr connector_props(drmModeObjectGetProperties(
-      gpu_fd_, connector_, DRM_MODE_OBJECT_CONNECTOR));
-  if (!connector_props) {
+  DrmPropertyRegistry::ObjectProperties connector_props;
+  manager_->GetPropertyRegistry()->GetObjectProperties(
+      connector_, DRM_MODE_OBJECT_CONNECTOR, &connector_props);
+  if (!connector_props.IsValid()) {
     ETRACE("Unable to get connector properties.");
     return false;
   }
 
   int value = -1;
-  GetDrmHDCPObjectProperty("Content Protection", connector, connector_props,
+  GetDrmHDCPObjectProperty("Content Protection", connector_props,
                            &hdcp_id_prop_, &value);
 
   if (value >= 0) {
@@ -292,8 +346,8 @@ bool DrmDisplay::ConnectDisplay(const drmModeModeInfo &mode_info,
     }
   }
 
-  GetDrmHDCPObjectProperty("CP_SRM", connector, connector_props,
-                           &hdcp_srm_id_prop_, &value);
+  GetDrmHDCPObjectProperty("CP_SRM", connector_props, &hdcp_srm_id_prop_,
+                           &value);
 
   GetDrmObjectProperty("CRTC_ID", connector_props, &crtc_prop_);
   GetDrmObjectProperty("Broadcast RGB", connector_props, &broadcastrgb_id_);
@@ -315,7 +369,7 @@ bool DrmDisplay::ConnectDisplay(const drmModeModeInfo &mode_info,
   }
 
   edid = (uint8_t *)blob->data;
-  ParseCTAFromExtensionBlock(edid);
+  ParseEdid(edid, blob->length);
   if (dcip3_) {
     ITRACE("DCIP3 support available");
     if (!SetPipeMaxBpc(PIPE_BPC_TWELVE))
@@ -328,8 +382,8 @@ bool DrmDisplay::ConnectDisplay(const drmModeModeInfo &mode_info,
   PhysicalDisplay::Connect();
   SetHDCPState(desired_protection_support_, content_type_);
 
-  drmModePropertyPtr broadcastrgb_props =
-      drmModeGetProperty(gpu_fd_, broadcastrgb_id_);
+  const DrmPropertyRegistry::PropertyInfo *broadcastrgb_props =
+      connector_props.Find("Broadcast RGB");
 
   SetPowerMode(power_mode_);
 
@@ -340,22 +394,17 @@ bool DrmDisplay::ConnectDisplay(const drmModeModeInfo &mode_info,
   }
 
   if (!(broadcastrgb_props->flags & DRM_MODE_PROP_ENUM)) {
-    drmModeFreeProperty(broadcastrgb_props);
     return false;
   }
 
-  if (broadcastrgb_props->enums != NULL) {
-    for (int i = 0; i < broadcastrgb_props->count_enums; i++) {
-      if (!strcmp(broadcastrgb_props->enums[i].name, "Full")) {
-        broadcastrgb_full_ = broadcastrgb_props->enums[i].value;
-      } else if (!strcmp(broadcastrgb_props->enums[i].name, "Automatic")) {
-        broadcastrgb_automatic_ = broadcastrgb_props->enums[i].value;
-      }
+  for (const auto &property_enum : broadcastrgb_props->enums) {
+    if (property_enum.first == "Full") {
+      broadcastrgb_full_ = property_enum.second;
+    } else if (property_enum.first == "Automatic") {
+      broadcastrgb_automatic_ = property_enum.second;
     }
   }
 
-  drmModeFreeProperty(broadcastrgb_props);
-
   return true;
 }
 
@@ -571,6 +620,8 @@ void DrmDisplay::UpdateDisplayConfig() {
 void DrmDisplay::PowerOn() {
   flags_ = 0;
   flags_ |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+  // Planes may have been reset while the display was off.
+  ForceFullStateCommit();
   drmModeConnectorSetProperty(gpu_fd_, connector_, dpms_prop_,
                               DRM_MODE_DPMS_ON);
   IHOTPLUGEVENTTRACE("PowerOn: Powered on Pipe: %d display: %p", pipe_, this);
@@ -757,7 +808,15 @@ bool DrmDisplay::Commit(
   if (first_commit_)
     display_queue_->ResetPlanes(pset.get());
 
+  // Plane state might have been changed by someone else or is not valid
+  // for the new mode, send everything.
+  if (full_state_request_.exchange(false) || first_commit_ ||
+      (display_state_ & kNeedsModeset))
+    full_state_commit_ = true;
+
   if (display_state_ & kNeedsModeset) {
+    // Results of earlier test commits are not valid for the new mode.
+    test_commit_cache_.Invalidate();
     /* KK: Put to check only if input layer is a hdr */
     for (const DisplayPlaneState &comp_plane : composition_planes) {
       OverlayLayer *layer = (OverlayLayer *)comp_plane.GetOverlayLayer();
@@ -825,8 +884,19 @@ bool DrmDisplay::CommitFrame(
     return false;
   }
 
+  // Fences of offscreen surfaces are valid only once composition has been
+  // submitted.
+  if (!display_queue_->WaitForComposition()) {
+    ETRACE("Failed to compose the frame.");
+    return false;
+  }
+
+  std::vector<DrmPlane *> updated_planes;
+  updated_planes.reserve(comp_planes.size() +
+                         previous_composition_planes.size());
   for (const DisplayPlaneState &comp_plane : comp_planes) {
     DrmPlane *plane = static_cast<DrmPlane *>(comp_plane.GetDisplayPlane());
+    updated_planes.emplace_back(plane);
 
     OverlayLayer *layer = (OverlayLayer *)comp_plane.GetOverlayLayer();
     const HwcRect<int> &display_rect = layer->GetDisplayFrame();
@@ -859,15 +929,19 @@ bool DrmDisplay::CommitFrame(
     if (comp_plane.Scanout() && !comp_plane.IsSurfaceRecycled())
       plane->SetBuffer(layer->GetSharedBuffer());
 
-    if (!plane->UpdateProperties(pset, crtc_id_, layer))
+    if (!plane->UpdateProperties(pset, crtc_id_, layer, false,
+                                 full_state_commit_)) {
+      DiscardPendingPlaneState(updated_planes);
       return false;
+    }
   }
 
   for (const DisplayPlaneState &comp_plane : previous_composition_planes) {
     DrmPlane *plane = static_cast<DrmPlane *>(comp_plane.GetDisplayPlane());
     if (plane->InUse())
       continue;
-    plane->Disable(pset);
+    updated_planes.emplace_back(plane);
+    plane->Disable(pset, full_state_commit_);
   }
 
 #ifndef ENABLE_DOUBLE_BUFFERING
@@ -878,15 +952,45 @@ bool DrmDisplay::CommitFrame(
   }
 #endif
 
-  int ret = drmModeAtomicCommit(gpu_fd_, pset, flags, NULL);
+  // Completion of the flip is reported to the vblank event loop, which
+  // uses it as an exact vsync timestamp. Event can't be requested for
+  // commits which may turn off the pipe.
+  void *user_data = NULL;
+  if (!(flags & DRM_MODE_ATOMIC_ALLOW_MODESET)) {
+    user_data = display_queue_->RequestPageFlipEvent();
+    if (user_data)
+      flags |= DRM_MODE_PAGE_FLIP_EVENT;
+  }
+
+  int ret = drmModeAtomicCommit(gpu_fd_, pset, flags, user_data);
+
   if (ret) {
     ETRACE("Failed to commit pset ret=%s\n", PRINTERROR());
+    display_queue_->CancelPageFlipEvent(user_data);
+    // Kernel state is unchanged, but we can't be sure what caused the
+    // failure. Resend everything with the next commit and don't trust
+    // earlier test commits, which passed for this state.
+    DiscardPendingPlaneState(updated_planes);
+    full_state_commit_ = true;
+    test_commit_cache_.Invalidate();
     return false;
   }
 
+  for (DrmPlane *plane : updated_planes) {
+    plane->CommitPendingState(true);
+  }
+
+  full_state_commit_ = false;
   return true;
 }
 
+void DrmDisplay::DiscardPendingPlaneState(
+    const std::vector<DrmPlane *> &planes) {
+  for (DrmPlane *plane : planes) {
+    plane->CommitPendingState(false);
+  }
+}
+
 void DrmDisplay::SetDrmModeInfo(const std::vector<drmModeModeInfo> &mode_info) {
   SPIN_LOCK(display_lock_);
   uint32_t size = mode_info.size();
@@ -930,67 +1034,42 @@ void DrmDisplay::SetDisplayAttribute(const drmModeModeInfo &mode_info) {
   current_mode_ = mode_info;
 }
 
-void DrmDisplay::GetDrmObjectProperty(const char *name,
-                                      const ScopedDrmObjectPropertyPtr &props,
-                                      uint32_t *id) const {
-  uint32_t count_props = props->count_props;
-  for (uint32_t i = 0; i < count_props; i++) {
-    ScopedDrmPropertyPtr property(drmModeGetProperty(gpu_fd_, props->props[i]));
-    if (property && !strcmp(property->name, name)) {
-      *id = property->prop_id;
-      property.reset();
-      break;
-    }
-    property.reset();
-  }
+void DrmDisplay::GetDrmObjectProperty(
+    const char *name, const DrmPropertyRegistry::ObjectProperties &props,
+    uint32_t *id) const {
+  const DrmPropertyRegistry::PropertyInfo *property = props.Find(name);
+  if (property)
+    *id = property->id;
+
   if (!(*id))
     ETRACE("Could not find property %s", name);
 }
 
 void DrmDisplay::GetDrmHDCPObjectProperty(
-    const char *name, const drmModeConnector *connector,
-    const ScopedDrmObjectPropertyPtr &props, uint32_t *id, int *value) const {
-  uint32_t count_props = props->count_props;
-  for (uint32_t i = 0; i < count_props; i++) {
-    ScopedDrmPropertyPtr property(drmModeGetProperty(gpu_fd_, props->props[i]));
-    if (property && !strcmp(property->name, name)) {
-      *id = property->prop_id;
-      if (value) {
-        for (int prop_idx = 0; prop_idx < connector->count_props; ++prop_idx) {
-          if (connector->props[prop_idx] != property->prop_id)
-            continue;
-
-          for (int enum_idx = 0; enum_idx < property->count_enums; ++enum_idx) {
-            const drm_mode_property_enum &property_enum =
-                property->enums[enum_idx];
-            if (property_enum.value == connector->prop_values[prop_idx]) {
-              *value = property_enum.value;
-            }
-          }
+    const char *name, const DrmPropertyRegistry::ObjectProperties &props,
+    uint32_t *id, int *value) const {
+  uint64_t current = 0;
+  const DrmPropertyRegistry::PropertyInfo *property =
+      props.Find(name, &current);
+  if (property) {
+    *id = property->id;
+    if (value) {
+      for (const auto &property_enum : property->enums) {
+        if (property_enum.second == current) {
+          *value = current;
         }
       }
-      property.reset();
-      break;
     }
-    property.reset();
   }
+
   if (!(*id))
     ETRACE("Could not find property %s", name);
 }
 
 void DrmDisplay::GetDrmObjectPropertyValue(
-    const char *name, const ScopedDrmObjectPropertyPtr &props,
+    const char *name, const DrmPropertyRegistry::ObjectProperties &props,
     uint64_t *value) const {
-  uint32_t count_props = props->count_props;
-  for (uint32_t i = 0; i < count_props; i++) {
-    ScopedDrmPropertyPtr property(drmModeGetProperty(gpu_fd_, props->props[i]));
-    if (property && !strcmp(property->name, name)) {
-      *value = props->prop_values[i];
-      property.reset();
-      break;
-    }
-    property.reset();
-  }
+  props.Find(name, value);
   if (!(*value))
     ETRACE("Could not find property value %s", name);
 }
@@ -1350,6 +1429,7 @@ void DrmDisplay::ReleaseUnreservedPlanes(
 
 bool DrmDisplay::PopulatePlanes(
     std::vector<std::unique_ptr<DisplayPlane>> &overlay_planes) {
+  test_commit_cache_.Invalidate();
   ScopedDrmPlaneResPtr plane_resources(drmModeGetPlaneResources(gpu_fd_));
   if (!plane_resources) {
     ETRACE("Failed to get plane resources");
@@ -1388,7 +1468,8 @@ bool DrmDisplay::PopulatePlanes(
     if (i >= 2)
       use_modifier = false;
 #endif
-    if (plane->Initialize(gpu_fd_, supported_formats, use_modifier)) {
+    if (plane->Initialize(gpu_fd_, manager_->GetPropertyRegistry(),
+                          supported_formats, use_modifier)) {
       if (plane->type() == DRM_PLANE_TYPE_CURSOR) {
         cursor_plane.reset(plane.release());
       } else {
@@ -1437,6 +1518,12 @@ void DrmDisplay::NotifyClientsOfDisplayChangeStatus() {
 
 bool DrmDisplay::TestCommit(
     const std::vector<OverlayPlane> &commit_planes) const {
+  bool result = false;
+  if (test_commit_cache_.Lookup(commit_planes, &result)) {
+    IDISPLAYMANAGERTRACE("Test Commit result %d found in cache.", result);
+    return result;
+  }
+
   ScopedDrmAtomicReqPtr pset(drmModeAtomicAlloc());
   for (auto i = commit_planes.begin(); i != commit_planes.end(); i++) {
     DrmPlane *plane = static_cast<DrmPlane *>(i->plane);
@@ -1445,13 +1532,15 @@ bool DrmDisplay::TestCommit(
     }
   }
 
+  result = true;
   if (drmModeAtomicCommit(gpu_fd_, pset.get(), DRM_MODE_ATOMIC_TEST_ONLY,
                           NULL)) {
     IDISPLAYMANAGERTRACE("Test Commit Failed. %s ", PRINTERROR());
-    return false;
+    result = false;
   }
 
-  return true;
+  test_commit_cache_.Insert(result);
+  return result;
 }
 
 std::unique_ptr<DrmPlane> DrmDisplay::CreatePlane(uint32_t plane_id,
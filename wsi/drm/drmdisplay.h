@@ -21,9 +21,13 @@
 #include <stdlib.h>
 #include <xf86drmMode.h>
 
+#include <atomic>
+
 #include <drmscopedtypes.h>
 
 #include "drmplane.h"
+#include "drmpropertyregistry.h"
+#include "drmtestcommitcache.h"
 #include "hdr_metadata_defs.h"
 #include "physicaldisplay.h"
 
@@ -87,6 +91,15 @@ struct drm_display_color_primaries {
   uint16_t white_point_y;
 };
 
+/* Capabilities parsed from the CTA extension blocks of an EDID */
+struct EdidCapabilities {
+  bool dcip3 = false;
+  uint32_t color_spaces = 0;
+  struct drm_display_color_primaries primaries = {};
+  bool has_hdr_metadata = false;
+  struct drm_edid_hdr_metadata_static hdr_metadata = {};
+};
+
 /* Static HDR metadata to be sent to kernel, matches kernel structure */
 struct drm_hdr_metadata_static {
   uint8_t eotf;
@@ -213,18 +226,36 @@ class DrmDisplay : public PhysicalDisplay {
     first_commit_ = true;
   }
 
+  // Returns number of TestCommit calls which were answered from (hits)
+  // or missed (misses) the cached TEST_ONLY commit results.
+  uint64_t GetTestCommitCacheHits() const {
+    return test_commit_cache_.GetHits();
+  }
+
+  uint64_t GetTestCommitCacheMisses() const {
+    return test_commit_cache_.GetMisses();
+  }
+
+  // Next commit adds all plane properties instead of only the ones which
+  // changed since the last successful commit. This is done automatically
+  // after a modeset or a failed commit, on power on and by
+  // DrmDisplayManager once DRM master has been acquired. Can be called
+  // from any thread.
+  void ForceFullStateCommit() {
+    full_state_request_.store(true);
+  }
+
  private:
   void ShutDownPipe();
-  void GetDrmObjectPropertyValue(const char *name,
-                                 const ScopedDrmObjectPropertyPtr &props,
-                                 uint64_t *value) const;
+  void GetDrmObjectPropertyValue(
+      const char *name, const DrmPropertyRegistry::ObjectProperties &props,
+      uint64_t *value) const;
   void GetDrmObjectProperty(const char *name,
-                            const ScopedDrmObjectPropertyPtr &props,
+                            const DrmPropertyRegistry::ObjectProperties &props,
                             uint32_t *id) const;
-  void GetDrmHDCPObjectProperty(const char *name,
-                                const drmModeConnector *connector,
-                                const ScopedDrmObjectPropertyPtr &props,
-                                uint32_t *id, int *value = NULL) const;
+  void GetDrmHDCPObjectProperty(
+      const char *name, const DrmPropertyRegistry::ObjectProperties &props,
+      uint32_t *id, int *value = NULL) const;
   float TransformGamma(float value, float gamma) const;
   float TransformContrastBrightness(float value, float brightness,
                                     float contrast) const;
@@ -251,12 +282,16 @@ class DrmDisplay : public PhysicalDisplay {
   std::vector<uint8_t *> FindExtendedBlocksForTag(uint8_t *edid,
                                                   uint8_t block_tag);
   void ParseCTAFromExtensionBlock(uint8_t *edid);
+  // Sets the EDID capabilities of the display, parsing edid only if it
+  // hasn't been seen before.
+  void ParseEdid(uint8_t *edid, uint32_t length);
   void DrmConnectorGetDCIP3Support(uint8_t *b, uint8_t length);
   void DrmConnectorGetHDRStaticMetadata(uint8_t *b, uint8_t length);
   uint16_t DrmConnectorColorPrimary(short val);
   void DrmConnectorGetcolorPrimaries(
       uint8_t *b, struct drm_display_color_primaries *primaries);
   void TraceFirstCommit();
+  void DiscardPendingPlaneState(const std::vector<DrmPlane *> &planes);
 
   uint32_t FindPreferedDisplayMode(size_t modes_size);
   uint32_t FindPerformaceDisplayMode(size_t modes_size);
@@ -295,7 +330,7 @@ class DrmDisplay : public PhysicalDisplay {
   std::string display_name_;
 
   /* Display's static HDR metadata */
-  struct drm_edid_hdr_metadata_static *display_hdrMd;
+  struct drm_edid_hdr_metadata_static *display_hdrMd = NULL;
   /* Display's color primaries */
   struct drm_display_color_primaries primaries;
   /* Display's supported color spaces */
@@ -310,6 +345,11 @@ class DrmDisplay : public PhysicalDisplay {
   drmModeModeInfo current_mode_;
   HWCContentType content_type_ = kCONTENT_TYPE0;
   std::vector<drmModeModeInfo> modes_;
+  mutable DrmTestCommitCache test_commit_cache_;
+  // Only used by the thread committing frames, which picks up requests of
+  // ForceFullStateCommit at the start of Commit.
+  bool full_state_commit_ = true;
+  std::atomic<bool> full_state_request_{false};
   SpinLock display_lock_;
   DrmDisplayManager *manager_;
 };
@@ -74,6 +74,7 @@ bool DrmDisplayManager::Initialize() {
     return false;
   }
 
+  property_registry_.reset(new DrmPropertyRegistry(fd_));
   ScopedDrmResourcesPtr res(drmModeGetResources(fd_));
   if (!res) {
     ETRACE("Failed to get resources");
@@ -140,6 +141,8 @@ void DrmDisplayManager::HotPlugEventHandler() {
   memset(&buffer, 0, sizeof(buffer));
   while (true) {
     bool drm_event = false, hotplug_event = false;
+    // Set by the kernel when it knows which connector changed.
+    uint32_t connector_id = 0;
     size_t srclen = DRM_HOTPLUG_EVENT_SIZE - 1;
     ret = read(fd, &buffer, srclen);
     if (ret <= 0) {
@@ -159,19 +162,19 @@ void DrmDisplayManager::HotPlugEventHandler() {
                !strcmp(event,
                        "HDMI-Change")) {  // Hotplug happened during suspend
         hotplug_event = true;
+      } else if (!strncmp(event, "CONNECTOR=", strlen("CONNECTOR="))) {
+        connector_id = strtoul(event + strlen("CONNECTOR="), NULL, 10);
       }
 
-      if (hotplug_event && drm_event)
-        break;
-
       i += strlen(event) + 1;
     }
 
     if (drm_event && hotplug_event) {
       IHOTPLUGEVENTTRACE(
           "Recieved Hot Plug event related to display calling "
-          "UpdateDisplayState.");
-      UpdateDisplayState();
+          "UpdateDisplayState. connector: %d",
+          connector_id);
+      UpdateDisplayState(connector_id);
     }
   }
 }
@@ -218,7 +221,7 @@ void DrmDisplayManager::HandleRoutine() {
   }
 }
 
-bool DrmDisplayManager::UpdateDisplayState() {
+bool DrmDisplayManager::UpdateDisplayState(uint32_t changed_connector) {
   CTRACE();
   ScopedDrmResourcesPtr res(drmModeGetResources(fd_));
   if (!res) {
@@ -226,56 +229,74 @@ bool DrmDisplayManager::UpdateDisplayState() {
     return false;
   }
 
-  spin_lock_.lock();
-  // Start of assuming no displays are connected
-  for (auto &display : displays_) {
-    if (device_.IsReservedDrmPlane() && !display->IsConnected())
-      display->SetPlanesUpdated(false);
-    display->MarkForDisconnect();
-  }
-
-  connected_display_count_ = 0;
-  std::vector<NativeDisplay *> connected_displays;
-  std::vector<uint32_t> no_encoder;
+  // Read each connector once. Probing forces the kernel to re-detect the
+  // monitor and read its EDID, so it's skipped for connectors which
+  // haven't changed.
+  std::vector<ScopedDrmConnectorPtr> connectors;
+  std::vector<bool> changed;
+  int connected_count = 0;
   uint32_t total_connectors = res->count_connectors;
   for (uint32_t i = 0; i < total_connectors; ++i) {
+    uint32_t connector_id = res->connectors[i];
+    bool probe = !changed_connector || connector_id == changed_connector ||
+                 !connector_states_.count(connector_id);
     ScopedDrmConnectorPtr connector(
-        drmModeGetConnector(fd_, res->connectors[i]));
+        probe ? drmModeGetConnector(fd_, connector_id)
+              : drmModeGetConnectorCurrent(fd_, connector_id));
     if (!connector) {
-      ETRACE("Failed to get connector %d", res->connectors[i]);
+      ETRACE("Failed to get connector %d", connector_id);
       break;
     }
+
     // check if a monitor is connected.
-    if (connector->connection != DRM_MODE_CONNECTED) {
-      connector.reset();
-      continue;
-    }
-    connected_display_count_++;
-    connector.reset();
+    if (connector->connection == DRM_MODE_CONNECTED)
+      connected_count++;
+
+    changed.emplace_back(UpdateConnectorState(connector.get()));
+    connectors.emplace_back(std::move(connector));
   }
 
-  for (uint32_t i = 0; i < total_connectors; ++i) {
-    ScopedDrmConnectorPtr connector(
-        drmModeGetConnector(fd_, res->connectors[i]));
-    if (!connector) {
-      ETRACE("Failed to get connector %d", res->connectors[i]);
-      break;
+  spin_lock_.lock();
+  // Start of assuming no displays are connected, except for the ones
+  // driving a connector which didn't change.
+  size_t num_connectors = connectors.size();
+  std::vector<bool> in_use(num_connectors, false);
+  for (auto &display : displays_) {
+    bool keep = false;
+    if (changed_connector && display->IsConnected()) {
+      for (size_t i = 0; i < num_connectors; ++i) {
+        const drmModeConnector *connector = connectors[i].get();
+        if (!changed[i] && connector->connection == DRM_MODE_CONNECTED &&
+            connector->connector_id == display->GetConnectorID()) {
+          in_use[i] = true;
+          keep = true;
+          break;
+        }
+      }
     }
-    // check if a monitor is connected.
-    if (connector->connection != DRM_MODE_CONNECTED) {
-      connector.reset();
+
+    if (keep)
+      continue;
+
+    if (device_.IsReservedDrmPlane() && !display->IsConnected())
+      display->SetPlanesUpdated(false);
+    display->MarkForDisconnect();
+  }
+
+  connected_display_count_ = connected_count;
+  std::vector<NativeDisplay *> connected_displays;
+  std::vector<uint32_t> no_encoder;
+  for (uint32_t i = 0; i < num_connectors; ++i) {
+    const drmModeConnector *connector = connectors[i].get();
+    if (in_use[i] || connector->connection != DRM_MODE_CONNECTED)
       continue;
-    }
 
     // Ensure we have atleast one valid mode.
-    if (connector->count_modes == 0) {
-      connector.reset();
+    if (connector->count_modes == 0)
       continue;
-    }
 
     if (connector->encoder_id == 0) {
       no_encoder.emplace_back(i);
-      connector.reset();
       continue;
     }
 
@@ -300,7 +321,7 @@ bool DrmDisplayManager::UpdateDisplayState() {
             encoder->crtc_id, display->CrtcId(), display->IsConnected());
         // At initilaization  preferred mode is set!
         if (!display->IsConnected() && encoder->crtc_id == display->CrtcId() &&
-            display->ConnectDisplay(mode.at(preferred_mode), connector.get(),
+            display->ConnectDisplay(mode.at(preferred_mode), connector,
                                     preferred_mode)) {
           IHOTPLUGEVENTTRACE("Connected %d with crtc: %d pipe:%d \n",
                              encoder->crtc_id, display->CrtcId(),
@@ -313,18 +334,12 @@ bool DrmDisplayManager::UpdateDisplayState() {
     }
 
     encoder.reset();
-    connector.reset();
   }
 
   // Deal with connectors with encoder_id == 0.
   uint32_t size = no_encoder.size();
   for (uint32_t i = 0; i < size; ++i) {
-    ScopedDrmConnectorPtr connector(
-        drmModeGetConnector(fd_, res->connectors[no_encoder.at(i)]));
-    if (!connector) {
-      ETRACE("Failed to get connector %d", res->connectors[i]);
-      break;
-    }
+    const drmModeConnector *connector = connectors[no_encoder.at(i)].get();
 
     std::vector<drmModeModeInfo> mode;
     uint32_t preferred_mode = 0;
@@ -349,7 +364,7 @@ bool DrmDisplayManager::UpdateDisplayState() {
       for (auto &display : displays_) {
         if (!display->IsConnected() &&
             (encoder->possible_crtcs & (1 << display->GetDisplayPipe())) &&
-            display->ConnectDisplay(mode.at(preferred_mode), connector.get(),
+            display->ConnectDisplay(mode.at(preferred_mode), connector,
                                     preferred_mode)) {
           IHOTPLUGEVENTTRACE("Connected with crtc: %d pipe:%d \n",
                              display->CrtcId(), display->GetDisplayPipe());
@@ -361,8 +376,6 @@ bool DrmDisplayManager::UpdateDisplayState() {
 
       encoder.reset();
     }
-
-    connector.reset();
   }
 
   for (auto &display : displays_) {
@@ -396,6 +409,56 @@ bool DrmDisplayManager::UpdateDisplayState() {
   return true;
 }
 
+bool DrmDisplayManager::UpdateConnectorState(
+    const drmModeConnector *connector) {
+  auto it = connector_states_.find(connector->connector_id);
+  bool changed = it == connector_states_.end();
+  if (changed)
+    it = connector_states_.emplace(connector->connector_id, ConnectorState())
+             .first;
+
+  ConnectorState &state = it->second;
+  uint32_t count_modes = connector->count_modes;
+  if (state.connection != connector->connection ||
+      state.encoder_id != connector->encoder_id ||
+      state.modes.size() != count_modes ||
+      (count_modes && memcmp(state.modes.data(), connector->modes,
+                             count_modes * sizeof(drmModeModeInfo)))) {
+    changed = true;
+  }
+
+  if (changed) {
+    state.connection = connector->connection;
+    state.encoder_id = connector->encoder_id;
+    state.modes.assign(connector->modes, connector->modes + count_modes);
+  }
+
+  return changed;
+}
+
+bool DrmDisplayManager::FindEdidCapabilities(size_t hash, const uint8_t *edid,
+                                             uint32_t length,
+                                             EdidCapabilities *caps) const {
+  auto range = edid_cache_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const std::vector<uint8_t> &cached = it->second.edid;
+    if (cached.size() == length && !memcmp(cached.data(), edid, length)) {
+      *caps = it->second.caps;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void DrmDisplayManager::AddEdidCapabilities(size_t hash, const uint8_t *edid,
+                                            uint32_t length,
+                                            const EdidCapabilities &caps) {
+  CachedEdid &cached = edid_cache_.emplace(hash, CachedEdid())->second;
+  cached.edid.assign(edid, edid + length);
+  cached.caps = caps;
+}
+
 void DrmDisplayManager::NotifyClientsOfDisplayChangeStatus() {
   spin_lock_.lock();
 
@@ -516,7 +579,16 @@ void DrmDisplayManager::setDrmMaster(bool must_set) {
       drm_master_ = true;
     }
   } while (ret && retry_times < 10);
+  bool master_acquired = drm_master_;
   spin_lock_.unlock();
+
+  // Plane state might have been changed by the previous master.
+  if (master_acquired) {
+    size_t size = displays_.size();
+    for (size_t i = 0; i < size; i++) {
+      displays_.at(i)->ForceFullStateCommit();
+    }
+  }
 }
 
 void DrmDisplayManager::DropDrmMaster() {
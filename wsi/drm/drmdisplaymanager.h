@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 
+#include <map>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -28,6 +29,7 @@
 #include "displaymanager.h"
 #include "displayplanemanager.h"
 #include "drmdisplay.h"
+#include "drmpropertyregistry.h"
 #include "drmscopedtypes.h"
 #include "framebuffermanager.h"
 #include "gpudevice.h"
@@ -103,16 +105,48 @@ class DrmDisplayManager : public HWCThread, public DisplayManager {
 
   FrameBufferManager *GetFrameBufferManager() override;
 
+  DrmPropertyRegistry *GetPropertyRegistry() {
+    return property_registry_.get();
+  }
+
+  // Capabilities of EDIDs parsed so far, so a monitor which comes back
+  // isn't parsed again. Only used while displays are being connected from
+  // UpdateDisplayState.
+  bool FindEdidCapabilities(size_t hash, const uint8_t *edid, uint32_t length,
+                            EdidCapabilities *caps) const;
+  void AddEdidCapabilities(size_t hash, const uint8_t *edid, uint32_t length,
+                           const EdidCapabilities &caps);
+
  protected:
   void HandleWait() override;
   void HandleRoutine() override;
 
  private:
+  // State of a connector as of the last UpdateDisplayState.
+  struct ConnectorState {
+    drmModeConnection connection = DRM_MODE_UNKNOWNCONNECTION;
+    uint32_t encoder_id = 0;
+    std::vector<drmModeModeInfo> modes;
+  };
+
+  struct CachedEdid {
+    std::vector<uint8_t> edid;
+    EdidCapabilities caps;
+  };
+
   void HotPlugEventHandler();
-  bool UpdateDisplayState();
+  // Updates displays to the connectors. If changed_connector is set, only
+  // that connector is probed, the others are assumed to be unchanged and
+  // the kernel's current state of them is used. Displays which stay
+  // connected to an unchanged connector are left alone.
+  bool UpdateDisplayState(uint32_t changed_connector = 0);
+  bool UpdateConnectorState(const drmModeConnector *connector);
   std::map<uint32_t, std::unique_ptr<NativeDisplay>> virtual_displays_;
   std::unique_ptr<FrameBufferManager> frame_buffer_manager_;
+  std::unique_ptr<DrmPropertyRegistry> property_registry_;
   std::vector<std::unique_ptr<DrmDisplay>> displays_;
+  std::map<uint32_t, ConnectorState> connector_states_;
+  std::multimap<size_t, CachedEdid> edid_cache_;
   std::shared_ptr<DisplayHotPlugEventCallback> callback_ = NULL;
   std::unique_ptr<NativeBufferHandler> buffer_handler_;
   GpuDevice &device_ = GpuDevice::getInstance();
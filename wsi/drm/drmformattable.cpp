@@ -0,0 +1,166 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "drmformattable.h"
+
+#include <drm_fourcc.h>
+#include <drm_mode.h>
+
+#include <algorithm>
+
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+// Largest table is 1 << kMaxBits slots.
+static const uint32_t kMaxBits = 12;
+// Multipliers tried per table size before the table is grown.
+static const uint32_t kMaxAttempts = 256;
+// Modifiers per format are kept in a 64 bit mask.
+static const size_t kMaxModifiers = 64;
+
+void DrmFormatTable::Build(const std::vector<uint32_t>& formats,
+                           const void* in_formats, size_t in_formats_size) {
+  std::vector<Slot>().swap(slots_);
+  modifiers_.clear();
+
+  // Plane formats and the formats listed in IN_FORMATS normally match, take
+  // both in case they don't.
+  std::vector<uint32_t> all_formats(formats);
+  const uint32_t* blob_formats = NULL;
+  const struct drm_format_modifier* blob_modifiers = NULL;
+  uint32_t count_formats = 0;
+  uint32_t count_modifiers = 0;
+  if (in_formats) {
+    const struct drm_format_modifier_blob* blob =
+        static_cast<const struct drm_format_modifier_blob*>(in_formats);
+    const char* base = static_cast<const char*>(in_formats);
+    if (in_formats_size >= sizeof(*blob) &&
+        blob->formats_offset + blob->count_formats * sizeof(uint32_t) <=
+            in_formats_size &&
+        blob->modifiers_offset +
+                blob->count_modifiers * sizeof(struct drm_format_modifier) <=
+            in_formats_size) {
+      blob_formats =
+          reinterpret_cast<const uint32_t*>(base + blob->formats_offset);
+      blob_modifiers = reinterpret_cast<const struct drm_format_modifier*>(
+          base + blob->modifiers_offset);
+      count_formats = blob->count_formats;
+      count_modifiers = blob->count_modifiers;
+      all_formats.insert(all_formats.end(), blob_formats,
+                         blob_formats + count_formats);
+    } else {
+      ETRACE("Ignoring malformed IN_FORMATS blob.");
+    }
+  }
+
+  all_formats.erase(std::remove(all_formats.begin(), all_formats.end(), 0),
+                    all_formats.end());
+  std::sort(all_formats.begin(), all_formats.end());
+  all_formats.erase(std::unique(all_formats.begin(), all_formats.end()),
+                    all_formats.end());
+  if (all_formats.empty())
+    return;
+
+  // Start with a load factor of at most 1/2.
+  uint32_t bits = 1;
+  while ((1u << bits) < all_formats.size() * 2)
+    bits++;
+
+  bool built = false;
+  for (; bits <= kMaxBits && !built; bits++) {
+    // Odd multipliers from a fixed sequence, so the result doesn't change
+    // between runs.
+    uint32_t multiplier = 0x9e3779b1;
+    for (uint32_t i = 0; i < kMaxAttempts && !built; i++) {
+      built = Insert(all_formats, bits, multiplier);
+      multiplier = multiplier * 1664525 + 1013904223;
+      multiplier |= 1;
+    }
+  }
+
+  if (!built) {
+    ETRACE("Failed to build format table for %zu formats.",
+           all_formats.size());
+    std::vector<Slot>().swap(slots_);
+    return;
+  }
+
+  for (uint32_t i = 0; i < count_modifiers; i++) {
+    const struct drm_format_modifier& modifier = blob_modifiers[i];
+    size_t index = modifiers_.size();
+    if (index == kMaxModifiers) {
+      ETRACE("Ignoring modifiers of plane after the first %zu.",
+             kMaxModifiers);
+      break;
+    }
+
+    modifiers_.emplace_back(modifier.modifier);
+    // Bit j of formats refers to blob format offset + j.
+    for (uint32_t j = 0; j < 64; j++) {
+      uint32_t format_index = modifier.offset + j;
+      if (format_index >= count_formats)
+        break;
+
+      if (!(modifier.formats & (1ULL << j)))
+        continue;
+
+      uint32_t format = blob_formats[format_index];
+      Slot& slot = slots_[GetIndex(format)];
+      if (slot.format == format)
+        slot.modifiers |= 1ULL << index;
+    }
+  }
+}
+
+bool DrmFormatTable::IsSupportedModifier(uint64_t modifier,
+                                         uint32_t format) const {
+  const Slot* slot = Find(format);
+  if (!slot)
+    return false;
+
+  if (modifiers_.empty())
+    return true;
+
+  uint64_t mask = slot->modifiers;
+  while (mask) {
+    uint32_t index = __builtin_ctzll(mask);
+    if (modifiers_[index] == modifier)
+      return true;
+
+    mask &= mask - 1;
+  }
+
+  return false;
+}
+
+bool DrmFormatTable::Insert(const std::vector<uint32_t>& formats,
+                            uint32_t bits, uint32_t multiplier) {
+  slots_.assign(1u << bits, Slot{0, 0});
+  multiplier_ = multiplier;
+  shift_ = 32 - bits;
+  for (uint32_t format : formats) {
+    Slot& slot = slots_[GetIndex(format)];
+    if (slot.format)
+      return false;
+
+    slot.format = format;
+  }
+
+  return true;
+}
+
+}  // namespace hwcomposer
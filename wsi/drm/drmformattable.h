@@ -0,0 +1,98 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef WSI_DRM_DRMFORMATTABLE_H_
+#define WSI_DRM_DRMFORMATTABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace hwcomposer {
+
+// Formats a plane can scan out and the modifiers usable with each of them,
+// as read from the plane's format list and IN_FORMATS blob. Formats are
+// kept in an open addressed table indexed by a multiplicative hash of the
+// fourcc. The multiplier is searched for when the table is built, so that
+// none of the plane's formats collide and a lookup is a multiply, a
+// compare and a bit test. Modifiers of a format are a bitmask over
+// GetModifiers().
+class DrmFormatTable {
+ public:
+  DrmFormatTable() = default;
+  DrmFormatTable(const DrmFormatTable&) = delete;
+  DrmFormatTable& operator=(const DrmFormatTable&) = delete;
+
+  // Replaces contents of the table. in_formats is the IN_FORMATS blob of
+  // the plane or NULL if it has none, the modifiers are unknown then.
+  void Build(const std::vector<uint32_t>& formats, const void* in_formats,
+             size_t in_formats_size);
+
+  bool HasFormat(uint32_t format) const {
+    const Slot* slot = Find(format);
+    return slot != NULL;
+  }
+
+  // Returns mask of the modifiers supported with format, bit i is set if
+  // GetModifiers()[i] is supported.
+  uint64_t GetModifierMask(uint32_t format) const {
+    const Slot* slot = Find(format);
+    return slot ? slot->modifiers : 0;
+  }
+
+  // Returns false if modifier is known not to work with format. Without
+  // IN_FORMATS it's left to the kernel to decide.
+  bool IsSupportedModifier(uint64_t modifier, uint32_t format) const;
+
+  bool HasModifiers() const {
+    return !modifiers_.empty();
+  }
+
+  const std::vector<uint64_t>& GetModifiers() const {
+    return modifiers_;
+  }
+
+ private:
+  struct Slot {
+    // 0 marks an empty slot, it is not a valid fourcc.
+    uint32_t format;
+    uint64_t modifiers;
+  };
+
+  size_t GetIndex(uint32_t format) const {
+    return (format * multiplier_) >> shift_;
+  }
+
+  const Slot* Find(uint32_t format) const {
+    if (slots_.empty())
+      return NULL;
+
+    const Slot& slot = slots_[GetIndex(format)];
+    return slot.format == format ? &slot : NULL;
+  }
+
+  bool Insert(const std::vector<uint32_t>& formats, uint32_t bits,
+              uint32_t multiplier);
+
+  std::vector<Slot> slots_;
+  std::vector<uint64_t> modifiers_;
+  uint32_t multiplier_ = 0;
+  uint32_t shift_ = 0;
+};
+
+}  // namespace hwcomposer
+#endif  // WSI_DRM_DRMFORMATTABLE_H_
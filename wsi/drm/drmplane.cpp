@@ -32,39 +32,31 @@ DrmPlane::Property::Property() {
 }
 
 bool DrmPlane::Property::Initialize(
-    uint32_t fd, const char* name,
-    const ScopedDrmObjectPropertyPtr& plane_props, uint32_t* rotation,
-    uint64_t* in_formats_prop_value) {
-  uint32_t count_props = plane_props->count_props;
-  for (uint32_t i = 0; i < count_props; i++) {
-    ScopedDrmPropertyPtr property(
-        drmModeGetProperty(fd, plane_props->props[i]));
-    if (property && !strcmp(property->name, name)) {
-      id = property->prop_id;
-      if (rotation) {
-        uint32_t temp = 0;
-        for (int enum_index = 0; enum_index < property->count_enums;
-             enum_index++) {
-          struct drm_mode_property_enum* penum = &(property->enums[enum_index]);
-          if (!strcmp(penum->name, "rotate-90")) {
-            temp |= DRM_MODE_ROTATE_90;
-          }
-          if (!strcmp(penum->name, "rotate-180"))
-            temp |= DRM_MODE_ROTATE_180;
-          else if (!strcmp(penum->name, "rotate-270"))
-            temp |= DRM_MODE_ROTATE_270;
-          else if (!strcmp(penum->name, "rotate-0"))
-            temp |= DRM_MODE_ROTATE_0;
-        }
-
-        *rotation = temp;
-      }
-      if (!strcmp(property->name, "IN_FORMATS")) {
-        if (in_formats_prop_value) {
-          *in_formats_prop_value = plane_props->prop_values[i];
+    const char* name, const DrmPropertyRegistry::ObjectProperties& plane_props,
+    uint32_t* rotation, uint64_t* in_formats_prop_value) {
+  uint64_t value = 0;
+  const DrmPropertyRegistry::PropertyInfo* property =
+      plane_props.Find(name, &value);
+  if (property) {
+    id = property->id;
+    if (rotation) {
+      uint32_t temp = 0;
+      for (const auto& penum : property->enums) {
+        if (penum.first == "rotate-90") {
+          temp |= DRM_MODE_ROTATE_90;
         }
+        if (penum.first == "rotate-180")
+          temp |= DRM_MODE_ROTATE_180;
+        else if (penum.first == "rotate-270")
+          temp |= DRM_MODE_ROTATE_270;
+        else if (penum.first == "rotate-0")
+          temp |= DRM_MODE_ROTATE_0;
       }
-      break;
+
+      *rotation = temp;
+    }
+    if (in_formats_prop_value && property->name == "IN_FORMATS") {
+      *in_formats_prop_value = value;
     }
   }
   if (!id) {
@@ -78,18 +70,22 @@ DrmPlane::DrmPlane(uint32_t plane_id, uint32_t possible_crtcs)
     : id_(plane_id),
       possible_crtc_mask_(possible_crtcs),
       type_(0),
-      last_valid_format_(0),
       in_use_(false) {
+  memset(committed_values_, 0, sizeof(committed_values_));
+  memset(pending_values_, 0, sizeof(pending_values_));
 }
 
 DrmPlane::~DrmPlane() {
   SetNativeFence(-1);
 }
 
-bool DrmPlane::Initialize(uint32_t gpu_fd, const std::vector<uint32_t>& formats,
+bool DrmPlane::Initialize(uint32_t gpu_fd, DrmPropertyRegistry* registry,
+                          const std::vector<uint32_t>& formats,
                           bool use_modifier) {
   supported_formats_ = formats;
   use_modifier_ = use_modifier;
+  // Modifiers are added once IN_FORMATS has been read.
+  format_table_.Build(supported_formats_, NULL, 0);
   uint32_t total_size = supported_formats_.size();
   for (uint32_t j = 0; j < total_size; j++) {
     uint32_t format = supported_formats_.at(j);
@@ -126,77 +122,72 @@ bool DrmPlane::Initialize(uint32_t gpu_fd, const std::vector<uint32_t>& formats,
     prefered_video_format_ = prefered_format_;
   }
 
-  ScopedDrmObjectPropertyPtr plane_props(
-      drmModeObjectGetProperties(gpu_fd, id_, DRM_MODE_OBJECT_PLANE));
-  if (!plane_props) {
+  DrmPropertyRegistry::ObjectProperties plane_props;
+  registry->GetObjectProperties(id_, DRM_MODE_OBJECT_PLANE, &plane_props);
+  if (!plane_props.IsValid()) {
     ETRACE("Unable to get plane properties.");
     return false;
   }
-  uint32_t count_props = plane_props->count_props;
-  for (uint32_t i = 0; i < count_props; i++) {
-    ScopedDrmPropertyPtr property(
-        drmModeGetProperty(gpu_fd, plane_props->props[i]));
-    if (property && !strcmp(property->name, "type")) {
-      type_ = plane_props->prop_values[i];
-      break;
-    }
-  }
 
-  bool ret = crtc_prop_.Initialize(gpu_fd, "CRTC_ID", plane_props);
+  uint64_t type = 0;
+  if (plane_props.Find("type", &type))
+    type_ = type;
+
+  bool ret = crtc_prop_.Initialize("CRTC_ID", plane_props);
   if (!ret)
     return false;
 
-  ret = fb_prop_.Initialize(gpu_fd, "FB_ID", plane_props);
+  ret = fb_prop_.Initialize("FB_ID", plane_props);
   if (!ret)
     return false;
 
-  ret = crtc_x_prop_.Initialize(gpu_fd, "CRTC_X", plane_props);
+  ret = crtc_x_prop_.Initialize("CRTC_X", plane_props);
   if (!ret)
     return false;
 
-  ret = crtc_y_prop_.Initialize(gpu_fd, "CRTC_Y", plane_props);
+  ret = crtc_y_prop_.Initialize("CRTC_Y", plane_props);
   if (!ret)
     return false;
 
-  ret = crtc_w_prop_.Initialize(gpu_fd, "CRTC_W", plane_props);
+  ret = crtc_w_prop_.Initialize("CRTC_W", plane_props);
   if (!ret)
     return false;
 
-  ret = crtc_h_prop_.Initialize(gpu_fd, "CRTC_H", plane_props);
+  ret = crtc_h_prop_.Initialize("CRTC_H", plane_props);
   if (!ret)
     return false;
 
-  ret = src_x_prop_.Initialize(gpu_fd, "SRC_X", plane_props);
+  ret = src_x_prop_.Initialize("SRC_X", plane_props);
   if (!ret)
     return false;
 
-  ret = src_y_prop_.Initialize(gpu_fd, "SRC_Y", plane_props);
+  ret = src_y_prop_.Initialize("SRC_Y", plane_props);
   if (!ret)
     return false;
 
-  ret = src_w_prop_.Initialize(gpu_fd, "SRC_W", plane_props);
+  ret = src_w_prop_.Initialize("SRC_W", plane_props);
   if (!ret)
     return false;
 
-  ret = src_h_prop_.Initialize(gpu_fd, "SRC_H", plane_props);
+  ret = src_h_prop_.Initialize("SRC_H", plane_props);
   if (!ret)
     return false;
 
-  ret = rotation_prop_.Initialize(gpu_fd, "rotation", plane_props, &rotation_);
+  ret = rotation_prop_.Initialize("rotation", plane_props, &rotation_);
   if (!ret)
     ETRACE("Could not get rotation property");
 
-  ret = alpha_prop_.Initialize(gpu_fd, "alpha", plane_props);
+  ret = alpha_prop_.Initialize("alpha", plane_props);
   if (!ret)
     ETRACE("Could not get alpha property");
 
-  ret = in_fence_fd_prop_.Initialize(gpu_fd, "IN_FENCE_FD", plane_props);
+  ret = in_fence_fd_prop_.Initialize("IN_FENCE_FD", plane_props);
   if (!ret) {
     ETRACE("Could not get IN_FENCE_FD property");
     in_fence_fd_prop_.id = 0;
   }
 
-  ret = decryption_prop_.Initialize(gpu_fd, "DECRYPTION", plane_props);
+  ret = decryption_prop_.Initialize("DECRYPTION", plane_props);
   if (!ret) {
     ETRACE("Cound not get decryption property");
     decryption_prop_.id = 0;
@@ -205,7 +196,7 @@ bool DrmPlane::Initialize(uint32_t gpu_fd, const std::vector<uint32_t>& formats,
   // query and store supported modifiers for format, from in_formats
   // property
   uint64_t in_formats_prop_value = 0;
-  ret = in_formats_prop_.Initialize(gpu_fd, "IN_FORMATS", plane_props, NULL,
+  ret = in_formats_prop_.Initialize("IN_FORMATS", plane_props, NULL,
                                     &in_formats_prop_value);
   if (!ret) {
     ETRACE("Could not get IN_FORMATS property");
@@ -220,46 +211,34 @@ bool DrmPlane::Initialize(uint32_t gpu_fd, const std::vector<uint32_t>& formats,
       return false;
     }
 
-    struct drm_format_modifier_blob* m =
-        (struct drm_format_modifier_blob*)(blob->data);
-    struct drm_format_modifier* mod_o =
-        (struct drm_format_modifier*)(void*)(((char*)m) + m->modifiers_offset);
-
+    format_table_.Build(supported_formats_, blob->data, blob->length);
+    const std::vector<uint64_t>& modifiers = format_table_.GetModifiers();
     bool y_tiled_ccs_supported = false;
     bool y_tiled_yf_ccs_supported = false;
-
+    uint64_t mask = 0;
     for (uint32_t j = 0; j < total_size; j++) {
-      uint32_t format = supported_formats_.at(j);
-      format_mods modifiers_obj;
-      modifiers_obj.format = format;
-      uint32_t format_index = j;
-
-      struct drm_format_modifier* mod = mod_o;
-      for (int i = 0; i < (int)m->count_modifiers; i++, mod++) {
-        if (mod->formats & (1ULL << format_index)) {
-          modifiers_obj.mods.emplace_back(mod->modifier);
-          if (mod->modifier == I915_FORMAT_MOD_Y_TILED_CCS) {
-            y_tiled_ccs_supported = true;
-          } else if (mod->modifier == I915_FORMAT_MOD_Yf_TILED_CCS) {
-            y_tiled_yf_ccs_supported = true;
-          }
+      mask = format_table_.GetModifierMask(supported_formats_.at(j));
+      for (uint64_t bits = mask; bits; bits &= bits - 1) {
+        uint64_t modifier = modifiers[__builtin_ctzll(bits)];
+        if (modifier == I915_FORMAT_MOD_Y_TILED_CCS) {
+          y_tiled_ccs_supported = true;
+        } else if (modifier == I915_FORMAT_MOD_Yf_TILED_CCS) {
+          y_tiled_yf_ccs_supported = true;
         }
       }
+    }
 
-      if (modifiers_obj.mods.size() == 0) {
-        modifiers_obj.mods.emplace_back(DRM_FORMAT_MOD_NONE);
+    // mask is the one of the last format of the plane.
+    if (total_size) {
+      if (!mask) {
         prefered_modifier_ = DRM_FORMAT_MOD_NONE;
+      } else if (y_tiled_ccs_supported) {
+        prefered_modifier_ = I915_FORMAT_MOD_Y_TILED_CCS;
+      } else if (y_tiled_yf_ccs_supported) {
+        prefered_modifier_ = I915_FORMAT_MOD_Yf_TILED_CCS;
       } else {
-        if (y_tiled_ccs_supported) {
-          prefered_modifier_ = I915_FORMAT_MOD_Y_TILED_CCS;
-        } else if (y_tiled_yf_ccs_supported) {
-          prefered_modifier_ = I915_FORMAT_MOD_Yf_TILED_CCS;
-        } else {
-          prefered_modifier_ = modifiers_obj.mods.at(0);
-        }
+        prefered_modifier_ = modifiers[__builtin_ctzll(mask)];
       }
-
-      formats_modifiers_.emplace_back(modifiers_obj);
     }
 
     drmModeFreePropertyBlob(blob);
@@ -267,9 +246,39 @@ bool DrmPlane::Initialize(uint32_t gpu_fd, const std::vector<uint32_t>& formats,
   return true;
 }
 
+bool DrmPlane::AddProperties(drmModeAtomicReqPtr property_set,
+                             const uint64_t* values, uint32_t mask,
+                             uint32_t force_mask, bool track_state) {
+  const Property* properties[kPropertyCount] = {
+      &crtc_prop_,   &fb_prop_,       &crtc_x_prop_, &crtc_y_prop_,
+      &crtc_w_prop_, &crtc_h_prop_,   &src_x_prop_,  &src_y_prop_,
+      &src_w_prop_,  &src_h_prop_,    &rotation_prop_, &alpha_prop_,
+      &decryption_prop_};
+  bool failed = false;
+  for (uint32_t i = 0; i < kPropertyCount; i++) {
+    uint32_t bit = 1 << i;
+    if (!(mask & bit) || !properties[i]->id)
+      continue;
+
+    if (track_state) {
+      pending_values_[i] = values[i];
+      pending_mask_ |= bit;
+    }
+
+    if (!(force_mask & bit) && (committed_mask_ & bit) &&
+        committed_values_[i] == values[i])
+      continue;
+
+    failed |= drmModeAtomicAddProperty(property_set, id_, properties[i]->id,
+                                       values[i]) < 0;
+  }
+
+  return failed;
+}
+
 bool DrmPlane::UpdateProperties(drmModeAtomicReqPtr property_set,
                                 uint32_t crtc_id, const OverlayLayer* layer,
-                                bool test_commit) const {
+                                bool test_commit, bool full_state) {
   uint32_t alpha = 0xFFFF;
   OverlayBuffer* buffer = layer->GetBuffer();
   if (!buffer) {
@@ -290,84 +299,64 @@ bool DrmPlane::UpdateProperties(drmModeAtomicReqPtr property_set,
 
   IDISPLAYMANAGERTRACE("buffer->GetFb() ---------------------- STARTS %d",
                        buffer->GetFb());
-  int success =
-      drmModeAtomicAddProperty(property_set, id_, crtc_prop_.id, crtc_id) < 0;
-  success |= drmModeAtomicAddProperty(property_set, id_, fb_prop_.id,
-                                      buffer->GetFb()) < 0;
-  success |= drmModeAtomicAddProperty(property_set, id_, crtc_x_prop_.id,
-                                      display_frame.left) < 0;
-  success |= drmModeAtomicAddProperty(property_set, id_, crtc_y_prop_.id,
-                                      display_frame.top) < 0;
+  uint64_t values[kPropertyCount];
+  values[kCrtcId] = crtc_id;
+  values[kFbId] = buffer->GetFb();
+  values[kCrtcX] = display_frame.left;
+  values[kCrtcY] = display_frame.top;
 
   if (layer->IsCursorLayer()) {
-    success |= drmModeAtomicAddProperty(property_set, id_, crtc_w_prop_.id,
-                                        buffer->GetWidth()) < 0;
-    success |= drmModeAtomicAddProperty(property_set, id_, crtc_h_prop_.id,
-                                        buffer->GetHeight()) < 0;
-    success |=
-        drmModeAtomicAddProperty(property_set, id_, src_x_prop_.id, 0) < 0;
-    success |=
-        drmModeAtomicAddProperty(property_set, id_, src_y_prop_.id, 0) < 0;
-
-    success |= drmModeAtomicAddProperty(property_set, id_, src_w_prop_.id,
-                                        buffer->GetWidth() << 16) < 0;
-    success |= drmModeAtomicAddProperty(property_set, id_, src_h_prop_.id,
-                                        buffer->GetHeight() << 16) < 0;
+    values[kCrtcW] = buffer->GetWidth();
+    values[kCrtcH] = buffer->GetHeight();
+    values[kSrcX] = 0;
+    values[kSrcY] = 0;
+    values[kSrcW] = buffer->GetWidth() << 16;
+    values[kSrcH] = buffer->GetHeight() << 16;
   } else {
-    success |= drmModeAtomicAddProperty(property_set, id_, crtc_w_prop_.id,
-                                        layer->GetDisplayFrameWidth()) < 0;
-    success |= drmModeAtomicAddProperty(property_set, id_, crtc_h_prop_.id,
-                                        layer->GetDisplayFrameHeight()) < 0;
-    success |= drmModeAtomicAddProperty(
-                   property_set, id_, src_x_prop_.id,
-                   static_cast<int>(ceilf(source_crop.left)) << 16) < 0;
-    success |= drmModeAtomicAddProperty(
-                   property_set, id_, src_y_prop_.id,
-                   static_cast<int>(ceilf((source_crop.top))) << 16) < 0;
-    success |= drmModeAtomicAddProperty(property_set, id_, src_w_prop_.id,
-                                        layer->GetSourceCropWidth() << 16) < 0;
-    success |= drmModeAtomicAddProperty(property_set, id_, src_h_prop_.id,
-                                        layer->GetSourceCropHeight() << 16) < 0;
+    values[kCrtcW] = layer->GetDisplayFrameWidth();
+    values[kCrtcH] = layer->GetDisplayFrameHeight();
+    values[kSrcX] = static_cast<int>(ceilf(source_crop.left)) << 16;
+    values[kSrcY] = static_cast<int>(ceilf((source_crop.top))) << 16;
+    values[kSrcW] = layer->GetSourceCropWidth() << 16;
+    values[kSrcH] = layer->GetSourceCropHeight() << 16;
   }
 
-  if (decryption_prop_.id != 0) {
-    if (layer->IsProtected()) {
-      success |= drmModeAtomicAddProperty(property_set, id_,
-                                          decryption_prop_.id, 1) < 0;
-    } else {
-      success |= drmModeAtomicAddProperty(property_set, id_,
-                                          decryption_prop_.id, 0) < 0;
-    }
-  }
+  values[kDecryption] = layer->IsProtected() ? 1 : 0;
 
-  if (rotation_prop_.id) {
-    uint32_t rotation = 0;
-    uint32_t transform = layer->GetMergedTransform();
-    if (transform & kTransform90) {
-      rotation |= DRM_MODE_ROTATE_90;
-      if (transform & kReflectX)
-        rotation |= DRM_MODE_REFLECT_X;
-      if (transform & kReflectY)
-        rotation |= DRM_MODE_REFLECT_Y;
-    } else if (transform & kTransform180)
-      rotation |= DRM_MODE_ROTATE_180;
-    else if (transform & kTransform270)
-      rotation |= DRM_MODE_ROTATE_270;
-    else
-      rotation |= DRM_MODE_ROTATE_0;
-
-    success = drmModeAtomicAddProperty(property_set, id_, rotation_prop_.id,
-                                       rotation) < 0;
+  uint32_t rotation = 0;
+  uint32_t transform = layer->GetMergedTransform();
+  if (transform & kTransform90) {
+    rotation |= DRM_MODE_ROTATE_90;
+    if (transform & kReflectX)
+      rotation |= DRM_MODE_REFLECT_X;
+    if (transform & kReflectY)
+      rotation |= DRM_MODE_REFLECT_Y;
+  } else if (transform & kTransform180)
+    rotation |= DRM_MODE_ROTATE_180;
+  else if (transform & kTransform270)
+    rotation |= DRM_MODE_ROTATE_270;
+  else
+    rotation |= DRM_MODE_ROTATE_0;
+
+  values[kRotation] = rotation;
+  values[kAlpha] = alpha;
+
+  // Test commits are checked against the committed state, so they need
+  // every property and must not touch the pending state of a real commit.
+  uint32_t force_mask = 0;
+  if (full_state || test_commit) {
+    force_mask = kAllProperties;
+  } else if (fence > 0 && in_fence_fd_prop_.id) {
+    // New content is coming even if fb is same, make sure it's flipped.
+    force_mask = 1 << kFbId;
   }
 
-  if (alpha_prop_.id) {
-    success =
-        drmModeAtomicAddProperty(property_set, id_, alpha_prop_.id, alpha) < 0;
-  }
+  int success = AddProperties(property_set, values, kAllProperties,
+                              force_mask, !test_commit);
 
   if (fence > 0 && in_fence_fd_prop_.id) {
-    success = drmModeAtomicAddProperty(property_set, id_, in_fence_fd_prop_.id,
-                                       fence) < 0;
+    success |= drmModeAtomicAddProperty(property_set, id_,
+                                        in_fence_fd_prop_.id, fence) < 0;
   }
 
   if (success) {
@@ -401,23 +390,14 @@ void DrmPlane::PreferredFormatModifierValidated() {
   prefered_modifier_succeeded_ = true;
 }
 
-bool DrmPlane::Disable(drmModeAtomicReqPtr property_set) {
+bool DrmPlane::Disable(drmModeAtomicReqPtr property_set, bool full_state) {
   in_use_ = false;
-  int success =
-      drmModeAtomicAddProperty(property_set, id_, crtc_prop_.id, 0) < 0;
-  success |= drmModeAtomicAddProperty(property_set, id_, fb_prop_.id, 0) < 0;
-  success |=
-      drmModeAtomicAddProperty(property_set, id_, crtc_x_prop_.id, 0) < 0;
-  success |=
-      drmModeAtomicAddProperty(property_set, id_, crtc_y_prop_.id, 0) < 0;
-  success |=
-      drmModeAtomicAddProperty(property_set, id_, crtc_w_prop_.id, 0) < 0;
-  success |=
-      drmModeAtomicAddProperty(property_set, id_, crtc_h_prop_.id, 0) < 0;
-  success |= drmModeAtomicAddProperty(property_set, id_, src_x_prop_.id, 0) < 0;
-  success |= drmModeAtomicAddProperty(property_set, id_, src_y_prop_.id, 0) < 0;
-  success |= drmModeAtomicAddProperty(property_set, id_, src_w_prop_.id, 0) < 0;
-  success |= drmModeAtomicAddProperty(property_set, id_, src_h_prop_.id, 0) < 0;
+  // Disabling only touches plane position, source and fb.
+  uint64_t values[kPropertyCount];
+  memset(values, 0, sizeof(values));
+  uint32_t mask = (1 << kRotation) - 1;
+  int success = AddProperties(property_set, values, mask,
+                              full_state ? kAllProperties : 0, true);
 
   if (success) {
     ETRACE("Could not update properties for plane with id: %d", id_);
@@ -430,6 +410,19 @@ bool DrmPlane::Disable(drmModeAtomicReqPtr property_set) {
   return true;
 }
 
+void DrmPlane::CommitPendingState(bool success) {
+  if (success) {
+    for (uint32_t i = 0; i < kPropertyCount; i++) {
+      if (pending_mask_ & (1 << i))
+        committed_values_[i] = pending_values_[i];
+    }
+
+    committed_mask_ |= pending_mask_;
+  }
+
+  pending_mask_ = 0;
+}
+
 uint32_t DrmPlane::id() const {
   return id_;
 }
@@ -484,17 +477,7 @@ bool DrmPlane::ValidateLayer(const OverlayLayer* layer) {
 }
 
 bool DrmPlane::IsSupportedFormat(uint32_t format) {
-  if (last_valid_format_ == format)
-    return true;
-
-  for (auto& element : supported_formats_) {
-    if (element == format) {
-      last_valid_format_ = format;
-      return true;
-    }
-  }
-
-  return false;
+  return format_table_.HasFormat(format);
 }
 
 bool DrmPlane::IsSupportedTransform(uint32_t transform) const {
@@ -539,18 +522,7 @@ void DrmPlane::SetInUse(bool in_use) {
 }
 
 bool DrmPlane::IsSupportedModifier(uint64_t modifier, uint32_t format) {
-  uint32_t count = formats_modifiers_.size();
-  for (uint32_t i = 0; i < count; i++) {
-    const format_mods& obj = formats_modifiers_.at(i);
-    if (obj.format == format) {
-      std::vector<uint64_t>::const_iterator it;
-      it = std::find(obj.mods.begin(), obj.mods.end(), modifier);
-      if (it != obj.mods.end()) {
-        return true;
-      }
-    }
-  }
-  return false;
+  return format_table_.IsSupportedModifier(modifier, format);
 }
 
 void DrmPlane::Dump() const {
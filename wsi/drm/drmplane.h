@@ -26,6 +26,8 @@
 
 #include "displayplane.h"
 #include "drmbuffer.h"
+#include "drmformattable.h"
+#include "drmpropertyregistry.h"
 #include "drmscopedtypes.h"
 
 namespace hwcomposer {
@@ -39,18 +41,28 @@ class DrmPlane : public DisplayPlane {
 
   ~DrmPlane();
 
-  bool Initialize(uint32_t gpu_fd, const std::vector<uint32_t>& formats,
-                  bool use_modifer);
+  bool Initialize(uint32_t gpu_fd, DrmPropertyRegistry* registry,
+                  const std::vector<uint32_t>& formats, bool use_modifer);
 
+  // Adds properties needed to show layer on this plane to property_set.
+  // Unless full_state is true, only properties whose value differs from
+  // the last committed state are added. Values are remembered as pending
+  // till the commit result is reported with CommitPendingState. Test
+  // commits always add all properties and don't update pending state.
   bool UpdateProperties(drmModeAtomicReqPtr property_set, uint32_t crtc_id,
-                        const OverlayLayer* layer,
-                        bool test_commit = false) const;
+                        const OverlayLayer* layer, bool test_commit = false,
+                        bool full_state = true);
 
   void SetNativeFence(int32_t fd);
 
   void SetBuffer(std::shared_ptr<OverlayBuffer>& buffer);
 
-  bool Disable(drmModeAtomicReqPtr property_set);
+  bool Disable(drmModeAtomicReqPtr property_set, bool full_state = true);
+
+  // Should be called once the property_set last passed to UpdateProperties
+  // or Disable has been committed. Pending values become the committed
+  // state on success and are dropped otherwise.
+  void CommitPendingState(bool success);
 
   bool GetCrtcSupported(uint32_t pipe_id) const;
 
@@ -84,19 +96,44 @@ class DrmPlane : public DisplayPlane {
     return !(type_ == DRM_PLANE_TYPE_CURSOR);
   }
 
-  // check if modifier is supported for given format
-  bool IsSupportedModifier(uint64_t modifier, uint32_t format);
+  bool IsSupportedModifier(uint64_t modifier, uint32_t format) override;
 
  private:
   struct Property {
     Property();
-    bool Initialize(uint32_t fd, const char* name,
-                    const ScopedDrmObjectPropertyPtr& plane_properties,
+    bool Initialize(const char* name,
+                    const DrmPropertyRegistry::ObjectProperties& plane_props,
                     uint32_t* rotation = NULL,
                     uint64_t* in_formats_prop_value = NULL);
     uint32_t id = 0;
   };
 
+  // Properties whose last committed value is tracked.
+  enum PropertyIndex {
+    kCrtcId = 0,
+    kFbId,
+    kCrtcX,
+    kCrtcY,
+    kCrtcW,
+    kCrtcH,
+    kSrcX,
+    kSrcY,
+    kSrcW,
+    kSrcH,
+    kRotation,
+    kAlpha,
+    kDecryption,
+    kPropertyCount
+  };
+
+  static const uint32_t kAllProperties = (1 << kPropertyCount) - 1;
+
+  // Adds properties in mask to property_set if they are in force_mask or
+  // differ from the committed value. Added values are recorded as pending
+  // when track_state is set. Returns true on failure.
+  bool AddProperties(drmModeAtomicReqPtr property_set, const uint64_t* values,
+                     uint32_t mask, uint32_t force_mask, bool track_state);
+
   Property crtc_prop_;
   Property fb_prop_;
   Property crtc_x_prop_;
@@ -119,7 +156,6 @@ class DrmPlane : public DisplayPlane {
 
   uint32_t type_;
 
-  uint32_t last_valid_format_;
   bool in_use_;
   bool prefered_modifier_succeeded_ = false;
 
@@ -130,14 +166,16 @@ class DrmPlane : public DisplayPlane {
   uint64_t prefered_modifier_ = 0;
   uint32_t rotation_ = 0;
 
-  // keep supported modifiers for each supported format
-  typedef struct format_mods {
-    std::vector<uint64_t> mods;
-    uint32_t format;
-  } format_mods;
-  std::vector<format_mods> formats_modifiers_;
+  // Supported modifiers for each supported format.
+  DrmFormatTable format_table_;
   std::shared_ptr<OverlayBuffer> buffer_ = NULL;
   bool use_modifier_ = true;
+
+  uint64_t committed_values_[kPropertyCount];
+  uint64_t pending_values_[kPropertyCount];
+  // Bit per PropertyIndex.
+  uint32_t committed_mask_ = 0;
+  uint32_t pending_mask_ = 0;
 };
 
 }  // namespace hwcomposer
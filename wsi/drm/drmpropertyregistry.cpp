@@ -0,0 +1,94 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "drmpropertyregistry.h"
+
+#include <string.h>
+#include <xf86drmMode.h>
+
+#include "drmscopedtypes.h"
+#include "hwctrace.h"
+
+namespace hwcomposer {
+
+const DrmPropertyRegistry::PropertyInfo* DrmPropertyRegistry::ObjectProperties::
+    Find(const char* name, uint64_t* value) const {
+  for (const auto& property : properties_) {
+    if (property.first->name == name) {
+      if (value)
+        *value = property.second;
+
+      return property.first;
+    }
+  }
+
+  return NULL;
+}
+
+DrmPropertyRegistry::DrmPropertyRegistry(int fd) : fd_(fd) {
+}
+
+void DrmPropertyRegistry::GetObjectProperties(uint32_t object_id,
+                                              uint32_t object_type,
+                                              ObjectProperties* properties) {
+  properties->properties_.clear();
+  properties->valid_ = false;
+  ScopedDrmObjectPropertyPtr object_props(
+      drmModeObjectGetProperties(fd_, object_id, object_type));
+  if (!object_props) {
+    ETRACE("Unable to get properties of object %d. %s", object_id,
+           PRINTERROR());
+    return;
+  }
+
+  uint32_t count_props = object_props->count_props;
+  properties->properties_.reserve(count_props);
+  ScopedSpinLock lock(lock_);
+  for (uint32_t i = 0; i < count_props; i++) {
+    const PropertyInfo* info = GetProperty(object_props->props[i]);
+    if (info) {
+      properties->properties_.emplace_back(info,
+                                           object_props->prop_values[i]);
+    }
+  }
+
+  properties->valid_ = true;
+}
+
+const DrmPropertyRegistry::PropertyInfo* DrmPropertyRegistry::GetProperty(
+    uint32_t property_id) {
+  auto it = properties_.find(property_id);
+  if (it != properties_.end())
+    return &it->second;
+
+  fetches_++;
+  ScopedDrmPropertyPtr property(drmModeGetProperty(fd_, property_id));
+  if (!property)
+    return NULL;
+
+  PropertyInfo& info = properties_[property_id];
+  info.id = property->prop_id;
+  info.flags = property->flags;
+  info.name = property->name;
+  for (int i = 0; i < property->count_enums; i++) {
+    info.enums.emplace_back(property->enums[i].name,
+                            property->enums[i].value);
+  }
+
+  return &info;
+}
+
+}  // namespace hwcomposer
@@ -0,0 +1,90 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef WSI_DRM_DRMPROPERTYREGISTRY_H_
+#define WSI_DRM_DRMPROPERTYREGISTRY_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <spinlock.h>
+
+namespace hwcomposer {
+
+// Caches the description of DRM properties. Property ids are global to a
+// gpu fd, i.e. all planes share the same CRTC_X property, so every
+// property is fetched with drmModeGetProperty only once, no matter how
+// many objects have it or how often their properties are read. Shared by
+// all displays of a gpu fd.
+class DrmPropertyRegistry {
+ public:
+  struct PropertyInfo {
+    uint32_t id = 0;
+    uint32_t flags = 0;
+    std::string name;
+    // Names and values of enum and bitmask properties.
+    std::vector<std::pair<std::string, uint64_t>> enums;
+  };
+
+  // Properties of a KMS object with their values at the time they were
+  // read.
+  class ObjectProperties {
+   public:
+    // Returns property called name or NULL if the object has none. value,
+    // if set, receives the current value of the property.
+    const PropertyInfo* Find(const char* name, uint64_t* value = NULL) const;
+
+    bool IsValid() const {
+      return valid_;
+    }
+
+   private:
+    friend class DrmPropertyRegistry;
+
+    std::vector<std::pair<const PropertyInfo*, uint64_t>> properties_;
+    bool valid_ = false;
+  };
+
+  explicit DrmPropertyRegistry(int fd);
+  DrmPropertyRegistry(const DrmPropertyRegistry&) = delete;
+  DrmPropertyRegistry& operator=(const DrmPropertyRegistry&) = delete;
+
+  // Reads properties of object_id with a single drmModeObjectGetProperties
+  // call. Properties not seen before are added to the registry.
+  void GetObjectProperties(uint32_t object_id, uint32_t object_type,
+                           ObjectProperties* properties);
+
+  // Number of drmModeGetProperty calls made so far.
+  uint64_t GetPropertyFetches() const {
+    return fetches_;
+  }
+
+ private:
+  const PropertyInfo* GetProperty(uint32_t property_id);
+
+  int fd_;
+  SpinLock lock_;
+  // Never shrinks, so pointers to the values stay valid.
+  std::map<uint32_t, PropertyInfo> properties_;
+  uint64_t fetches_ = 0;
+};
+
+}  // namespace hwcomposer
+#endif  // WSI_DRM_DRMPROPERTYREGISTRY_H_
@@ -0,0 +1,151 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "drmtestcommitcache.h"
+
+#include <string.h>
+#include <cmath>
+#include <iterator>
+
+#include "displayplane.h"
+#include "hwctrace.h"
+#include "overlaylayer.h"
+
+namespace hwcomposer {
+
+// Maximum number of plane configurations remembered per display.
+static const size_t kMaxTestCommitCacheEntries = 32;
+
+bool DrmTestCommitCache::BuildKey(
+    const std::vector<OverlayPlane>& commit_planes) {
+  pending_key_.resize(commit_planes.size());
+  size_t index = 0;
+  for (const OverlayPlane& commit_plane : commit_planes) {
+    const OverlayLayer* layer = commit_plane.layer;
+    OverlayBuffer* buffer = layer->GetBuffer();
+    // Test result for a layer without a valid frame buffer depends on
+    // the buffer itself, don't cache it.
+    if (!buffer || buffer->GetFb() == 0)
+      return false;
+
+    PlaneKey& key = pending_key_.at(index++);
+    memset(&key, 0, sizeof(PlaneKey));
+    const HwcRect<int>& display_frame = layer->GetDisplayFrame();
+    const HwcRect<float>& source_crop = layer->GetSourceCrop();
+    key.modifier = buffer->GetModifier();
+    key.plane_id = commit_plane.plane->id();
+    key.format = buffer->GetFormat();
+    key.tiling_mode = buffer->GetTilingMode();
+    key.buffer_width = buffer->GetWidth();
+    key.buffer_height = buffer->GetHeight();
+    key.src_x = static_cast<uint32_t>(ceilf(source_crop.left));
+    key.src_y = static_cast<uint32_t>(ceilf(source_crop.top));
+    key.src_w = layer->GetSourceCropWidth();
+    key.src_h = layer->GetSourceCropHeight();
+    key.dst_x = display_frame.left;
+    key.dst_y = display_frame.top;
+    key.dst_w = layer->GetDisplayFrameWidth();
+    key.dst_h = layer->GetDisplayFrameHeight();
+    key.transform = layer->GetMergedTransform();
+    key.alpha = layer->GetAlpha();
+    key.blending = static_cast<uint32_t>(layer->GetBlending());
+    if (layer->IsProtected())
+      key.flags |= kProtected;
+
+    if (layer->IsCursorLayer())
+      key.flags |= kCursor;
+
+    if (key.src_w != key.dst_w || key.src_h != key.dst_h)
+      key.flags |= kScaled;
+  }
+
+  pending_hash_ = Hash(pending_key_);
+  return true;
+}
+
+uint32_t DrmTestCommitCache::Hash(const std::vector<PlaneKey>& key) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(key.data());
+  size_t size = key.size() * sizeof(PlaneKey);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+bool DrmTestCommitCache::Lookup(const std::vector<OverlayPlane>& commit_planes,
+                                bool* result) {
+  ScopedSpinLock lock(lock_);
+  pending_valid_ = BuildKey(commit_planes);
+  if (!pending_valid_)
+    return false;
+
+  size_t key_size = pending_key_.size() * sizeof(PlaneKey);
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->hash != pending_hash_ || it->key.size() != pending_key_.size())
+      continue;
+
+    if (memcmp(it->key.data(), pending_key_.data(), key_size))
+      continue;
+
+    *result = it->result;
+    // Keep most recently used entries at the front.
+    if (it != entries_.begin())
+      entries_.splice(entries_.begin(), entries_, it);
+
+    pending_valid_ = false;
+    hits_++;
+    return true;
+  }
+
+  misses_++;
+  return false;
+}
+
+void DrmTestCommitCache::Insert(bool result) {
+  ScopedSpinLock lock(lock_);
+  // Key was not cacheable or cache was invalidated after Lookup.
+  if (!pending_valid_)
+    return;
+
+  pending_valid_ = false;
+  if (entries_.size() >= kMaxTestCommitCacheEntries) {
+    // Re-use storage of least recently used entry.
+    entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+  } else {
+    entries_.emplace_front();
+  }
+
+  Entry& entry = entries_.front();
+  entry.key.swap(pending_key_);
+  entry.hash = pending_hash_;
+  entry.result = result;
+}
+
+void DrmTestCommitCache::Invalidate() {
+  ScopedSpinLock lock(lock_);
+  IDISPLAYMANAGERTRACE(
+      "Invalidating Test Commit cache. Entries: %zu Hits: %llu Misses: %llu",
+      entries_.size(), static_cast<unsigned long long>(hits_),
+      static_cast<unsigned long long>(misses_));
+  entries_.clear();
+  pending_valid_ = false;
+}
+
+}  // namespace hwcomposer
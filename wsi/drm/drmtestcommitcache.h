@@ -0,0 +1,113 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef WSI_DRM_DRMTESTCOMMITCACHE_H_
+#define WSI_DRM_DRMTESTCOMMITCACHE_H_
+
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <spinlock.h>
+
+#include "displayplanehandler.h"
+
+namespace hwcomposer {
+
+// Remembers the result of DRM_MODE_ATOMIC_TEST_ONLY commits for a given
+// plane/layer configuration. The key captures everything which can change
+// the kernel's decision (plane, format, modifier, source and destination
+// geometry, transform, alpha and blending) but not the framebuffer id, so
+// a steady state layer stack which only flips buffers can skip the ioctl
+// during revalidation. Entries are evicted in LRU order once the cache is
+// full and all entries are dropped on modeset or hotplug.
+class DrmTestCommitCache {
+ public:
+  DrmTestCommitCache() = default;
+
+  // Returns true and sets result if commit_planes has been tested before.
+  bool Lookup(const std::vector<OverlayPlane>& commit_planes, bool* result);
+
+  // Stores result of a TEST_ONLY commit of commit_planes. Should be called
+  // only after Lookup returned false for the same commit_planes.
+  void Insert(bool result);
+
+  // Drops all cached results.
+  void Invalidate();
+
+  uint64_t GetHits() const {
+    return hits_;
+  }
+
+  uint64_t GetMisses() const {
+    return misses_;
+  }
+
+ private:
+  // Per plane state which influences result of a test commit. All fields
+  // are 32 or 64 bit wide so that the struct has no padding and can be
+  // compared with memcmp.
+  struct PlaneKey {
+    uint64_t modifier;
+    uint32_t plane_id;
+    uint32_t format;
+    uint32_t tiling_mode;
+    uint32_t buffer_width;
+    uint32_t buffer_height;
+    uint32_t src_x;
+    uint32_t src_y;
+    uint32_t src_w;
+    uint32_t src_h;
+    int32_t dst_x;
+    int32_t dst_y;
+    uint32_t dst_w;
+    uint32_t dst_h;
+    uint32_t transform;
+    uint32_t alpha;
+    uint32_t blending;
+    uint32_t flags;
+    uint32_t pad;
+  };
+
+  enum PlaneKeyFlags {
+    kProtected = 1 << 0,
+    kCursor = 1 << 1,
+    kScaled = 1 << 2
+  };
+
+  struct Entry {
+    std::vector<PlaneKey> key;
+    uint32_t hash = 0;
+    bool result = false;
+  };
+
+  bool BuildKey(const std::vector<OverlayPlane>& commit_planes);
+  static uint32_t Hash(const std::vector<PlaneKey>& key);
+
+  // Key built by last call to Lookup.
+  std::vector<PlaneKey> pending_key_;
+  uint32_t pending_hash_ = 0;
+  bool pending_valid_ = false;
+  std::list<Entry> entries_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  SpinLock lock_;
+};
+
+}  // namespace hwcomposer
+#endif  // WSI_DRM_DRMTESTCOMMITCACHE_H_
@@ -64,6 +64,10 @@ class OverlayBuffer {
 
   virtual uint32_t GetTilingMode() const = 0;
 
+  // Returns format modifier used while creating frame buffer for this
+  // buffer, DRM_FORMAT_MOD_NONE if none was used.
+  virtual uint64_t GetModifier() const = 0;
+
   virtual void SetDataSpace(uint32_t dataspace) = 0;
 
   virtual bool GetInterlace() = 0;
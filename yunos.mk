@@ -47,12 +47,16 @@ LOCAL_SRC_FILES := os/alios/hwf_alioshal.cpp \
     common/utils/hwcthread.cpp \
     common/utils/hwcevent.cpp \
     common/utils/fdhandler.cpp \
-    common/utils/disjoint_layers.cpp \
+    common/utils/regionsplitter.cpp \
+    common/utils/spinlock.cpp \
+    common/utils/taskexecutor.cpp \
     common/display/virtualdisplay.cpp \
+    common/display/commitscheduler.cpp \
     common/display/displayqueue.cpp \
     common/display/displayplanestate.cpp \
     common/display/displayplanemanager.cpp \
     common/display/vblankeventhandler.cpp \
+    common/display/vblankeventloop.cpp \
     common/compositor/compositor.cpp \
     common/compositor/compositorthread.cpp \
     common/compositor/nativesurface.cpp \
@@ -64,12 +68,16 @@ LOCAL_SRC_FILES := os/alios/hwf_alioshal.cpp \
     common/compositor/gl/egloffscreencontext.cpp \
     common/compositor/gl/nativeglresource.cpp \
     common/compositor/gl/glprogram.cpp \
+    common/compositor/gl/glprogramcache.cpp \
     common/compositor/va/varenderer.cpp \
     common/compositor/va/vautils.cpp \
     wsi/drm/drmdisplaymanager.cpp \
     wsi/drm/drmscopedtypes.cpp \
     wsi/drm/drmdisplay.cpp \
+    wsi/drm/drmformattable.cpp \
     wsi/drm/drmplane.cpp \
+    wsi/drm/drmpropertyregistry.cpp \
+    wsi/drm/drmtestcommitcache.cpp \
     wsi/drm/drmbuffer.cpp \
     wsi/physicaldisplay.cpp \
     os/platformcommondrmdefines.cpp \